@@ -0,0 +1,215 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Throughput of one point-to-point link next to a static narrowband
+ * interferer, with and without adaptive frequency hopping. The master
+ * sends a packet every --interval to the slave; the interferer occupies
+ * --jammedChannels data channel indices from index --firstJammed on
+ * without interruption, with --jammerPower watts, as far from the slave
+ * as the master is. The same scenario is run with AfhInterval 0 and with
+ * --afhInterval, and the bytes the slave received, the receptions with a
+ * CRC error and the channel map updates are printed for both.
+ *
+ *   ./waf --run "ble-afh-interferer --jammedChannels=10 --duration=60"
+ */
+
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/spectrum-signal-parameters.h>
+#include <ns3/ble-module.h>
+
+#include <iostream>
+
+using namespace ns3;
+
+/// What a run of the scenario measured
+struct AfhResult
+{
+  uint64_t rxBytes;    //!< bytes the slave passed up
+  uint64_t rxErrors;   //!< receptions with a CRC error, at both ends
+  uint32_t mapUpdates; //!< channel maps chosen by the master
+};
+
+/**
+ * Count the bytes of a received packet.
+ *
+ * \param result where to count
+ * \param packet the packet
+ */
+static void
+Received (AfhResult *result, Ptr<const Packet> packet)
+{
+  result->rxBytes += packet->GetSize ();
+}
+
+/**
+ * Count a reception with a CRC error.
+ *
+ * \param result where to count
+ * \param packet the packet
+ */
+static void
+ReceivedInError (AfhResult *result, Ptr<const Packet> packet)
+{
+  result->rxErrors++;
+}
+
+/**
+ * Count a channel map update.
+ *
+ * \param result where to count
+ * \param usedChannels the new map
+ * \param instant connection event from which it is used
+ */
+static void
+ChannelMapUpdated (AfhResult *result, uint64_t usedChannels, uint16_t instant)
+{
+  result->mapUpdates++;
+}
+
+/**
+ * Transmit one burst of the interferer and schedule the next one right
+ * after it. The bursts are short, so every reception overlaps the start
+ * of one, and are not BLE signals, so they only add interference.
+ *
+ * \param channel the channel
+ * \param params the burst
+ */
+static void
+Jam (Ptr<SpectrumChannel> channel, Ptr<SpectrumSignalParameters> params)
+{
+  channel->StartTx (params);
+  Simulator::Schedule (params->duration, &Jam, channel, params);
+}
+
+/**
+ * Run the scenario once.
+ *
+ * \param afhInterval the AfhInterval of the link managers, 0 to disable
+ * \param jammedChannels number of jammed data channel indices
+ * \param firstJammed first jammed data channel index
+ * \param jammerPower power of the interferer per channel index, in W
+ * \param interval time between two packets of the master, in s
+ * \param packetSize size of those packets
+ * \param duration simulated time in seconds
+ * \return what was measured
+ */
+static AfhResult
+RunScenario (Time afhInterval, uint32_t jammedChannels, uint32_t firstJammed,
+             double jammerPower, double interval, uint32_t packetSize, double duration)
+{
+  Config::SetDefault ("ns3::BleLinkManager::AfhInterval", TimeValue (afhInterval));
+  RngSeedManager::SetRun (1);
+  AfhResult result = { 0, 0, 0 };
+
+  double distance = 5;
+  NodeContainer nodes;
+  nodes.Create (2);
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0, 0, 1));
+  positions->Add (Vector (distance, 0, 1));
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (nodes);
+
+  BleHelper helper;
+  NetDeviceContainer devices = helper.Install (nodes);
+  // One link, the first node is its master, with a 30 ms interval
+  helper.CreateAllLinks (devices, true, 24);
+  Ptr<UniformRandomVariable> start = CreateObject<UniformRandomVariable> ();
+  start->SetAttribute ("Max", DoubleValue (0.1));
+  helper.GenerateTraffic (start, nodes, packetSize, 1, duration - 1, interval);
+
+  Ptr<BleNetDevice> master = DynamicCast<BleNetDevice> (devices.Get (0));
+  Ptr<BleNetDevice> slave = DynamicCast<BleNetDevice> (devices.Get (1));
+  slave->TraceConnectWithoutContext ("MacRx", MakeBoundCallback (&Received, &result));
+  for (uint32_t i = 0; i < devices.GetN (); i++)
+    {
+      devices.Get (i)->TraceConnectWithoutContext ("MacRxError",
+                                                   MakeBoundCallback (&ReceivedInError, &result));
+    }
+  std::list<Ptr<BleLinkManager> > linkManagers = master->GetBBManager ()->GetLinkManagers ();
+  for (std::list<Ptr<BleLinkManager> >::iterator it = linkManagers.begin ();
+       it != linkManagers.end (); ++it)
+    {
+      (*it)->TraceConnectWithoutContext ("ChannelMapUpdate",
+                                         MakeBoundCallback (&ChannelMapUpdated, &result));
+    }
+
+  // The interferer, as far from the slave as the master
+  Ptr<ConstantPositionMobilityModel> jammerPosition = CreateObject<ConstantPositionMobilityModel> ();
+  jammerPosition->SetPosition (Vector (distance, distance, 1));
+  Ptr<BlePhy> jammer = CreateObject<BlePhy> ();
+  jammer->SetMobility (jammerPosition);
+  Ptr<SpectrumSignalParameters> burst = Create<SpectrumSignalParameters> ();
+  burst->duration = MicroSeconds (50);
+  burst->txPhy = jammer;
+  burst->psd = Create<SpectrumValue> (BlePhy::GetBleSpectrumModel ());
+  for (uint32_t i = firstJammed; i < firstJammed + jammedChannels && i < 37; i++)
+    {
+      (*burst->psd)[i + 3] = jammerPower / 2e6;
+    }
+  Simulator::Schedule (Seconds (0), &Jam, helper.GetChannel (), burst);
+
+  Simulator::Stop (Seconds (duration));
+  Simulator::Run ();
+  Simulator::Destroy ();
+  return result;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t jammedChannels = 10;
+  uint32_t firstJammed = 0;
+  double jammerPower = 0.01;
+  double interval = 0.01;
+  uint32_t packetSize = 20;
+  double duration = 60;
+  Time afhInterval = Seconds (1);
+
+  CommandLine cmd;
+  cmd.AddValue ("jammedChannels", "Number of data channel indices the interferer occupies",
+                jammedChannels);
+  cmd.AddValue ("firstJammed", "First data channel index the interferer occupies", firstJammed);
+  cmd.AddValue ("jammerPower", "Power of the interferer per channel index, in W", jammerPower);
+  cmd.AddValue ("interval", "Time between two packets of the master, in s", interval);
+  cmd.AddValue ("packetSize", "Size of the packets of the master", packetSize);
+  cmd.AddValue ("duration", "Simulated time in seconds", duration);
+  cmd.AddValue ("afhInterval", "AfhInterval of the link managers in the AFH run", afhInterval);
+  cmd.Parse (argc, argv);
+
+  AfhResult fixed = RunScenario (Seconds (0), jammedChannels, firstJammed, jammerPower,
+                                 interval, packetSize, duration);
+  AfhResult adaptive = RunScenario (afhInterval, jammedChannels, firstJammed, jammerPower,
+                                    interval, packetSize, duration);
+
+  std::cout << "jammedChannels=" << jammedChannels << " firstJammed=" << firstJammed
+            << " jammerPower=" << jammerPower << "W duration=" << duration << "s"
+            << std::endl;
+  std::cout << "fixed map: " << 8e-3 * fixed.rxBytes / duration << " kbps, "
+            << fixed.rxErrors << " CRC errors" << std::endl;
+  std::cout << "AFH:       " << 8e-3 * adaptive.rxBytes / duration << " kbps, "
+            << adaptive.rxErrors << " CRC errors, "
+            << adaptive.mapUpdates << " map updates" << std::endl;
+  return 0;
+}
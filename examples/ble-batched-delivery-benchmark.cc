@@ -0,0 +1,144 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Event counts of the broadcast scenario of ble.cc with and without the
+ * BatchedDelivery of BleSpectrumChannel. The same scenario is run once
+ * per mode, and the events the simulator executed and the delivery
+ * events the channel scheduled are printed for both.
+ *
+ * Without batching, a transmission heard by R receivers costs R StartRx
+ * events and R EndRx events. With it, the receivers whose propagation
+ * delays round to the same multiple of --batchResolution share one start
+ * and one end event; in the 100 m square of the scenario that is all of
+ * them, so every transmission costs two events.
+ *
+ *   ./waf --run "ble-batched-delivery-benchmark --nodes=20"
+ */
+
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/ble-module.h>
+
+#include <iostream>
+
+using namespace ns3;
+
+/**
+ * Remember the number of delivery events of the channel.
+ *
+ * \param count where to store it
+ * \param oldValue previous count
+ * \param newValue current count
+ */
+static void
+RxEventsChanged (uint64_t *count, uint64_t oldValue, uint64_t newValue)
+{
+  *count = newValue;
+}
+
+/**
+ * Run the broadcast scenario once.
+ *
+ * \param batched whether the channel batches deliveries
+ * \param nodes number of nodes
+ * \param devicesPerNode BLE devices on every node
+ * \param duration simulated time in seconds
+ * \param rxEvents set to the delivery events the channel scheduled
+ * \return the number of events the simulator executed
+ */
+static uint64_t
+RunScenario (bool batched, uint32_t nodes, uint32_t devicesPerNode, double duration,
+             uint64_t &rxEvents)
+{
+  Config::SetDefault ("ns3::BleSpectrumChannel::BatchedDelivery", BooleanValue (batched));
+  RngSeedManager::SetRun (1);
+
+  double length = 100;
+  Ptr<UniformRandomVariable> randT = CreateObject<UniformRandomVariable> ();
+  randT->SetAttribute ("Max", DoubleValue (600));
+
+  NodeContainer bleDeviceNodes;
+  bleDeviceNodes.Create (nodes);
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> nodePositionList = CreateObject<ListPositionAllocator> ();
+  for (uint32_t i = 0; i < nodes; i++)
+    {
+      nodePositionList->Add (Vector (randT->GetInteger (0, length),
+                                     randT->GetInteger (0, length), 1.0));
+    }
+  mobility.SetPositionAllocator (nodePositionList);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (bleDeviceNodes);
+
+  BleHelper helper;
+  NetDeviceContainer bleNetDevices;
+  for (uint32_t i = 0; i < devicesPerNode; i++)
+    {
+      bleNetDevices.Add (helper.Install (bleDeviceNodes));
+    }
+  helper.CreateAllLinks (bleNetDevices, true, 3200);
+  helper.CreateBroadcastLink (bleNetDevices, true, 3200, true);
+  helper.GenerateTraffic (randT, bleDeviceNodes, 20, 0, duration, 5);
+
+  rxEvents = 0;
+  helper.GetChannel ()->TraceConnectWithoutContext ("RxEvents",
+                                                    MakeBoundCallback (&RxEventsChanged, &rxEvents));
+
+  Simulator::Stop (Seconds (duration));
+  Simulator::Run ();
+  uint64_t events = Simulator::GetEventCount ();
+  Simulator::Destroy ();
+  return events;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t nodes = 20;
+  uint32_t devicesPerNode = 1;
+  double duration = 20;
+  Time batchResolution = MicroSeconds (1);
+
+  CommandLine cmd;
+  cmd.AddValue ("nodes", "Number of nodes", nodes);
+  cmd.AddValue ("devicesPerNode", "BLE devices on every node", devicesPerNode);
+  cmd.AddValue ("duration", "Simulated time in seconds", duration);
+  cmd.AddValue ("batchResolution", "BatchResolution of the channel", batchResolution);
+  cmd.Parse (argc, argv);
+
+  Config::SetDefault ("ns3::BleSpectrumChannel::BatchResolution", TimeValue (batchResolution));
+
+  uint64_t perReceiverRxEvents;
+  uint64_t batchedRxEvents;
+  uint64_t perReceiver = RunScenario (false, nodes, devicesPerNode, duration, perReceiverRxEvents);
+  uint64_t batched = RunScenario (true, nodes, devicesPerNode, duration, batchedRxEvents);
+
+  std::cout << "nodes=" << nodes << " devicesPerNode=" << devicesPerNode
+            << " duration=" << duration << "s" << std::endl;
+  std::cout << "per receiver: " << perReceiver << " events, "
+            << perReceiverRxEvents << " channel events" << std::endl;
+  std::cout << "batched:      " << batched << " events, "
+            << batchedRxEvents << " channel events" << std::endl;
+  std::cout << "saved:        "
+            << (perReceiver > 0 ? 100.0 * (double (perReceiver) - batched) / perReceiver : 0)
+            << "% of all events" << std::endl;
+  return 0;
+}
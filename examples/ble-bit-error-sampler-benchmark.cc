@@ -0,0 +1,94 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Microbenchmark of the bit error samplers BlePhy::UpdateBer can use.
+ * Draws the bit errors of the same intervals with the per-bit sampler
+ * and with the binomial sampler, and prints the time per draw, the mean
+ * number of errors of each, and the speedup.
+ *
+ *   ./waf --run "ble-bit-error-sampler-benchmark --bits=2120 --ber=1e-4"
+ */
+
+#include <ns3/core-module.h>
+#include <ns3/ble-bit-error-sampler.h>
+
+#include <iostream>
+
+using namespace ns3;
+
+/**
+ * \param sampler the sampler
+ * \param bits bits per draw
+ * \param ber bit error rate
+ * \param draws number of draws
+ * \param errors set to the mean number of bit errors per draw
+ * \return the wall clock time of all draws, in ms
+ */
+static int64_t
+RunSampler (Ptr<BleBitErrorSampler> sampler, uint32_t bits, double ber, uint32_t draws,
+            double &errors)
+{
+  SystemWallClockMs clock;
+  uint64_t total = 0;
+  clock.Start ();
+  for (uint32_t i = 0; i < draws; i++)
+    {
+      total += sampler->GetBitErrors (bits, ber);
+    }
+  int64_t ms = clock.End ();
+  errors = double (total) / draws;
+  return ms;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t bits = 2120; // a 265 octet PDU
+  double ber = 1e-4;
+  uint32_t draws = 100000;
+
+  CommandLine cmd;
+  cmd.AddValue ("bits", "Bits per draw", bits);
+  cmd.AddValue ("ber", "Bit error rate", ber);
+  cmd.AddValue ("draws", "Number of draws per sampler", draws);
+  cmd.Parse (argc, argv);
+
+  Ptr<BleBitErrorSampler> perBit = CreateObject<BlePerBitErrorSampler> ();
+  Ptr<BleBitErrorSampler> binomial = CreateObject<BleBinomialBitErrorSampler> ();
+  perBit->AssignStreams (1);
+  binomial->AssignStreams (2);
+
+  double perBitErrors;
+  double binomialErrors;
+  int64_t perBitMs = RunSampler (perBit, bits, ber, draws, perBitErrors);
+  int64_t binomialMs = RunSampler (binomial, bits, ber, draws, binomialErrors);
+
+  std::cout << "bits=" << bits << " ber=" << ber << " draws=" << draws
+            << " expected errors/draw=" << bits * ber << std::endl;
+  std::cout << "per-bit:  " << perBitMs << " ms, "
+            << 1e6 * perBitMs / draws << " ns/draw, "
+            << perBitErrors << " errors/draw" << std::endl;
+  std::cout << "binomial: " << binomialMs << " ms, "
+            << 1e6 * binomialMs / draws << " ns/draw, "
+            << binomialErrors << " errors/draw" << std::endl;
+  std::cout << "speedup:  "
+            << (binomialMs > 0 ? double (perBitMs) / binomialMs : 0) << std::endl;
+  return 0;
+}
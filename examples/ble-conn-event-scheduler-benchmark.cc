@@ -0,0 +1,235 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Connection events of many links scheduled from the simulator's event
+ * queue, the way BleLinkManager does without a BleConnEventScheduler, and
+ * from the timer wheel. Every link opens a transmit window at each of its
+ * connection events and closes it a little later, in the context of its
+ * node. For 100, 1000 and 10000 links (or --links), the wall clock time,
+ * the timers run per second, the simulator events executed, and the
+ * largest number of events waiting in the simulator's queue are printed.
+ *
+ *   ./waf --run "ble-conn-event-scheduler-benchmark --duration=10 --linksPerNode=4"
+ */
+
+#include <ns3/core-module.h>
+#include <ns3/ble-conn-event-scheduler.h>
+
+#include <iostream>
+#include <algorithm>
+
+using namespace ns3;
+
+/**
+ * The connection events of one emulated link.
+ */
+struct BenchmarkLink
+{
+  Ptr<BleConnEventScheduler> wheel; //!< the wheel, or 0 for the simulator
+  uint32_t context;                 //!< node the link runs in
+  Time interval;                    //!< connection interval
+};
+
+static uint64_t g_timers = 0;     //!< timers that ran
+static uint64_t g_scheduled = 0;  //!< simulator events scheduled by the links
+static uint64_t g_peakQueue = 0;  //!< most events waiting in the simulator's queue
+static uint64_t g_wheelEvents = 0; //!< simulator events scheduled by the wheel
+
+/**
+ * Remember the number of simulator events of the wheel.
+ *
+ * \param oldValue previous count
+ * \param newValue current count
+ */
+static void
+WheelEventsChanged (uint64_t oldValue, uint64_t newValue)
+{
+  g_wheelEvents = newValue;
+}
+
+/// Sample the number of events waiting in the simulator's queue.
+static void
+SampleQueue (void)
+{
+  uint64_t scheduled = g_scheduled + g_wheelEvents;
+  uint64_t executed = Simulator::GetEventCount ();
+  if (scheduled > executed)
+    {
+      g_peakQueue = std::max (g_peakQueue, scheduled - executed);
+    }
+}
+
+static void StartWindow (BenchmarkLink *link);
+
+/**
+ * Close the transmit window of a link and schedule its next event.
+ *
+ * \param link the link
+ */
+static void
+EndWindow (BenchmarkLink *link)
+{
+  g_timers++;
+  SampleQueue ();
+  Time delay = link->interval - MicroSeconds (1250);
+  if (link->wheel != 0)
+    {
+      link->wheel->ScheduleWithContext (link->context, delay,
+                                        MakeBoundCallback (&StartWindow, link));
+    }
+  else
+    {
+      Simulator::Schedule (delay, &StartWindow, link);
+      g_scheduled++;
+    }
+}
+
+/**
+ * Open the transmit window of a link and schedule its end.
+ *
+ * \param link the link
+ */
+static void
+StartWindow (BenchmarkLink *link)
+{
+  g_timers++;
+  SampleQueue ();
+  if (link->wheel != 0)
+    {
+      link->wheel->ScheduleWithContext (link->context, MicroSeconds (1250),
+                                        MakeBoundCallback (&EndWindow, link));
+    }
+  else
+    {
+      Simulator::Schedule (MicroSeconds (1250), &EndWindow, link);
+      g_scheduled++;
+    }
+}
+
+/**
+ * Run the links once.
+ *
+ * \param useWheel whether to schedule from the wheel
+ * \param nLinks number of links
+ * \param linksPerNode links that share a node context
+ * \param duration simulated time
+ * \param wallMs set to the wall clock time of the run, in ms
+ * \return the number of events the simulator executed
+ */
+static uint64_t
+RunLinks (bool useWheel, uint32_t nLinks, uint32_t linksPerNode, Time duration, int64_t &wallMs)
+{
+  RngSeedManager::SetRun (1);
+  Ptr<UniformRandomVariable> rand = CreateObject<UniformRandomVariable> ();
+  Ptr<BleConnEventScheduler> wheel;
+  if (useWheel)
+    {
+      wheel = CreateObject<BleConnEventScheduler> ();
+      wheel->TraceConnectWithoutContext ("SimulatorEvents", MakeCallback (&WheelEventsChanged));
+    }
+  g_timers = 0;
+  g_scheduled = 0;
+  g_peakQueue = 0;
+  g_wheelEvents = 0;
+
+  // Intervals of 7.5 ms to 100 ms, in steps of 1.25 ms, and the first
+  // events spread over the first interval.
+  std::vector<BenchmarkLink> links (nLinks);
+  for (uint32_t i = 0; i < nLinks; i++)
+    {
+      links[i].wheel = wheel;
+      links[i].context = i / linksPerNode;
+      links[i].interval = MicroSeconds (1250 * rand->GetInteger (6, 80));
+      Time offset = MicroSeconds (1250 * rand->GetInteger (1, 80));
+      if (useWheel)
+        {
+          wheel->ScheduleWithContext (links[i].context, offset,
+                                      MakeBoundCallback (&StartWindow, &links[i]));
+        }
+      else
+        {
+          Simulator::ScheduleWithContext (links[i].context, offset, &StartWindow, &links[i]);
+          g_scheduled++;
+        }
+    }
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  Simulator::Stop (duration);
+  Simulator::Run ();
+  wallMs = clock.End ();
+  uint64_t events = Simulator::GetEventCount ();
+  if (wheel != 0)
+    {
+      wheel->Dispose ();
+    }
+  Simulator::Destroy ();
+  return events;
+}
+
+/**
+ * Run both schemes for a number of links and print the results.
+ *
+ * \param nLinks number of links
+ * \param linksPerNode links that share a node context
+ * \param duration simulated time
+ */
+static void
+Compare (uint32_t nLinks, uint32_t linksPerNode, Time duration)
+{
+  std::cout << "links=" << nLinks << " linksPerNode=" << linksPerNode
+            << " duration=" << duration.GetSeconds () << "s" << std::endl;
+  const char *names[] = { "simulator: ", "wheel:     " };
+  for (uint32_t mode = 0; mode < 2; mode++)
+    {
+      int64_t wallMs;
+      uint64_t events = RunLinks (mode == 1, nLinks, linksPerNode, duration, wallMs);
+      std::cout << "  " << names[mode] << wallMs << " ms, "
+                << (wallMs > 0 ? 1000.0 * g_timers / wallMs : 0) << " timers/s, "
+                << events << " events, peak queue " << g_peakQueue << std::endl;
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t nLinks = 0;
+  uint32_t linksPerNode = 4;
+  double duration = 10;
+
+  CommandLine cmd;
+  cmd.AddValue ("links", "Number of links, or 0 for 100, 1000 and 10000", nLinks);
+  cmd.AddValue ("linksPerNode", "Links that run in the same node context", linksPerNode);
+  cmd.AddValue ("duration", "Simulated time in seconds", duration);
+  cmd.Parse (argc, argv);
+
+  if (nLinks > 0)
+    {
+      Compare (nLinks, linksPerNode, Seconds (duration));
+    }
+  else
+    {
+      for (uint32_t n = 100; n <= 10000; n *= 10)
+        {
+          Compare (n, linksPerNode, Seconds (duration));
+        }
+    }
+  return 0;
+}
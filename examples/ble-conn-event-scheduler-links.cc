@@ -0,0 +1,159 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Simulator events spent on the connection events of real links, without
+ * a BleConnEventScheduler and with one, with and without its
+ * KeepNodeContext. Every link has its own pair of nodes, so the master and
+ * the slave of a link, and every link, run in their own node context. The
+ * pairs stand far apart on a grid and the links carry no traffic. For
+ * 100, 1000 and 10000 links (up to --maxLinks) the wall clock time, the
+ * simulator events executed, and the events scheduled by the wheel are
+ * printed.
+ *
+ *   ./waf --run "ble-conn-event-scheduler-links --interval=24 --duration=2"
+ */
+
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/ble-module.h>
+
+#include <cmath>
+#include <iostream>
+
+using namespace ns3;
+
+/**
+ * Remember the number of simulator events of the wheel.
+ *
+ * \param count where to store it
+ * \param oldValue previous count
+ * \param newValue current count
+ */
+static void
+WheelEventsChanged (uint64_t *count, uint64_t oldValue, uint64_t newValue)
+{
+  *count = newValue;
+}
+
+/**
+ * Run the links once.
+ *
+ * \param mode 0 without the wheel, 1 with it, 2 with it and KeepNodeContext
+ * \param nLinks number of links
+ * \param interval connection interval, in units of 1.25 ms
+ * \param duration simulated time
+ * \param wallMs set to the wall clock time of the run, in ms
+ * \param wheelEvents set to the simulator events scheduled by the wheel
+ * \return the number of events the simulator executed
+ */
+static uint64_t
+RunLinks (uint32_t mode, uint32_t nLinks, uint32_t interval, Time duration,
+          int64_t &wallMs, uint64_t &wheelEvents)
+{
+  RngSeedManager::SetRun (1);
+  // Only the nodes of a link hear each other.
+  Config::SetDefault ("ns3::BleSpectrumChannel::SpatialIndex", BooleanValue (true));
+  Config::SetDefault ("ns3::BleSpectrumChannel::MaxInterferenceRange", DoubleValue (50));
+  Config::SetDefault ("ns3::BleSpectrumChannel::PathLossCache", BooleanValue (false));
+
+  NodeContainer nodes;
+  nodes.Create (2 * nLinks);
+  uint32_t columns = std::ceil (std::sqrt (double (nLinks)));
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  for (uint32_t i = 0; i < nLinks; i++)
+    {
+      Vector master (100.0 * (i % columns), 100.0 * (i / columns), 1);
+      positions->Add (master);
+      positions->Add (Vector (master.x + 5, master.y, 1));
+    }
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (nodes);
+
+  BleHelper helper;
+  Ptr<BleConnEventScheduler> wheel;
+  wheelEvents = 0;
+  if (mode > 0)
+    {
+      wheel = CreateObject<BleConnEventScheduler> ();
+      wheel->SetAttribute ("KeepNodeContext", BooleanValue (mode == 2));
+      wheel->TraceConnectWithoutContext ("SimulatorEvents",
+                                         MakeBoundCallback (&WheelEventsChanged, &wheelEvents));
+      helper.SetConnEventScheduler (wheel);
+    }
+  NetDeviceContainer devices = helper.Install (nodes);
+  // The anchors spread over the interval, as CreateAllLinks does for a mesh
+  for (uint32_t i = 0; i < nLinks; i++)
+    {
+      Ptr<BleNetDevice> master = DynamicCast<BleNetDevice> (devices.Get (2 * i));
+      Ptr<BleNetDevice> slave = DynamicCast<BleNetDevice> (devices.Get (2 * i + 1));
+      master->GetBBManager ()->CreateLinkScheduled (slave->GetBBManager (),
+                                                    BleLinkManager::MASTER_ROLE, true,
+                                                    i % interval, interval);
+    }
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  Simulator::Stop (duration);
+  Simulator::Run ();
+  wallMs = clock.End ();
+  uint64_t events = Simulator::GetEventCount ();
+  if (wheel != 0)
+    {
+      wheel->Dispose ();
+    }
+  Simulator::Destroy ();
+  return events;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t maxLinks = 10000;
+  uint32_t interval = 24;
+  double duration = 2;
+
+  CommandLine cmd;
+  cmd.AddValue ("maxLinks", "Largest number of links of the sweep", maxLinks);
+  cmd.AddValue ("interval", "Connection interval, in units of 1.25 ms", interval);
+  cmd.AddValue ("duration", "Simulated time in seconds", duration);
+  cmd.Parse (argc, argv);
+
+  std::cout << "interval=" << 1.25 * interval << "ms duration=" << duration << "s"
+            << std::endl;
+  const char *names[] = { "  simulator:             ", "  wheel:                 ",
+                          "  wheel, node contexts:  " };
+  for (uint32_t nLinks = 100; nLinks <= maxLinks; nLinks *= 10)
+    {
+      std::cout << "links=" << nLinks << std::endl;
+      for (uint32_t mode = 0; mode < 3; mode++)
+        {
+          int64_t wallMs;
+          uint64_t wheelEvents;
+          uint64_t events = RunLinks (mode, nLinks, interval, Seconds (duration),
+                                      wallMs, wheelEvents);
+          std::cout << names[mode] << wallMs << " ms, " << events << " events, "
+                    << wheelEvents << " from the wheel" << std::endl;
+        }
+    }
+  return 0;
+}
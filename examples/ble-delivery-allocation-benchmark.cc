@@ -0,0 +1,201 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Heap allocations per delivered packet on the path from the channel to
+ * the receiving BlePhys. One transmitter sends a PDU to a number of
+ * receivers tuned to its channel index, a number of times; every
+ * allocation made from the transmission up to the reception callbacks is
+ * counted, and divided by the number of packets the receivers got. With
+ * --payload=0 the PDU is an empty PDU, shared by all transmissions as a
+ * link manager does on an idle link. The run is made with the signal
+ * parameters of the receivers allocated for every delivery and with
+ * ReuseSignalParameters; the events that start and end the receptions
+ * are allocated in both.
+ *
+ *   ./waf --run "ble-delivery-allocation-benchmark --receivers=10 --payload=0"
+ */
+
+#include <ns3/core-module.h>
+#include <ns3/packet.h>
+#include <ns3/ble-phy.h>
+#include <ns3/ble-mac-header.h>
+#include <ns3/ble-spectrum-channel.h>
+#include <ns3/ble-spectrum-signal-parameters.h>
+
+#include <iostream>
+#include <cstdlib>
+#include <new>
+
+using namespace ns3;
+
+static uint64_t g_allocations = 0; //!< calls of operator new
+static uint64_t g_received = 0;    //!< packets handed to the receivers
+static Ptr<Packet> g_emptyPdu;     //!< empty PDU shared by the transmissions
+static Ptr<BleSpectrumSignalParameters> g_txParams; //!< of the last transmission
+
+void *
+operator new (std::size_t size)
+{
+  g_allocations++;
+  void *p = std::malloc (size ? size : 1);
+  if (p == 0)
+    {
+      throw std::bad_alloc ();
+    }
+  return p;
+}
+
+void
+operator delete (void *p) noexcept
+{
+  std::free (p);
+}
+
+void
+operator delete (void *p, std::size_t) noexcept
+{
+  std::free (p);
+}
+
+/**
+ * Count a reception.
+ *
+ * \param packet the received packet
+ * \param error whether it was received in error
+ */
+static void
+Received (Ptr<const Packet> packet, bool error)
+{
+  g_received++;
+}
+
+/**
+ * Transmit one PDU the way BlePhy::StartTx does.
+ *
+ * \param channel the channel
+ * \param tx the transmitter
+ * \param payload payload size in octets, 0 for the shared empty PDU
+ */
+static void
+Transmit (Ptr<BleSpectrumChannel> channel, Ptr<BlePhy> tx, uint32_t payload)
+{
+  BleMacHeader header;
+  header.SetLength (payload);
+  Ptr<Packet> packet = g_emptyPdu;
+  if (payload > 0)
+    {
+      packet = Create<Packet> (payload);
+      packet->AddHeader (header);
+    }
+  if (g_txParams == 0 || g_txParams->GetReferenceCount () > 1)
+    {
+      g_txParams = Create<BleSpectrumSignalParameters> ();
+    }
+  Ptr<BleSpectrumSignalParameters> params = g_txParams;
+  params->duration = tx->GetAirtime (payload);
+  params->packet = packet;
+  params->txPhy = tx;
+  if (params->psd == 0)
+    {
+      params->psd = Create<SpectrumValue> (BlePhy::GetBleSpectrumModel ());
+    }
+  (*params->psd)[tx->GetChannelIndex () + 3] = 1e-3;
+  params->SetChannel (tx->GetChannelIndex ());
+  params->SetHeader (header);
+  channel->StartTx (params);
+}
+
+/**
+ * Run the transmissions once.
+ *
+ * \param reuse the ReuseSignalParameters of the channel
+ * \param receivers number of receivers
+ * \param payload payload size in octets
+ * \param packets number of transmissions
+ * \return the number of allocations made while the simulator ran
+ */
+static uint64_t
+RunDeliveries (bool reuse, uint32_t receivers, uint32_t payload, uint32_t packets)
+{
+  Ptr<BleSpectrumChannel> channel = CreateObject<BleSpectrumChannel> ();
+  channel->SetAttribute ("ReuseSignalParameters", BooleanValue (reuse));
+  Ptr<BlePhy> tx = CreateObject<BlePhy> ();
+  std::vector<Ptr<BlePhy> > phys;
+  for (uint32_t i = 0; i < receivers; i++)
+    {
+      Ptr<BlePhy> phy = CreateObject<BlePhy> ();
+      phy->SetChannel (channel);
+      phy->SetReceptionEndCallback (MakeCallback (&Received));
+      phys.push_back (phy);
+    }
+  BleMacHeader header;
+  g_emptyPdu = Create<Packet> ();
+  g_emptyPdu->AddHeader (header);
+
+  // Every millisecond the receivers start listening, and the PDU is sent
+  // once their receiver is up.
+  for (uint32_t i = 0; i < packets; i++)
+    {
+      Time start = MilliSeconds (i + 1);
+      for (uint32_t j = 0; j < receivers; j++)
+        {
+          Simulator::Schedule (start, &BlePhy::PrepareRX, phys[j]);
+        }
+      Simulator::Schedule (start + MicroSeconds (RX_PREP_TIME + 1), &Transmit,
+                           channel, tx, payload);
+    }
+
+  g_received = 0;
+  uint64_t before = g_allocations;
+  Simulator::Run ();
+  uint64_t allocations = g_allocations - before;
+  g_txParams = 0;
+  g_emptyPdu = 0;
+  channel->Dispose ();
+  Simulator::Destroy ();
+  return allocations;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t receivers = 10;
+  uint32_t payload = 27;
+  uint32_t packets = 1000;
+
+  CommandLine cmd;
+  cmd.AddValue ("receivers", "Number of receivers", receivers);
+  cmd.AddValue ("payload", "Payload size in octets, 0 for empty PDUs", payload);
+  cmd.AddValue ("packets", "Number of transmissions", packets);
+  cmd.Parse (argc, argv);
+
+  std::cout << "receivers=" << receivers << " payload=" << payload
+            << " packets=" << packets << std::endl;
+  const char *names[] = { "allocated: ", "reused:    " };
+  for (uint32_t mode = 0; mode < 2; mode++)
+    {
+      uint64_t allocations = RunDeliveries (mode == 1, receivers, payload, packets);
+      std::cout << names[mode] << g_received << " delivered, " << allocations
+                << " allocations, "
+                << (g_received > 0 ? double (allocations) / g_received : 0)
+                << " per delivered packet" << std::endl;
+    }
+  return 0;
+}
@@ -0,0 +1,174 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Throughput of one point-to-point link with connection events that end
+ * with their transmit window, and with events the master extends while
+ * either end has more data. The master sends a packet every --interval
+ * to the slave, --distance away; a larger distance loses more PDUs, so
+ * the ends more often disagree on whether there is more data. For both
+ * settings the bytes the slave received, the mean number of PDUs per
+ * event at the master, and the time the radio of the slave spent
+ * receiving are printed.
+ *
+ *   ./waf --run "ble-event-extension-benchmark --maxEventLength=25ms --distance=20"
+ */
+
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/ble-module.h>
+
+#include <iostream>
+
+using namespace ns3;
+
+/// What a run of the benchmark measured
+struct ExtensionResult
+{
+  uint64_t rxBytes;    //!< bytes the slave passed up
+  uint64_t events;     //!< connection events of the master
+  uint64_t pdus;       //!< PDUs the master sent and received in them
+  Time slaveRxTime;    //!< time the radio of the slave was receiving
+};
+
+/**
+ * Count the bytes of a received packet.
+ *
+ * \param result where to count
+ * \param packet the packet
+ */
+static void
+Received (ExtensionResult *result, Ptr<const Packet> packet)
+{
+  result->rxBytes += packet->GetSize ();
+}
+
+/**
+ * Count the PDUs of a connection event.
+ *
+ * \param result where to count
+ * \param nbPdus PDUs sent and received in the event
+ */
+static void
+EventEnded (ExtensionResult *result, uint32_t nbPdus)
+{
+  result->events++;
+  result->pdus += nbPdus;
+}
+
+/**
+ * Run the link once.
+ *
+ * \param maxEventLength the MaxConnectionEventLength of the link managers
+ * \param distance distance between the ends, in m
+ * \param interval time between two packets of the master, in s
+ * \param packetSize size of those packets
+ * \param duration simulated time in seconds
+ * \return what was measured
+ */
+static ExtensionResult
+RunLink (Time maxEventLength, double distance, double interval, uint32_t packetSize,
+         double duration)
+{
+  Config::SetDefault ("ns3::BleLinkManager::MaxConnectionEventLength",
+                      TimeValue (maxEventLength));
+  RngSeedManager::SetRun (1);
+  ExtensionResult result = { 0, 0, 0, Seconds (0) };
+
+  NodeContainer nodes;
+  nodes.Create (2);
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0, 0, 1));
+  positions->Add (Vector (distance, 0, 1));
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (nodes);
+
+  BleHelper helper;
+  NetDeviceContainer devices = helper.Install (nodes);
+  // One link, the first node is its master, with a 30 ms interval
+  helper.CreateAllLinks (devices, true, 24);
+  Ptr<UniformRandomVariable> start = CreateObject<UniformRandomVariable> ();
+  start->SetAttribute ("Max", DoubleValue (0.1));
+  helper.GenerateTraffic (start, nodes, packetSize, 1, duration - 1, interval);
+
+  Ptr<BleNetDevice> master = DynamicCast<BleNetDevice> (devices.Get (0));
+  Ptr<BleNetDevice> slave = DynamicCast<BleNetDevice> (devices.Get (1));
+  slave->TraceConnectWithoutContext ("MacRx", MakeBoundCallback (&Received, &result));
+  std::list<Ptr<BleLinkManager> > linkManagers = master->GetBBManager ()->GetLinkManagers ();
+  for (std::list<Ptr<BleLinkManager> >::iterator it = linkManagers.begin ();
+       it != linkManagers.end (); ++it)
+    {
+      (*it)->TraceConnectWithoutContext ("PdusPerEvent",
+                                         MakeBoundCallback (&EventEnded, &result));
+    }
+
+  Simulator::Stop (Seconds (duration));
+  Simulator::Run ();
+  result.slaveRxTime = slave->GetPhy ()->GetTotalRxTime ();
+  Simulator::Destroy ();
+  return result;
+}
+
+/**
+ * Print the results of a run.
+ *
+ * \param name the setting
+ * \param result what was measured
+ * \param duration simulated time in seconds
+ */
+static void
+Print (std::string name, const ExtensionResult &result, double duration)
+{
+  std::cout << name << 8e-3 * result.rxBytes / duration << " kbps, "
+            << (result.events > 0 ? double (result.pdus) / result.events : 0)
+            << " PDUs/event, slave RX " << result.slaveRxTime.GetSeconds () << "s"
+            << std::endl;
+}
+
+int
+main (int argc, char *argv[])
+{
+  Time maxEventLength = MilliSeconds (25);
+  double distance = 5;
+  double interval = 0.002;
+  uint32_t packetSize = 20;
+  double duration = 30;
+
+  CommandLine cmd;
+  cmd.AddValue ("maxEventLength", "MaxConnectionEventLength of the extended run",
+                maxEventLength);
+  cmd.AddValue ("distance", "Distance between the ends, in m", distance);
+  cmd.AddValue ("interval", "Time between two packets of the master, in s", interval);
+  cmd.AddValue ("packetSize", "Size of the packets of the master", packetSize);
+  cmd.AddValue ("duration", "Simulated time in seconds", duration);
+  cmd.Parse (argc, argv);
+
+  ExtensionResult window = RunLink (Seconds (0), distance, interval, packetSize, duration);
+  ExtensionResult extended = RunLink (maxEventLength, distance, interval, packetSize, duration);
+
+  std::cout << "distance=" << distance << "m interval=" << interval
+            << "s packetSize=" << packetSize << " duration=" << duration << "s"
+            << std::endl;
+  Print ("window only: ", window, duration);
+  Print ("extended:    ", extended, duration);
+  return 0;
+}
@@ -0,0 +1,159 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Throughput of one point-to-point link for a range of payload lengths.
+ * Both ends support LL payloads of --dataLength octets; payloads longer
+ * than the negotiated data length are sent in fragments. The master
+ * offers a packet every --interval to the slave, more than the link can
+ * carry, and extends its connection events up to --maxEventLength. For
+ * every payload length the application throughput at the slave, the
+ * payloads delivered and the mean number of PDUs per event at the master
+ * are printed.
+ *
+ *   ./waf --run "ble-payload-length-sweep --dataLength=251 --duration=20"
+ */
+
+#include <ns3/core-module.h>
+#include <ns3/network-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/ble-module.h>
+
+#include <iostream>
+
+using namespace ns3;
+
+/// What a run of the sweep measured
+struct SweepResult
+{
+  uint64_t rxPayloads; //!< payloads the slave passed up
+  uint64_t events;     //!< connection events of the master
+  uint64_t pdus;       //!< PDUs the master sent and received in them
+};
+
+/**
+ * Count a received payload.
+ *
+ * \param result where to count
+ * \param packet the payload
+ */
+static void
+Received (SweepResult *result, Ptr<const Packet> packet)
+{
+  result->rxPayloads++;
+}
+
+/**
+ * Count the PDUs of a connection event.
+ *
+ * \param result where to count
+ * \param nbPdus PDUs sent and received in the event
+ */
+static void
+EventEnded (SweepResult *result, uint32_t nbPdus)
+{
+  result->events++;
+  result->pdus += nbPdus;
+}
+
+/**
+ * Run the link once.
+ *
+ * \param payloadSize size of the packets of the master
+ * \param interval time between two packets of the master, in s
+ * \param duration simulated time in seconds
+ * \return what was measured
+ */
+static SweepResult
+RunLink (uint32_t payloadSize, double interval, double duration)
+{
+  RngSeedManager::SetRun (1);
+  SweepResult result = { 0, 0, 0 };
+
+  NodeContainer nodes;
+  nodes.Create (2);
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  positions->Add (Vector (0, 0, 1));
+  positions->Add (Vector (2, 0, 1));
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (nodes);
+
+  BleHelper helper;
+  NetDeviceContainer devices = helper.Install (nodes);
+  // One link, the first node is its master, with a 30 ms interval
+  helper.CreateAllLinks (devices, true, 24);
+  Ptr<UniformRandomVariable> start = CreateObject<UniformRandomVariable> ();
+  start->SetAttribute ("Max", DoubleValue (0.1));
+  helper.GenerateTraffic (start, nodes, payloadSize, 1, duration - 1, interval);
+
+  Ptr<BleNetDevice> master = DynamicCast<BleNetDevice> (devices.Get (0));
+  Ptr<BleNetDevice> slave = DynamicCast<BleNetDevice> (devices.Get (1));
+  slave->TraceConnectWithoutContext ("MacRx", MakeBoundCallback (&Received, &result));
+  std::list<Ptr<BleLinkManager> > linkManagers = master->GetBBManager ()->GetLinkManagers ();
+  for (std::list<Ptr<BleLinkManager> >::iterator it = linkManagers.begin ();
+       it != linkManagers.end (); ++it)
+    {
+      (*it)->TraceConnectWithoutContext ("PdusPerEvent",
+                                         MakeBoundCallback (&EventEnded, &result));
+    }
+
+  Simulator::Stop (Seconds (duration));
+  Simulator::Run ();
+  Simulator::Destroy ();
+  return result;
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t dataLength = 251;
+  Time maxEventLength = MilliSeconds (25);
+  double interval = 0.0005;
+  double duration = 20;
+
+  CommandLine cmd;
+  cmd.AddValue ("dataLength", "MaxTxOctets and MaxRxOctets of both ends", dataLength);
+  cmd.AddValue ("maxEventLength", "MaxConnectionEventLength of the link managers",
+                maxEventLength);
+  cmd.AddValue ("interval", "Time between two packets of the master, in s", interval);
+  cmd.AddValue ("duration", "Simulated time in seconds", duration);
+  cmd.Parse (argc, argv);
+
+  Config::SetDefault ("ns3::BleLinkManager::MaxTxOctets", UintegerValue (dataLength));
+  Config::SetDefault ("ns3::BleLinkManager::MaxRxOctets", UintegerValue (dataLength));
+  Config::SetDefault ("ns3::BleLinkManager::MaxConnectionEventLength",
+                      TimeValue (maxEventLength));
+
+  std::cout << "dataLength=" << dataLength << " maxEventLength="
+            << maxEventLength.GetMilliSeconds () << "ms interval=" << interval
+            << "s duration=" << duration << "s" << std::endl;
+  const uint32_t payloadSizes[] = { 20, 27, 50, 100, 150, 200, 251, 300, 500, 1000, 1500 };
+  for (uint32_t i = 0; i < sizeof (payloadSizes) / sizeof (payloadSizes[0]); i++)
+    {
+      SweepResult result = RunLink (payloadSizes[i], interval, duration);
+      std::cout << "payload " << payloadSizes[i] << ": "
+                << 8e-3 * result.rxPayloads * payloadSizes[i] / duration << " kbps, "
+                << result.rxPayloads << " payloads, "
+                << (result.events > 0 ? double (result.pdus) / result.events : 0)
+                << " PDUs/event" << std::endl;
+    }
+  return 0;
+}
@@ -0,0 +1,166 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+/*
+ * Cost of a transmission as the number of nodes grows at a constant
+ * density, with and without the SpatialIndex of BleSpectrumChannel.
+ * The nodes stand still at random positions in a square whose area grows
+ * with their number, all tuned to the same channel index, and random
+ * nodes transmit one after the other. For every number of nodes the
+ * receivers a transmission was delivered to and the wall time spent per
+ * transmission, from StartTx to the last StartRx event, are printed.
+ *
+ * With the grid, a transmission only reaches the receivers within
+ * --range, whose number only depends on the density; without it, every
+ * node gets every transmission.
+ *
+ *   ./waf --run "ble-spatial-grid-benchmark --density=1000 --range=100"
+ */
+
+#include <ns3/core-module.h>
+#include <ns3/mobility-module.h>
+#include <ns3/packet.h>
+#include <ns3/ble-phy.h>
+#include <ns3/ble-spectrum-channel.h>
+#include <ns3/ble-spectrum-signal-parameters.h>
+
+#include <cmath>
+#include <iostream>
+
+using namespace ns3;
+
+/**
+ * Remember the number of delivery events of the channel.
+ *
+ * \param count where to store it
+ * \param oldValue previous count
+ * \param newValue current count
+ */
+static void
+RxEventsChanged (uint64_t *count, uint64_t oldValue, uint64_t newValue)
+{
+  *count = newValue;
+}
+
+/**
+ * Transmit one PDU from a node.
+ *
+ * \param channel the channel
+ * \param tx the transmitter
+ */
+static void
+Transmit (Ptr<BleSpectrumChannel> channel, Ptr<BlePhy> tx)
+{
+  Ptr<BleSpectrumSignalParameters> params = Create<BleSpectrumSignalParameters> ();
+  params->duration = tx->GetAirtime (27);
+  params->packet = Create<Packet> (27);
+  params->txPhy = tx;
+  params->psd = ConstCast<SpectrumValue> (tx->GetTxPowerSpectralDensity ());
+  params->SetChannel (tx->GetChannelIndex ());
+  channel->StartTx (params);
+}
+
+/**
+ * Run the transmissions once.
+ *
+ * \param grid the SpatialIndex of the channel
+ * \param nodes number of nodes
+ * \param density nodes per square kilometer
+ * \param range the MaxInterferenceRange of the channel, in meters
+ * \param transmissions number of transmissions
+ * \param delivered set to the number of deliveries
+ * \return the wall time the simulator ran, in milliseconds
+ */
+static int64_t
+RunTransmissions (bool grid, uint32_t nodes, double density, double range,
+                  uint32_t transmissions, uint64_t &delivered)
+{
+  RngSeedManager::SetRun (1);
+  Ptr<BleSpectrumChannel> channel = CreateObject<BleSpectrumChannel> ();
+  channel->SetAttribute ("SpatialIndex", BooleanValue (grid));
+  channel->SetAttribute ("MaxInterferenceRange", DoubleValue (range));
+  // Keeps one entry per pair of nodes; only the grid is measured here.
+  channel->SetAttribute ("PathLossCache", BooleanValue (false));
+
+  double side = std::sqrt (nodes / density) * 1000;
+  Ptr<UniformRandomVariable> position = CreateObject<UniformRandomVariable> ();
+  position->SetAttribute ("Max", DoubleValue (side));
+  std::vector<Ptr<BlePhy> > phys;
+  for (uint32_t i = 0; i < nodes; i++)
+    {
+      Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+      mobility->SetPosition (Vector (position->GetValue (), position->GetValue (), 1));
+      Ptr<BlePhy> phy = CreateObject<BlePhy> ();
+      phy->SetMobility (mobility);
+      phy->SetChannel (channel);
+      phys.push_back (phy);
+    }
+
+  Ptr<UniformRandomVariable> sender = CreateObject<UniformRandomVariable> ();
+  for (uint32_t i = 0; i < transmissions; i++)
+    {
+      Simulator::Schedule (MilliSeconds (i + 1), &Transmit, channel,
+                           phys[sender->GetInteger (0, nodes - 1)]);
+    }
+
+  delivered = 0;
+  channel->TraceConnectWithoutContext ("RxEvents",
+                                       MakeBoundCallback (&RxEventsChanged, &delivered));
+  SystemWallClockMs clock;
+  clock.Start ();
+  Simulator::Run ();
+  int64_t elapsed = clock.End ();
+  channel->Dispose ();
+  Simulator::Destroy ();
+  return elapsed;
+}
+
+int
+main (int argc, char *argv[])
+{
+  double density = 1000;
+  double range = 100;
+  uint32_t maxNodes = 10000;
+  uint32_t transmissions = 1000;
+
+  CommandLine cmd;
+  cmd.AddValue ("density", "Nodes per square kilometer", density);
+  cmd.AddValue ("range", "Interference range in meters", range);
+  cmd.AddValue ("maxNodes", "Largest number of nodes of the sweep", maxNodes);
+  cmd.AddValue ("transmissions", "Number of transmissions per run", transmissions);
+  cmd.Parse (argc, argv);
+
+  std::cout << "density=" << density << "/km2 range=" << range
+            << "m transmissions=" << transmissions << std::endl;
+  const char *names[] = { " no grid: ", " grid: " };
+  for (uint32_t nodes = 100; nodes <= maxNodes; nodes *= 10)
+    {
+      std::cout << "nodes " << nodes << ":";
+      for (uint32_t mode = 0; mode < 2; mode++)
+        {
+          uint64_t delivered;
+          int64_t elapsed = RunTransmissions (mode == 1, nodes, density, range,
+                                              transmissions, delivered);
+          std::cout << names[mode] << double (delivered) / transmissions << " receivers, "
+                    << 1e3 * elapsed / transmissions << " us per transmission;";
+        }
+      std::cout << std::endl;
+    }
+  return 0;
+}
@@ -79,23 +79,15 @@ AsciiBleMacTransmitSinkWithoutContext (
 
 BleHelper::BleHelper (void)
 {
-  m_channel = CreateObject<MultiModelSpectrumChannel> ();
-
-  Ptr<LogDistancePropagationLossModel> lossModel = 
-    CreateObject<LogDistancePropagationLossModel> ();
-  m_channel->AddPropagationLossModel (lossModel);
-
-  Ptr<ConstantSpeedPropagationDelayModel> delayModel = 
-    CreateObject<ConstantSpeedPropagationDelayModel> ();
-  m_channel->SetPropagationDelayModel (delayModel);
 	m_spectrumModel = 0;
-  ConstructAllChannels();
+  ConstructChannel();
 }
 
 BleHelper::~BleHelper (void)
 {
   m_channel->Dispose ();
   m_channel = 0;
+  m_connEventScheduler = 0;
 	m_spectrumModel = 0;
 }
 
@@ -162,10 +154,12 @@ BleHelper::AddMobility (Ptr<BlePhy> phy, Ptr<MobilityModel> m)
 }
 
 void
-BleHelper::ConstructAllChannels()
+BleHelper::ConstructChannel()
 {
+    // One channel carries all 40 BLE channel indices; it only delivers a
+    // transmission to the phys tuned to the same index.
     SpectrumChannelHelper channelHelper;
-    channelHelper.SetChannel ("ns3::MultiModelSpectrumChannel");
+    channelHelper.SetChannel ("ns3::BleSpectrumChannel");
     bool nakagami = false;
     if (nakagami)
     {
@@ -180,12 +174,7 @@ BleHelper::ConstructAllChannels()
           "Frequency",DoubleValue(2400e6));
     }
     channelHelper.SetPropagationDelay ("ns3::ConstantSpeedPropagationDelayModel");
-    
-  for (int i=0; i<40; i++)
-  {
-    Ptr<SpectrumChannel> c = channelHelper.Create ();
-    m_allChannels.push_back(c);
-  }
+    m_channel = channelHelper.Create ();
 }
 
 NetDeviceContainer
@@ -207,8 +196,9 @@ BleHelper::Install (NodeContainer c)
 		anandi->SetPhy (sfp);
         anandi->SetLinkController (blc);
 		anandi->SetAddress(Mac16Address::Allocate());
+		anandi->GetBBManager()->SetConnEventScheduler (m_connEventScheduler);
         blc->SetNetDevice (anandi);
-        blc->SetAllChannels (m_allChannels);
+        blc->SetChannel (m_channel);
 		sfp->SetDevice(anandi);
 		sfp->SetMobility (nodeI->GetObject<MobilityModel> ());
 		sfp->SetChannel (m_channel);
@@ -246,6 +236,18 @@ BleHelper::GetChannel (void)
   return m_channel;
 }
 
+void
+BleHelper::SetConnEventScheduler (Ptr<BleConnEventScheduler> scheduler)
+{
+  m_connEventScheduler = scheduler;
+}
+
+Ptr<BleConnEventScheduler>
+BleHelper::GetConnEventScheduler (void)
+{
+  return m_connEventScheduler;
+}
+
 void
 BleHelper::SetChannel (Ptr<SpectrumChannel> channel)
 {
@@ -40,6 +40,7 @@
 namespace ns3 {
 
   class SpectrumChannel;
+  class BleConnEventScheduler;
   class MobilityModel;
   class RandomVariableStream;
   /**
@@ -111,6 +112,18 @@ namespace ns3 {
      */
     Ptr<SpectrumChannel> GetChannel (void);
 
+    /**
+     * \brief Run the connection events of the devices installed from now
+     * on from one shared timer wheel instead of from the simulator.
+     * \param scheduler the timer wheel, or 0 to use the simulator
+     */
+    void SetConnEventScheduler (Ptr<BleConnEventScheduler> scheduler);
+
+    /**
+     * \returns the timer wheel given to new devices, if any
+     */
+    Ptr<BleConnEventScheduler> GetConnEventScheduler (void);
+
     /**
      * \brief Add mobility model to a physical device
      * \param phy the physical device
@@ -232,9 +245,10 @@ private:
 			Ptr<NetDevice> nd,
 			bool explicitFilename);
 
-    void ConstructAllChannels ();
+    void ConstructChannel ();
 
   Ptr<SpectrumChannel> m_channel; //!< channel to be used for the devices
+  Ptr<BleConnEventScheduler> m_connEventScheduler; //!< timer wheel given to the devices
 	
   typedef std::tuple<std::string,CallbackBase> callbacktuple;
   std::list<callbacktuple > m_callbacks;
@@ -242,7 +256,6 @@ private:
   std::list<ObjectFactory> m_netApp; 
         //!< These are the applications installed on the network server
 	Ptr<const SpectrumModel> m_spectrumModel;
-  std::vector<Ptr<SpectrumChannel>> m_allChannels;
   
 
   ObjectFactory m_queueFactory;
@@ -25,13 +25,16 @@
 #include <ns3/ble-link-controller.h>
 #include <ns3/ble-link.h>
 #include <ns3/ble-mac-header.h>
+#include <ns3/ble-conn-event-scheduler.h>
 #include <ns3/simulator.h>
-#include <ns3/drop-tail-queue.h>
-#include <ns3/queue-item.h>
+#include <ns3/ble-link-queue.h>
 #include "ns3/log.h"
+#include <ns3/boolean.h>
 
 #include <ns3/multi-model-spectrum-channel.h>
 
+#include <algorithm>
+
 namespace ns3 {
 
   NS_LOG_COMPONENT_DEFINE ("BleBBManager");
@@ -49,6 +52,33 @@ namespace ns3 {
             PointerValue (),
             MakePointerAccessor (&BleBBManager::m_netDevice),
             MakePointerChecker<Object> ())
+        .AddAttribute ("PlanAnchors",
+            "Choose the anchor points of the links created by this device "
+            "so that the transmit windows, plus T_IFS, of all links of the "
+            "devices involved do not overlap. Connection intervals are "
+            "rounded down to a power of two times the shortest one, and "
+            "the links of this device are re-planned if a new one does "
+            "not fit.",
+            BooleanValue (false),
+            MakeBooleanAccessor (&BleBBManager::m_planAnchors),
+            MakeBooleanChecker ())
+        .AddAttribute ("ReconnectDelay",
+            "Delay before a lost point-to-point link is set up again by the "
+            "device that was its master. The delay doubles, up to 64 times, "
+            "with every attempt in a row that never carries a packet. Zero "
+            "disables reconnection.",
+            TimeValue (Seconds (0)),
+            MakeTimeAccessor (&BleBBManager::m_reconnectDelay),
+            MakeTimeChecker ())
+        .AddTraceSource ("LinkLost",
+            "A link of this device timed out and was torn down.",
+            MakeTraceSourceAccessor (&BleBBManager::m_linkLostTrace),
+            "ns3::BleBBManager::LinkLostCallback")
+        .AddTraceSource ("DutyCycle",
+            "Fraction of time taken by the transmit windows of the links "
+            "of this device.",
+            MakeTraceSourceAccessor (&BleBBManager::m_dutyCycle),
+            "ns3::TracedValueCallback::Double")
         // Add attributes and tracesources
         ;
       return tid;
@@ -57,6 +87,9 @@ namespace ns3 {
   BleBBManager::BleBBManager ()
   {
     NS_LOG_FUNCTION (this);
+    m_planAnchors = false;
+    m_dutyCycle = 0;
+    m_reconnectDelay = Seconds (0);
   }
 
   BleBBManager::~BleBBManager ()
@@ -68,6 +101,17 @@ namespace ns3 {
     BleBBManager::DoDispose ()
     {
       NS_LOG_FUNCTION (this);
+      // Before the scheduler is dropped, so they can cancel their timers
+      for (std::list<Ptr<BleLinkManager> >::iterator it = m_linkManagers.begin ();
+          it != m_linkManagers.end (); ++it)
+      {
+        (*it)->Dispose ();
+      }
+      m_connEventScheduler = 0;
+      m_linkIndex.clear ();
+      m_broadcastLinkManager = 0;
+      m_wakeUpEvent.Cancel ();
+      m_linksToWake.clear ();
     }
 
   BleBBManager::BleBBManager (Ptr<BleNetDevice> bleNetDevice)
@@ -75,6 +119,9 @@ namespace ns3 {
     NS_LOG_FUNCTION (this);
 
     m_netDevice = bleNetDevice;
+    m_planAnchors = false;
+    m_dutyCycle = 0;
+    m_reconnectDelay = Seconds (0);
   }
 
 /**********************
@@ -95,13 +142,26 @@ namespace ns3 {
       return this->GetNetDevice()->GetPhy();
     }
 
-  Ptr<DropTailQueue<QueueItem>>
+  Ptr<BleLinkQueue>
     BleBBManager::GetQueue (void)
     {
       NS_LOG_FUNCTION (this);
       return this->GetNetDevice()->GetQueue();
     }
 
+  void
+    BleBBManager::SetConnEventScheduler (Ptr<BleConnEventScheduler> scheduler)
+    {
+      NS_LOG_FUNCTION (this);
+      m_connEventScheduler = scheduler;
+    }
+
+  Ptr<BleConnEventScheduler>
+    BleBBManager::GetConnEventScheduler (void)
+    {
+      return m_connEventScheduler;
+    }
+
   Ptr<BleLinkController>
     BleBBManager::GetLinkController()
     {
@@ -157,12 +217,296 @@ namespace ns3 {
       if (! LinkManagerExists(linkManager))
       {
         m_linkManagers.push_back(linkManager);
+        IndexLinkManager (linkManager);
+        UpdateDutyCycle ();
+        for (auto bbm : linkManager->GetAssociatedLink()->GetLinkedDevices())
+        {
+          m_lostPeers.erase (bbm->GetNetDevice()->GetAddress16());
+        }
       }
       else
       {
         NS_LOG_WARN ("LinkManager already exists in this baseband manager");
       }
     }
+
+  void
+    BleBBManager::LinkLost (Ptr<BleLinkManager> linkManager, bool established)
+    {
+      NS_LOG_FUNCTION (this << linkManager << established);
+      Ptr<BleLink> link = linkManager->GetAssociatedLink();
+      m_linkManagers.remove (linkManager);
+      UnindexLinkManager (linkManager);
+      UpdateDutyCycle ();
+      if (m_activeLinkManager == linkManager)
+      {
+        m_activeLinkManager = 0;
+      }
+
+      Ptr<BleBBManager> other;
+      for (auto bbm : link->GetLinkedDevices())
+      {
+        if (bbm != this)
+        {
+          other = bbm;
+        }
+      }
+      NS_ASSERT (other != 0);
+      Mac16Address peer = other->GetNetDevice()->GetAddress16();
+      m_lostPeers.insert (peer);
+      m_linkLostTrace (link, peer);
+
+      if (m_reconnectDelay.IsStrictlyPositive() && link->GetMaster() == this)
+      {
+        uint32_t &attempts = m_reconnectAttempts[peer];
+        attempts = established ? 0 : attempts + 1;
+        Time delay = TimeStep (m_reconnectDelay.GetTimeStep() 
+            << std::min (attempts, uint32_t (6)));
+        uint32_t nbConnectionInterval = 
+          linkManager->GetConnInterval().GetMicroSeconds() / 1250;
+        NS_LOG_INFO ("Setting the link with " << peer << " up again in " 
+            << delay.GetSeconds() << "s");
+        Simulator::Schedule (delay, &BleBBManager::Reconnect, this, 
+            other, nbConnectionInterval);
+      }
+    }
+
+  void
+    BleBBManager::Reconnect (Ptr<BleBBManager> otherBBManager, 
+        uint32_t nbConnectionInterval)
+    {
+      NS_LOG_FUNCTION (this << otherBBManager);
+      if (LinkExists (otherBBManager->GetNetDevice()->GetAddress16()))
+      {
+        return;
+      }
+      // As if the slave advertised and this device initiated at once
+      CreateLinkScheduled (otherBBManager, BleLinkManager::MASTER_ROLE, 
+          false, 0, nbConnectionInterval);
+    }
+
+  std::vector<uint8_t>
+    BleBBManager::GetRandomChannelMap (uint32_t nbChannels)
+    {
+      NS_ASSERT (nbChannels > 0 && nbChannels <= 37);
+      // Draw distinct data channels by shuffling all of them
+      Ptr<UniformRandomVariable> randT = CreateObject<UniformRandomVariable> ();
+      std::vector<uint8_t> channels;
+      for (uint8_t i = 0; i < 37; i++)
+      {
+        channels.push_back (i);
+      }
+      for (uint32_t i = 0; i < nbChannels; i++)
+      {
+        std::swap (channels[i], channels[randT->GetInteger (i, 36)]);
+      }
+      channels.resize (nbChannels);
+      std::sort (channels.begin(), channels.end());
+      return channels;
+    }
+
+  double
+    BleBBManager::GetDutyCycle (void)
+    {
+      return m_dutyCycle;
+    }
+
+  void
+    BleBBManager::UpdateDutyCycle ()
+    {
+      double dutyCycle = 0;
+      for (auto lm : m_linkManagers)
+      {
+        Reservation r = GetReservation (lm);
+        dutyCycle += double (r.length) / r.interval;
+      }
+      m_dutyCycle = dutyCycle;
+    }
+
+  BleBBManager::Reservation
+    BleBBManager::GetReservation (Ptr<BleLinkManager> lm)
+    {
+      Reservation r;
+      r.interval = std::max (lm->GetConnInterval().GetTimeStep(), 
+          int64_t (1));
+      r.phase = lm->GetAnchor().GetTimeStep() % r.interval;
+      r.length = (lm->GetTransmitWindowSize() 
+          + MicroSeconds (T_IFS)).GetTimeStep();
+      return r;
+    }
+
+  bool
+    BleBBManager::Overlaps (const Reservation &a, const Reservation &b)
+    {
+      // a and b start at all times phase + k * interval. The distance 
+      // between a start of a and one of b can take any value that is 
+      // congruent to the difference in phase modulo the gcd of the 
+      // intervals.
+      int64_t g = a.interval;
+      int64_t h = b.interval;
+      while (h != 0)
+      {
+        int64_t t = g % h;
+        g = h;
+        h = t;
+      }
+      int64_t d = ((b.phase - a.phase) % g + g) % g;
+      return d < a.length || g - d < b.length;
+    }
+
+  std::vector<Ptr<BleLinkManager>>
+    BleBBManager::GetLinkManagers (Ptr<BleLink> link)
+    {
+      std::vector<Ptr<BleLinkManager>> linkManagers;
+      for (auto bbm : link->GetLinkedDevices())
+      {
+        for (auto lm : bbm->m_linkManagers)
+        {
+          if (lm->GetAssociatedLink() == link)
+          {
+            linkManagers.push_back (lm);
+          }
+        }
+      }
+      return linkManagers;
+    }
+
+  bool
+    BleBBManager::PlaceLink (Ptr<BleLinkManager> linkManager, 
+        const std::set<Ptr<BleLink>> &ignored, Time earliest)
+    {
+      NS_LOG_FUNCTION (this << linkManager);
+      Ptr<BleLink> link = linkManager->GetAssociatedLink();
+
+      // The other links of all devices of this link
+      std::set<Ptr<BleLink>> seen = ignored;
+      seen.insert (link);
+      std::vector<Reservation> others;
+      for (auto bbm : link->GetLinkedDevices())
+      {
+        for (auto lm : bbm->m_linkManagers)
+        {
+          if (seen.insert (lm->GetAssociatedLink()).second)
+          {
+            others.push_back (GetReservation (lm));
+          }
+        }
+      }
+
+      // Try the anchors on the 1.25 ms grid, earliest first
+      Reservation r = GetReservation (linkManager);
+      int64_t tick = MicroSeconds (1250).GetTimeStep();
+      int64_t first = (earliest.GetTimeStep() + tick - 1) / tick;
+      int64_t nbAnchors = std::max (r.interval / tick, int64_t (1));
+      for (int64_t i = 0; i < nbAnchors; i++)
+      {
+        int64_t anchor = (first + i) * tick;
+        r.phase = anchor % r.interval;
+        bool free = true;
+        for (uint32_t j = 0; j < others.size() && free; j++)
+        {
+          free = ! Overlaps (r, others[j]);
+        }
+        if (free)
+        {
+          NS_LOG_INFO ("Link " << link << " gets anchor " 
+              << TimeStep (anchor).GetSeconds() << "s, interval " 
+              << linkManager->GetConnInterval().GetSeconds() << "s");
+          for (auto lm : GetLinkManagers (link))
+          {
+            lm->MoveAnchor (TimeStep (anchor), linkManager->GetConnInterval());
+          }
+          return true;
+        }
+      }
+      return false;
+    }
+
+  void
+    BleBBManager::Replan ()
+    {
+      NS_LOG_FUNCTION (this);
+      std::vector<Ptr<BleLinkManager>> order (m_linkManagers.begin(), 
+          m_linkManagers.end());
+      std::stable_sort (order.begin(), order.end(), 
+          [] (Ptr<BleLinkManager> a, Ptr<BleLinkManager> b)
+          {
+            if (a->GetConnInterval() != b->GetConnInterval())
+            {
+              return a->GetConnInterval() < b->GetConnInterval();
+            }
+            return a->GetTransmitWindowSize() > b->GetTransmitWindowSize();
+          });
+
+      std::set<Ptr<BleLink>> ignored;
+      for (auto lm : order)
+      {
+        ignored.insert (lm->GetAssociatedLink());
+      }
+      for (auto lm : order)
+      {
+        // Links that did not fit keep their anchors and are in the way
+        // of the next ones.
+        ignored.erase (lm->GetAssociatedLink());
+        // Leave the current window of the link time to end
+        Time earliest = Simulator::Now() + MicroSeconds (1250) 
+          + lm->GetTransmitWindowSize();
+        if (! PlaceLink (lm, ignored, earliest))
+        {
+          NS_LOG_WARN ("No anchor point left for link " 
+              << lm->GetAssociatedLink() << ", its windows may overlap");
+        }
+      }
+    }
+
+  void
+    BleBBManager::PlanLink (Ptr<BleLinkManager> linkManager)
+    {
+      NS_LOG_FUNCTION (this << linkManager);
+      Ptr<BleLink> link = linkManager->GetAssociatedLink();
+
+      // Intervals that are a power of two times each other leave the 
+      // most room for disjoint windows.
+      Time shortest = Seconds (0);
+      for (auto bbm : link->GetLinkedDevices())
+      {
+        for (auto lm : bbm->m_linkManagers)
+        {
+          if (lm->GetAssociatedLink() != link && (shortest.IsZero() 
+                || lm->GetConnInterval() < shortest))
+          {
+            shortest = lm->GetConnInterval();
+          }
+        }
+      }
+      Time interval = linkManager->GetConnInterval();
+      if (! shortest.IsZero() && interval > shortest)
+      {
+        Time harmonic = shortest;
+        while (harmonic + harmonic <= interval)
+        {
+          harmonic = harmonic + harmonic;
+        }
+        for (auto lm : GetLinkManagers (link))
+        {
+          lm->SetConnInterval (harmonic);
+        }
+      }
+
+      std::set<Ptr<BleLink>> ignored;
+      if (! PlaceLink (linkManager, ignored, 
+            Simulator::Now() + MicroSeconds (1250)))
+      {
+        NS_LOG_INFO ("Link " << link << " does not fit, re-planning the "
+            "links of " << this);
+        Replan ();
+      }
+
+      for (auto bbm : link->GetLinkedDevices())
+      {
+        bbm->UpdateDutyCycle ();
+      }
+    }
   
   Ptr<BleLink> 
     BleBBManager::CreateLinkScheduledMultipleNodes(
@@ -211,6 +555,10 @@ namespace ns3 {
         bbm->AddLinkManager(otherLinkManagers.at(it));
         it++;
       }
+      if (m_planAnchors)
+      {
+        PlanLink (myLinkManager);
+      }
       return myLinkManager->GetAssociatedLink();
     }
 
@@ -231,13 +579,7 @@ namespace ns3 {
       myLinkManager->SetBBManager(Ptr<BleBBManager> (this));
       otherLinkManager->SetBBManager(otherBBManager);
 
-      Ptr<UniformRandomVariable> randT = CreateObject<UniformRandomVariable> ();
-      int mapSize = 15;
-      std::vector<uint8_t> chmap;
-      for (int i=0; i< mapSize; i++)
-      {
-        chmap.push_back(randT->GetInteger(0,36));
-      }
+      std::vector<uint8_t> chmap = GetRandomChannelMap (15);
       //std::vector<uint8_t> chmap = {1,4,7,9,11}; 
       uint8_t hopIncr = 2;
       
@@ -251,6 +593,10 @@ namespace ns3 {
 
       this->AddLinkManager(myLinkManager);
       otherBBManager->AddLinkManager(otherLinkManager);
+      if (m_planAnchors)
+      {
+        PlanLink (myLinkManager);
+      }
       
       return myLinkManager->GetAssociatedLink();
     }
@@ -272,13 +618,7 @@ namespace ns3 {
       myLinkManager->SetBBManager(Ptr<BleBBManager> (this));
       otherLinkManager->SetBBManager(otherBBManager);
 
-      Ptr<UniformRandomVariable> randT = CreateObject<UniformRandomVariable> ();
-      int mapSize = 15;
-      std::vector<uint8_t> chmap;
-      for (int i=0; i< mapSize; i++)
-      {
-        chmap.push_back(randT->GetInteger(1,37));
-      }
+      std::vector<uint8_t> chmap = GetRandomChannelMap (15);
       //std::vector<uint8_t> chmap = {1,4,7,9,11}; 
       uint8_t hopIncr = 2;
       
@@ -291,6 +631,10 @@ namespace ns3 {
 
       this->AddLinkManager(myLinkManager);
       otherBBManager->AddLinkManager(otherLinkManager);
+      if (m_planAnchors)
+      {
+        PlanLink (myLinkManager);
+      }
       
       return myLinkManager->GetAssociatedLink();
     }
@@ -349,34 +693,89 @@ namespace ns3 {
       this->GetNetDevice()->SetPhy(phy);
     }
 
-  bool
-    BleBBManager::LinkExists (Mac16Address address)
+  uint16_t
+    BleBBManager::GetAddressKey (Mac16Address address)
     {
-      NS_LOG_FUNCTION (this);
-      std::list<Ptr<BleLinkManager>>::iterator it;
-      for (it = m_linkManagers.begin(); it != m_linkManagers.end(); ++it)
+      uint8_t buffer[2];
+      address.CopyTo (buffer);
+      return (uint16_t (buffer[0]) << 8) | buffer[1];
+    }
+
+  void
+    BleBBManager::IndexLinkManager (Ptr<BleLinkManager> linkManager)
+    {
+      Ptr<BleLink> link = linkManager->GetAssociatedLink();
+      if (link->GetLinkType() == BleLink::LinkType::BROADCAST)
       {
-        std::list<Ptr<BleBBManager>>::iterator it2;
-        Ptr<BleLinkManager> lm = *it;
-        Ptr<BleLink> temp = lm->GetAssociatedLink();
-        if (temp->GetLinkType() == BleLink::LinkType::BROADCAST 
-            && address == Mac16Address("FF:FF"))
-          return true;
-        std::list<Ptr<BleBBManager>> all_devices = temp->GetLinkedDevices();
-        for (it2 = all_devices.begin(); it2 != all_devices.end(); ++it2)
+        // Only reached through the broadcast address
+        if (m_broadcastLinkManager == 0)
         {
-          Ptr<BleBBManager> bbm = *it2;
-          NS_ASSERT(bbm != 0);
-          Ptr<BleNetDevice> nd = bbm->GetNetDevice ();
-          NS_ASSERT(nd != 0);
-          if (nd->GetAddress16() == address 
-              && temp->GetLinkType() != BleLink::LinkType::BROADCAST) 
-          {
-            return true;
-          }
+          m_broadcastLinkManager = linkManager;
+        }
+        return;
+      }
+      for (auto bbm : link->GetLinkedDevices())
+      {
+        NS_ASSERT(bbm != 0 && bbm->GetNetDevice () != 0);
+        // Does not replace a link manager that comes first
+        m_linkIndex.insert (std::make_pair (
+              GetAddressKey (bbm->GetNetDevice()->GetAddress16()), 
+              linkManager));
+      }
+    }
+
+  void
+    BleBBManager::UnindexLinkManager (Ptr<BleLinkManager> linkManager)
+    {
+      bool removed = false;
+      if (m_broadcastLinkManager == linkManager)
+      {
+        m_broadcastLinkManager = 0;
+        removed = true;
+      }
+      for (auto it = m_linkIndex.begin(); it != m_linkIndex.end(); )
+      {
+        if (it->second == linkManager)
+        {
+          it = m_linkIndex.erase (it);
+          removed = true;
+        }
+        else
+        {
+          ++it;
+        }
+      }
+      if (removed)
+      {
+        // Another link may take over an address of the removed one
+        for (auto lm : m_linkManagers)
+        {
+          IndexLinkManager (lm);
         }
       }
-      return false;
+    }
+
+  Ptr<BleLinkManager>
+    BleBBManager::FindLinkManager (Mac16Address address)
+    {
+      if (address == Mac16Address("FF:FF") && m_broadcastLinkManager != 0)
+      {
+        return m_broadcastLinkManager;
+      }
+      std::unordered_map<uint16_t, Ptr<BleLinkManager>>::iterator it = 
+        m_linkIndex.find (GetAddressKey (address));
+      if (it == m_linkIndex.end())
+      {
+        return 0;
+      }
+      return it->second;
+    }
+
+  bool
+    BleBBManager::LinkExists (Mac16Address address)
+    {
+      NS_LOG_FUNCTION (this);
+      return FindLinkManager (address) != 0;
     }
   
   
@@ -384,31 +783,12 @@ namespace ns3 {
     BleBBManager::GetLinkManager (Mac16Address address)
     {
       NS_LOG_FUNCTION (this);
-      std::list<Ptr<BleLinkManager>>::iterator it;
-      for (it = m_linkManagers.begin(); it != m_linkManagers.end(); ++it)
+      Ptr<BleLinkManager> lm = FindLinkManager (address);
+      if (lm == 0)
       {
-        std::list<Ptr<BleBBManager>>::iterator it2;
-        Ptr<BleLinkManager> lm = *it;
-        Ptr<BleLink> temp = lm->GetAssociatedLink();
-        if (temp->GetLinkType() == BleLink::LinkType::BROADCAST 
-            && address == Mac16Address("FF:FF"))
-          return lm;
-        std::list<Ptr<BleBBManager>> all_devices = temp->GetLinkedDevices();
-        for (it2 = all_devices.begin(); it2 != all_devices.end(); ++it2)
-        {
-          Ptr<BleBBManager> bbm = *it2;
-          NS_ASSERT(bbm != 0);
-          Ptr<BleNetDevice> nd = bbm->GetNetDevice ();
-          NS_ASSERT(nd != 0);
-          if (nd->GetAddress16() == address 
-              && temp->GetLinkType() != BleLink::LinkType::BROADCAST) 
-          {
-            return lm;
-          }
-        }
+        NS_LOG_WARN ("There is no link to a device with address " << address);
+        lm = CreateObject<BleLinkManager> ();
       }
-      NS_LOG_WARN ("There is no link to a device with address " << address);
-      Ptr<BleLinkManager> lm = CreateObject<BleLinkManager> ();
       return lm;
     }
   
@@ -417,32 +797,14 @@ namespace ns3 {
     BleBBManager::GetLink (Mac16Address address)
     {
       NS_LOG_FUNCTION (this);
-      std::list<Ptr<BleLinkManager>>::iterator it;
-      for (it = m_linkManagers.begin(); it != m_linkManagers.end(); ++it)
+      Ptr<BleLinkManager> lm = FindLinkManager (address);
+      if (lm == 0)
       {
-        std::list<Ptr<BleBBManager>>::iterator it2;
-        Ptr<BleLinkManager> lm = *it;
-        Ptr<BleLink> temp = lm->GetAssociatedLink();
-        if (temp->GetLinkType() == BleLink::LinkType::BROADCAST 
-            && address == Mac16Address("FF:FF"))
-          return temp;
-        std::list<Ptr<BleBBManager>> all_devices = temp->GetLinkedDevices();
-        for (it2 = all_devices.begin(); it2 != all_devices.end(); ++it2)
-        {
-          Ptr<BleBBManager> bbm = *it2;
-          NS_ASSERT(bbm != 0);
-          Ptr<BleNetDevice> nd = bbm->GetNetDevice ();
-          NS_ASSERT(nd != 0);
-          if (nd->GetAddress16() == address 
-              && temp->GetLinkType() != BleLink::LinkType::BROADCAST) 
-          {
-            return temp;
-          }
-        }
+        NS_LOG_WARN ("There is no link to a device with address " << address);
+        Ptr<BleLink> link = CreateObject<BleLink> ();
+        return link;
       }
-      NS_LOG_WARN ("There is no link to a device with address " << address);
-      Ptr<BleLink> link = CreateObject<BleLink> ();
-      return link;
+      return lm->GetAssociatedLink();
     }
   
   
@@ -452,12 +814,65 @@ namespace ns3 {
       return m_linkManagers.size();
     }
 
+  std::list<Ptr<BleLinkManager>>
+    BleBBManager::GetLinkManagers (void)
+    {
+      return m_linkManagers;
+    }
+
    void
     BleBBManager::TryAgain()
     {
       HandlePacket();
     }
 
+  bool
+    BleBBManager::EnqueuePacket (Ptr<Packet> packet, Mac16Address dest)
+    {
+      NS_LOG_FUNCTION (this << packet << dest);
+      Ptr<BleLinkManager> linkManager = FindLinkManager (dest);
+      if (linkManager == 0)
+      {
+        if (m_lostPeers.count (dest) != 0)
+        {
+          NS_LOG_WARN ("The link to " << dest 
+              << " was lost, dropping the packet");
+        }
+        else
+        {
+          NS_LOG_ERROR ("No link exists to destination address " << dest);
+        }
+        return false;
+      }
+      if (! linkManager->GetQueue ()->Enqueue (packet))
+      {
+        NS_LOG_LOGIC ("Queue of the link to " << dest << " is full");
+        return false;
+      }
+      if (m_linksToWake.empty () || m_linksToWake.back () != linkManager)
+      {
+        m_linksToWake.push_back (linkManager);
+      }
+      if (! m_wakeUpEvent.IsRunning ())
+      {
+        m_wakeUpEvent = Simulator::ScheduleNow (&BleBBManager::WakeUpLinks, 
+            this);
+      }
+      return true;
+    }
+
+  void
+    BleBBManager::WakeUpLinks (void)
+    {
+      NS_LOG_FUNCTION (this);
+      std::vector<Ptr<BleLinkManager>> links;
+      links.swap (m_linksToWake);
+      for (auto lm : links)
+      {
+        lm->WakeUp ();
+      }
+    }
+
    void
      BleBBManager::HandlePacket()
      {
@@ -465,17 +880,22 @@ namespace ns3 {
        while (this->GetNetDevice()->GetQueue()->IsEmpty () == false)
        {
          NS_LOG_INFO ("Queue is not empty");
-         Ptr<QueueItem> item = this->GetNetDevice()->GetQueue()->Dequeue ();
-         NS_ASSERT (item);
-         Ptr<Packet> packet = item->GetPacket ();
+         Ptr<Packet> packet = this->GetNetDevice()->GetQueue()->Dequeue ();
+         NS_ASSERT (packet);
         
          // Check dest address in header and get a link to the address
          BleMacHeader macheader;
          packet->PeekHeader(macheader);
          Mac16Address destAddr = macheader.GetDestAddr();
          NS_LOG_INFO ("Destination addr of current packet: " << destAddr); 
-         bool linkExists = LinkExists (destAddr);
-         if (!linkExists)
+         Ptr<BleLinkManager> linkManager = FindLinkManager (destAddr);
+         bool linkExists = linkManager != 0;
+         if (!linkExists && m_lostPeers.count (destAddr) != 0)
+         {
+           NS_LOG_WARN ("The link to " << destAddr 
+               << " was lost, dropping the packet");
+         }
+         else if (!linkExists)
          {
            NS_LOG_ERROR (" No link exists to destination address " << destAddr);
           // (if time allows: implement:) setup a link to the destination address
@@ -484,8 +904,8 @@ namespace ns3 {
          else
          {
            NS_LOG_INFO (" Link to destination of current packet exists ");
-           Ptr<BleLinkManager> activeLinkManager = GetLinkManager (destAddr);
-           activeLinkManager->GetQueue ()->Enqueue (item);
+           linkManager->GetQueue ()->Enqueue (packet);
+           linkManager->WakeUp ();
            
          }
        } // Queue was not empty
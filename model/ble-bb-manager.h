@@ -37,16 +37,22 @@
 #include <ns3/simulator.h>
 
 #include <ns3/constants.h>
+#include <ns3/traced-value.h>
+
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
 
 namespace ns3 {
 
   // Classes
 
-  template <typename Item> class DropTailQueue;
-  class QueueItem;
+  class BleLinkQueue;
   class BleLinkController;
   class BleLink;
   class BleNetDevice;
+  class BleConnEventScheduler;
 
 /** 
  * \ingroup ble
@@ -72,7 +78,14 @@ namespace ns3 {
       Ptr<BleNetDevice> GetNetDevice ();
       void SetNetDevice (Ptr<BleNetDevice> netDevice);
       void SetPhy (Ptr<BlePhy> phy);
-      Ptr<DropTailQueue<QueueItem>> GetQueue (void);
+      Ptr<BleLinkQueue> GetQueue (void);
+
+      /*
+       * Timer wheel that runs the connection events of the links of
+       * this device. If none is set, they are scheduled in the simulator.
+       */
+      void SetConnEventScheduler (Ptr<BleConnEventScheduler> scheduler);
+      Ptr<BleConnEventScheduler> GetConnEventScheduler (void);
 
       Ptr<Packet> GetCurrentPacket();
       void SetCurrentPacket(Ptr<Packet> packet);
@@ -92,6 +105,27 @@ namespace ns3 {
           uint32_t nbTxWindowOffset, uint32_t nbConnectionInterval, 
           bool collAvoid);
 
+      /*
+       * Fraction of time taken by the transmit windows of all links of
+       * this device, T_IFS included. Above 1, not all windows can be
+       * disjoint.
+       */
+      double GetDutyCycle (void);
+
+      /*
+       * Called by a link manager whose link timed out. Drops it from
+       * this device and, if ReconnectDelay is set and this end was the
+       * master, sets the link up again later.
+       * 'established' is false if the link never carried a packet.
+       */
+      void LinkLost (Ptr<BleLinkManager> linkManager, bool established);
+
+      /*
+       * TracedCallback signature for a lost link and the address of
+       * the device at the other end.
+       */
+      typedef void (* LinkLostCallback)(Ptr<BleLink> link, Mac16Address peer);
+
       // Check if a specific link exists
       bool LinkExists (Ptr<BleLink> link);
       bool LinkManagerExists (Ptr<BleLinkManager> linkManager);
@@ -103,9 +137,19 @@ namespace ns3 {
       Ptr<BleLinkManager> GetLinkManager (Mac16Address address);
 
       uint32_t CountLinks ();
+      // All link managers of this device
+      std::list<Ptr<BleLinkManager>> GetLinkManagers (void);
 
       void TryAgain();
 
+      /*
+       * Puts a packet, which already carries its BleMacHeader, straight
+       * into the queue of the link to 'dest'. The links that got 
+       * packets are woken up by one event per burst. Returns false if
+       * there is no link to 'dest' or its queue is full.
+       */
+      bool EnqueuePacket (Ptr<Packet> packet, Mac16Address dest);
+
       /*
        * Checks if there is a new item in the netdevice queue qnd
        * forwards this item to the right LinkManager's queue.
@@ -121,12 +165,78 @@ namespace ns3 {
       Ptr<BleLinkManager> GetActiveLinkManager();
 
     private:
+      // Connection events of a link: windows of 'length' starting at
+      // 'phase' modulo 'interval', all in time steps
+      struct Reservation
+      {
+        int64_t phase;
+        int64_t interval;
+        int64_t length;
+      };
+
+      // Random channel map of distinct data channels
+      static std::vector<uint8_t> GetRandomChannelMap (uint32_t nbChannels);
+
+      static Reservation GetReservation (Ptr<BleLinkManager> lm);
+      static bool Overlaps (const Reservation &a, const Reservation &b);
+
+      // The link managers of all ends of a link
+      static std::vector<Ptr<BleLinkManager>> GetLinkManagers (
+          Ptr<BleLink> link);
+
+      // Give a new link of this device disjoint connection events,
+      // re-planning the other links of this device if it does not fit
+      void PlanLink (Ptr<BleLinkManager> linkManager);
+
+      // Move the link to the earliest anchor, not before 'earliest', at
+      // which its windows do not overlap those of the other links of
+      // its devices. Links in 'ignored' do not count. Returns false if
+      // there is none.
+      bool PlaceLink (Ptr<BleLinkManager> linkManager, 
+          const std::set<Ptr<BleLink>> &ignored, Time earliest);
+
+      // Place all links of this device again, shortest interval first
+      void Replan ();
+
+      void UpdateDutyCycle ();
+
+      // Index of the link managers by the addresses of the devices on
+      // their links, and of the first broadcast link. The first link 
+      // manager in m_linkManagers wins, as in a search of the list.
+      static uint16_t GetAddressKey (Mac16Address address);
+      void IndexLinkManager (Ptr<BleLinkManager> linkManager);
+      void UnindexLinkManager (Ptr<BleLinkManager> linkManager);
+      // The link manager for packets to 'address', 0 if there is none
+      Ptr<BleLinkManager> FindLinkManager (Mac16Address address);
+
+      // Wake up the links EnqueuePacket put packets in
+      void WakeUpLinks (void);
+
+      // Set up a point-to-point link that was lost again
+      void Reconnect (Ptr<BleBBManager> otherBBManager, 
+          uint32_t nbConnectionInterval);
+
       Ptr<BleNetDevice> m_netDevice;
       std::list<Ptr<BleLinkManager>> m_linkManagers; 
+      std::unordered_map<uint16_t, Ptr<BleLinkManager>> m_linkIndex;
+      Ptr<BleLinkManager> m_broadcastLinkManager;
+      std::vector<Ptr<BleLinkManager>> m_linksToWake;
+      EventId m_wakeUpEvent;
 
       // The LinkManager that has control over the device
       // at this moment
       Ptr<BleLinkManager> m_activeLinkManager;
+
+      Ptr<BleConnEventScheduler> m_connEventScheduler;
+
+      bool m_planAnchors;
+      TracedValue<double> m_dutyCycle;
+
+      Time m_reconnectDelay; // 0 if lost links are not set up again
+      // Failed attempts in a row to set up a link with a device again
+      std::map<Mac16Address, uint32_t> m_reconnectAttempts;
+      std::set<Mac16Address> m_lostPeers; // devices whose link was lost
+      TracedCallback<Ptr<BleLink>, Mac16Address> m_linkLostTrace;
  };
 
 }
@@ -0,0 +1,226 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ble-bit-error-sampler.h"
+#include <ns3/log.h>
+#include <ns3/double.h>
+
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BleBitErrorSampler");
+
+NS_OBJECT_ENSURE_REGISTERED (BleBitErrorSampler);
+NS_OBJECT_ENSURE_REGISTERED (BlePerBitErrorSampler);
+NS_OBJECT_ENSURE_REGISTERED (BleBinomialBitErrorSampler);
+
+TypeId
+BleBitErrorSampler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BleBitErrorSampler")
+    .SetParent<Object> ()
+    ;
+  return tid;
+}
+
+BleBitErrorSampler::BleBitErrorSampler ()
+{
+}
+
+BleBitErrorSampler::~BleBitErrorSampler ()
+{
+}
+
+TypeId
+BlePerBitErrorSampler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BlePerBitErrorSampler")
+    .SetParent<BleBitErrorSampler> ()
+    .AddConstructor<BlePerBitErrorSampler> ()
+    ;
+  return tid;
+}
+
+BlePerBitErrorSampler::BlePerBitErrorSampler ()
+{
+  m_random = CreateObject<UniformRandomVariable> ();
+  m_random->SetAttribute ("Min", DoubleValue (0.0));
+  m_random->SetAttribute ("Max", DoubleValue (1.0));
+}
+
+BlePerBitErrorSampler::~BlePerBitErrorSampler ()
+{
+  m_random = 0;
+}
+
+uint32_t
+BlePerBitErrorSampler::GetBitErrors (uint32_t bits, double ber)
+{
+  uint32_t bitErrors = 0;
+  for (uint32_t it = 0; it < bits; it++)
+    {
+      if (m_random->GetValue () < ber)
+        {
+          bitErrors += 1;
+        }
+    }
+  return bitErrors;
+}
+
+int64_t
+BlePerBitErrorSampler::AssignStreams (int64_t stream)
+{
+  m_random->SetStream (stream);
+  return 1;
+}
+
+TypeId
+BleBinomialBitErrorSampler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BleBinomialBitErrorSampler")
+    .SetParent<BleBitErrorSampler> ()
+    .AddConstructor<BleBinomialBitErrorSampler> ()
+    .AddAttribute ("NormalThreshold",
+                   "Expected number of bit errors (or of correct bits, "
+                   "whichever is smaller) above which the normal "
+                   "approximation is used instead of exact inversion.",
+                   DoubleValue (30.0),
+                   MakeDoubleAccessor (&BleBinomialBitErrorSampler::m_normalThreshold),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("PoissonMaxBer",
+                   "Bit error rate below which the Poisson approximation "
+                   "is used for the inversion.",
+                   DoubleValue (1e-3),
+                   MakeDoubleAccessor (&BleBinomialBitErrorSampler::m_poissonMaxBer),
+                   MakeDoubleChecker<double> (0.0, 0.5))
+    ;
+  return tid;
+}
+
+BleBinomialBitErrorSampler::BleBinomialBitErrorSampler ()
+  : m_normalThreshold (30.0),
+    m_poissonMaxBer (1e-3)
+{
+  m_uniform = CreateObject<UniformRandomVariable> ();
+  m_uniform->SetAttribute ("Min", DoubleValue (0.0));
+  m_uniform->SetAttribute ("Max", DoubleValue (1.0));
+  m_normal = CreateObject<NormalRandomVariable> ();
+  m_normal->SetAttribute ("Mean", DoubleValue (0.0));
+  m_normal->SetAttribute ("Variance", DoubleValue (1.0));
+}
+
+BleBinomialBitErrorSampler::~BleBinomialBitErrorSampler ()
+{
+  m_uniform = 0;
+  m_normal = 0;
+}
+
+uint32_t
+BleBinomialBitErrorSampler::GetBitErrors (uint32_t bits, double ber)
+{
+  NS_LOG_FUNCTION (this << bits << ber);
+  if (bits == 0 || ber <= 0)
+    {
+      return 0;
+    }
+  if (ber >= 1)
+    {
+      return bits;
+    }
+
+  // Sample the rarer outcome and mirror the result, so the inversions
+  // below always run on a probability of at most one half.
+  bool mirrored = ber > 0.5;
+  double p = mirrored ? 1 - ber : ber;
+  double mean = bits * p;
+  uint32_t k;
+
+  if (mean < m_normalThreshold)
+    {
+      if (p < m_poissonMaxBer)
+        {
+          k = InvertPoisson (bits, mean);
+        }
+      else
+        {
+          k = InvertBinomial (bits, p);
+        }
+    }
+  else
+    {
+      double x = std::floor (mean + std::sqrt (mean * (1 - p)) * m_normal->GetValue () + 0.5);
+      if (x < 0)
+        {
+          k = 0;
+        }
+      else if (x > bits)
+        {
+          k = bits;
+        }
+      else
+        {
+          k = static_cast<uint32_t> (x);
+        }
+    }
+  return mirrored ? bits - k : k;
+}
+
+uint32_t
+BleBinomialBitErrorSampler::InvertBinomial (uint32_t n, double p)
+{
+  double u = m_uniform->GetValue ();
+  double ratio = p / (1 - p);
+  double pmf = std::exp (n * std::log1p (-p));
+  double cdf = pmf;
+  uint32_t k = 0;
+  while (u > cdf && k < n)
+    {
+      pmf *= ratio * (n - k) / (k + 1);
+      k++;
+      cdf += pmf;
+    }
+  return k;
+}
+
+uint32_t
+BleBinomialBitErrorSampler::InvertPoisson (uint32_t n, double mean)
+{
+  double u = m_uniform->GetValue ();
+  double pmf = std::exp (-mean);
+  double cdf = pmf;
+  uint32_t k = 0;
+  while (u > cdf && k < n && pmf > 0)
+    {
+      k++;
+      pmf *= mean / k;
+      cdf += pmf;
+    }
+  return k;
+}
+
+int64_t
+BleBinomialBitErrorSampler::AssignStreams (int64_t stream)
+{
+  m_uniform->SetStream (stream);
+  m_normal->SetStream (stream + 1);
+  return 2;
+}
+
+} // namespace ns3
@@ -0,0 +1,138 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BLE_BIT_ERROR_SAMPLER_H
+#define BLE_BIT_ERROR_SAMPLER_H
+
+#include <ns3/object.h>
+#include <ns3/random-variable-stream.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup BLE
+ *
+ * Draws the number of bit errors that occur in a burst of bits that are
+ * all received with the same bit error rate. BlePhy uses one of these to
+ * turn a BER into a bit error count for every interval of constant SNR.
+ */
+class BleBitErrorSampler : public Object
+{
+public:
+  /**
+   * Get the type ID.
+   *
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  BleBitErrorSampler ();
+  virtual ~BleBitErrorSampler ();
+
+  /**
+   * Draw the number of bit errors.
+   *
+   * \param bits number of bits received
+   * \param ber probability that a single bit is in error
+   * \return the number of bits in error, between 0 and bits
+   */
+  virtual uint32_t GetBitErrors (uint32_t bits, double ber) = 0;
+
+  /**
+   * Assign a fixed random variable stream number to the random variables
+   * used by this sampler.
+   *
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned
+   */
+  virtual int64_t AssignStreams (int64_t stream) = 0;
+};
+
+/**
+ * \ingroup BLE
+ *
+ * Draws one uniform random number per received bit. This is the original
+ * BlePhy behaviour; its cost grows linearly with the number of bits.
+ */
+class BlePerBitErrorSampler : public BleBitErrorSampler
+{
+public:
+  static TypeId GetTypeId (void);
+
+  BlePerBitErrorSampler ();
+  virtual ~BlePerBitErrorSampler ();
+
+  virtual uint32_t GetBitErrors (uint32_t bits, double ber);
+  virtual int64_t AssignStreams (int64_t stream);
+
+private:
+  Ptr<UniformRandomVariable> m_random; //!< one draw per bit
+};
+
+/**
+ * \ingroup BLE
+ *
+ * Draws the number of bit errors as a single Binomial(bits, ber) variate.
+ *
+ * When the expected number of errors is small the variate is drawn exactly
+ * by inverting the binomial CDF with one uniform draw; when the bit error
+ * rate is also tiny the Poisson approximation is used for that inversion.
+ * When the expected number of errors is large a normal approximation with
+ * continuity correction is used. Either way the cost no longer depends on
+ * the number of bits.
+ */
+class BleBinomialBitErrorSampler : public BleBitErrorSampler
+{
+public:
+  static TypeId GetTypeId (void);
+
+  BleBinomialBitErrorSampler ();
+  virtual ~BleBinomialBitErrorSampler ();
+
+  virtual uint32_t GetBitErrors (uint32_t bits, double ber);
+  virtual int64_t AssignStreams (int64_t stream);
+
+private:
+  /**
+   * Exact inversion of the binomial CDF.
+   *
+   * \param n number of trials
+   * \param p success probability, at most 0.5
+   * \return binomial variate
+   */
+  uint32_t InvertBinomial (uint32_t n, double p);
+
+  /**
+   * Inversion of the Poisson CDF, truncated at n.
+   *
+   * \param n number of trials
+   * \param mean expected number of successes
+   * \return Poisson variate, at most n
+   */
+  uint32_t InvertPoisson (uint32_t n, double mean);
+
+  Ptr<UniformRandomVariable> m_uniform; //!< used for the CDF inversions
+  Ptr<NormalRandomVariable> m_normal;   //!< used for the normal approximation
+  double m_normalThreshold;  //!< mean above which the normal approximation is used
+  double m_poissonMaxBer;    //!< BER below which the Poisson approximation is used
+};
+
+} // namespace ns3
+
+#endif /* BLE_BIT_ERROR_SAMPLER_H */
@@ -0,0 +1,491 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ble-conn-event-scheduler.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/boolean.h>
+
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BleConnEventScheduler");
+
+NS_OBJECT_ENSURE_REGISTERED (BleConnEventScheduler);
+
+// The first level has 2^8 slots of one tick, the others 2^6 slots.
+static const uint32_t FIRST_LEVEL_BITS = 8;
+static const uint32_t LEVEL_BITS = 6;
+static const uint32_t NB_LEVELS = 4;
+
+/**
+ * \param level a level of the wheel
+ * \return the number of bits of a tick below the slot index of that level
+ */
+static uint32_t
+GetLevelShift (uint32_t level)
+{
+  return level == 0 ? 0 : FIRST_LEVEL_BITS + (level - 1) * LEVEL_BITS;
+}
+
+/**
+ * \param level a level of the wheel
+ * \return the number of ticks that level spans
+ */
+static uint64_t
+GetLevelSpan (uint32_t level)
+{
+  return uint64_t (1) << (FIRST_LEVEL_BITS + level * LEVEL_BITS);
+}
+
+TypeId
+BleConnEventScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BleConnEventScheduler")
+    .SetParent<Object> ()
+    .AddConstructor<BleConnEventScheduler> ()
+    .AddAttribute ("KeepNodeContext",
+                   "Run every timer in the context it was scheduled for, with "
+                   "one simulator event per context that has timers due at the "
+                   "same time. Otherwise all timers due together run from one "
+                   "event, in its context; only logging and distributed "
+                   "simulations see the difference.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&BleConnEventScheduler::m_keepNodeContext),
+                   MakeBooleanChecker ())
+    .AddTraceSource ("PendingTimers",
+                     "Number of timers waiting to run.",
+                     MakeTraceSourceAccessor (&BleConnEventScheduler::m_nPending),
+                     "ns3::TracedValueCallback::Uint32")
+    .AddTraceSource ("FiredTimers",
+                     "Number of timers that ran.",
+                     MakeTraceSourceAccessor (&BleConnEventScheduler::m_firedTimers),
+                     "ns3::TracedValueCallback::Uint64")
+    .AddTraceSource ("SimulatorEvents",
+                     "Number of simulator events scheduled to run the timers.",
+                     MakeTraceSourceAccessor (&BleConnEventScheduler::m_simulatorEvents),
+                     "ns3::TracedValueCallback::Uint64")
+    ;
+  return tid;
+}
+
+BleConnEventScheduler::BleConnEventScheduler ()
+  : m_tick (0),
+    m_seq (0),
+    m_nInWheel (0),
+    m_firing (false),
+    m_rearm (false),
+    m_keepNodeContext (false),
+    m_nPending (0),
+    m_firedTimers (0),
+    m_simulatorEvents (0)
+{
+  NS_LOG_FUNCTION (this);
+  m_levels[0].resize (1 << FIRST_LEVEL_BITS);
+  for (uint32_t level = 1; level < NB_LEVELS; level++)
+    {
+      m_levels[level].resize (1 << LEVEL_BITS);
+    }
+}
+
+BleConnEventScheduler::~BleConnEventScheduler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BleConnEventScheduler::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_event.Cancel ();
+  m_timers.clear ();
+  m_free.clear ();
+  for (uint32_t level = 0; level < NB_LEVELS; level++)
+    {
+      m_levels[level].clear ();
+    }
+  m_overflow.clear ();
+  m_nInWheel = 0;
+  m_nPending = 0;
+  Object::DoDispose ();
+}
+
+Time
+BleConnEventScheduler::GetTick (void)
+{
+  return MicroSeconds (1250);
+}
+
+BleConnEventScheduler::TimerId
+BleConnEventScheduler::Schedule (Time delay, Callback<void> callback)
+{
+  return ScheduleWithContext (Simulator::GetContext (), delay, callback);
+}
+
+BleConnEventScheduler::TimerId
+BleConnEventScheduler::ScheduleWithContext (uint32_t context, Time delay, Callback<void> callback)
+{
+  NS_LOG_FUNCTION (this << context << delay);
+  NS_ASSERT (delay.IsPositive ());
+  Time now = Simulator::Now ();
+  if (m_nInWheel == 0)
+    {
+      // Nothing to move down the wheel; skip straight to now. Cancelled
+      // timers left in the wheel are freed when the wheel gets to them.
+      m_tick = std::max (m_tick, uint64_t (now.GetTimeStep () / GetTick ().GetTimeStep ()));
+    }
+
+  uint32_t index;
+  if (m_free.empty ())
+    {
+      index = m_timers.size ();
+      m_timers.push_back (Timer ());
+      m_timers[index].generation = 1;
+    }
+  else
+    {
+      index = m_free.back ();
+      m_free.pop_back ();
+    }
+  Timer &timer = m_timers[index];
+  timer.expiry = now + delay;
+  timer.tick = timer.expiry.GetTimeStep () / GetTick ().GetTimeStep ();
+  timer.seq = m_seq++;
+  timer.callback = callback;
+  timer.context = context;
+  timer.pending = true;
+  timer.dispatched = false;
+  Place (index);
+  m_nInWheel++;
+  m_nPending++;
+
+  if (!m_event.IsRunning () || timer.expiry < m_eventTime)
+    {
+      // While callbacks run, the wheel is re-armed once they are done.
+      if (m_firing)
+        {
+          m_rearm = true;
+        }
+      else
+        {
+          ScheduleNext ();
+        }
+    }
+  return (TimerId (timer.generation) << 32) | index;
+}
+
+void
+BleConnEventScheduler::Cancel (TimerId id)
+{
+  NS_LOG_FUNCTION (this << id);
+  if (!IsPending (id))
+    {
+      return;
+    }
+  // The entry stays in its slot, or in the list of timers taken out to
+  // run, until the wheel gets there.
+  Timer &timer = m_timers[uint32_t (id)];
+  timer.pending = false;
+  timer.callback = Callback<void> ();
+  m_nPending--;
+  if (!timer.dispatched)
+    {
+      m_nInWheel--;
+      if (m_nInWheel == 0)
+        {
+          m_event.Cancel ();
+        }
+    }
+}
+
+bool
+BleConnEventScheduler::IsPending (TimerId id) const
+{
+  uint32_t index = uint32_t (id);
+  return index < m_timers.size ()
+    && m_timers[index].generation == uint32_t (id >> 32)
+    && m_timers[index].pending;
+}
+
+uint32_t
+BleConnEventScheduler::GetNPending (void) const
+{
+  return m_nPending;
+}
+
+void
+BleConnEventScheduler::Place (uint32_t index)
+{
+  uint64_t tick = m_timers[index].tick;
+  NS_ASSERT (tick >= m_tick);
+  uint64_t delta = tick - m_tick;
+  for (uint32_t level = 0; level < NB_LEVELS; level++)
+    {
+      if (delta < GetLevelSpan (level))
+        {
+          Slot &slot = m_levels[level][(tick >> GetLevelShift (level)) % m_levels[level].size ()];
+          slot.push_back (index);
+          return;
+        }
+    }
+  m_overflow.push_back (index);
+}
+
+void
+BleConnEventScheduler::Cascade (Slot &slot)
+{
+  Slot timers;
+  timers.swap (slot);
+  for (Slot::const_iterator it = timers.begin (); it != timers.end (); ++it)
+    {
+      if (m_timers[*it].pending)
+        {
+          Place (*it);
+        }
+      else
+        {
+          Release (*it);
+        }
+    }
+}
+
+void
+BleConnEventScheduler::AdvanceTo (uint64_t tick)
+{
+  NS_ASSERT (tick >= m_tick);
+  uint64_t firstLevelSize = m_levels[0].size ();
+  while (m_tick < tick)
+    {
+      // The slots of the first level up to tick are empty; only the
+      // boundaries where higher levels move down matter.
+      uint64_t next = (m_tick / firstLevelSize + 1) * firstLevelSize;
+      if (next > tick)
+        {
+          m_tick = tick;
+          break;
+        }
+      m_tick = next;
+      uint32_t level = 1;
+      for (; level < NB_LEVELS; level++)
+        {
+          uint64_t index = (m_tick >> GetLevelShift (level)) % m_levels[level].size ();
+          Cascade (m_levels[level][index]);
+          if (index != 0)
+            {
+              break;
+            }
+        }
+      if (level == NB_LEVELS)
+        {
+          Cascade (m_overflow);
+        }
+    }
+}
+
+void
+BleConnEventScheduler::ScheduleNext (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_event.Cancel ();
+  if (m_nInWheel == 0)
+    {
+      return;
+    }
+
+  // The earliest timer in the rest of the current round of the first level
+  uint64_t firstLevelSize = m_levels[0].size ();
+  uint64_t current = m_tick % firstLevelSize;
+  bool found = false;
+  Time next;
+  for (uint64_t index = current; index < firstLevelSize && !found; index++)
+    {
+      Slot &slot = m_levels[0][index];
+      Slot::iterator last = slot.begin ();
+      for (Slot::iterator it = slot.begin (); it != slot.end (); ++it)
+        {
+          if (!m_timers[*it].pending)
+            {
+              Release (*it);
+              continue;
+            }
+          if (!found || m_timers[*it].expiry < next)
+            {
+              next = m_timers[*it].expiry;
+              found = true;
+            }
+          *last++ = *it;
+        }
+      slot.erase (last, slot.end ());
+    }
+
+  if (!found)
+    {
+      // Wake up at the next round of the first level that has timers:
+      // the next one if timers wrapped around, else the next one whose
+      // second level slot is not empty, or the next round of the second
+      // level at the latest.
+      uint64_t round = m_tick / firstLevelSize + 1;
+      bool wrapped = false;
+      for (uint64_t index = 0; index < current && !wrapped; index++)
+        {
+          wrapped = !m_levels[0][index].empty ();
+        }
+      uint64_t secondLevelSize = m_levels[1].size ();
+      while (!wrapped && round % secondLevelSize != 0
+             && m_levels[1][round % secondLevelSize].empty ())
+        {
+          round++;
+        }
+      next = TimeStep (round * firstLevelSize * GetTick ().GetTimeStep ());
+    }
+
+  m_eventTime = next;
+  m_event = Simulator::Schedule (next - Simulator::Now (), &BleConnEventScheduler::Fire, this);
+  m_simulatorEvents++;
+}
+
+void
+BleConnEventScheduler::Fire (void)
+{
+  NS_LOG_FUNCTION (this);
+  Time now = Simulator::Now ();
+  AdvanceTo (now.GetTimeStep () / GetTick ().GetTimeStep ());
+
+  Slot due;
+  Slot &slot = m_levels[0][m_tick % m_levels[0].size ()];
+  due.swap (slot);
+  std::vector<std::pair<std::pair<Time, uint64_t>, uint32_t> > order;
+  for (Slot::const_iterator it = due.begin (); it != due.end (); ++it)
+    {
+      const Timer &timer = m_timers[*it];
+      if (!timer.pending)
+        {
+          Release (*it);
+        }
+      else if (timer.expiry > now)
+        {
+          // Later in the same tick
+          slot.push_back (*it);
+        }
+      else
+        {
+          order.push_back (std::make_pair (std::make_pair (timer.expiry, timer.seq), *it));
+        }
+    }
+  std::sort (order.begin (), order.end ());
+
+  // Take the timers out of the wheel. They run from this event, unless
+  // KeepNodeContext is set and they belong to another context; those are
+  // grouped by context.
+  uint32_t context = Simulator::GetContext ();
+  Slot here;
+  std::vector<std::pair<uint32_t, Slot> > groups;
+  for (uint32_t i = 0; i < order.size (); i++)
+    {
+      uint32_t index = order[i].second;
+      Timer &timer = m_timers[index];
+      timer.dispatched = true;
+      m_nInWheel--;
+      if (!m_keepNodeContext || timer.context == context)
+        {
+          here.push_back (index);
+          continue;
+        }
+      uint32_t group = 0;
+      while (group < groups.size () && groups[group].first != timer.context)
+        {
+          group++;
+        }
+      if (group == groups.size ())
+        {
+          groups.push_back (std::make_pair (timer.context, Slot ()));
+        }
+      groups[group].second.push_back (index);
+    }
+
+  m_firing = true;
+  RunTimers (here);
+  for (uint32_t group = 0; group < groups.size (); group++)
+    {
+      Simulator::ScheduleWithContext (groups[group].first, Seconds (0),
+                                      &BleConnEventScheduler::FireInContext, this,
+                                      groups[group].second);
+      m_simulatorEvents++;
+    }
+  m_firing = false;
+  m_rearm = false;
+  ScheduleNext ();
+}
+
+void
+BleConnEventScheduler::FireInContext (Slot timers)
+{
+  NS_LOG_FUNCTION (this << timers.size ());
+  if (m_levels[0].empty ())
+    {
+      // Disposed of since the timers were taken out
+      return;
+    }
+  m_firing = true;
+  m_rearm = false;
+  RunTimers (timers);
+  m_firing = false;
+  if (m_rearm)
+    {
+      ScheduleNext ();
+    }
+}
+
+void
+BleConnEventScheduler::RunTimers (const Slot &timers)
+{
+  for (Slot::const_iterator it = timers.begin (); it != timers.end (); ++it)
+    {
+      uint32_t index = *it;
+      m_timers[index].dispatched = false;
+      // An earlier callback may have cancelled this timer.
+      if (!m_timers[index].pending)
+        {
+          Release (index);
+          continue;
+        }
+      Callback<void> callback = m_timers[index].callback;
+      m_timers[index].pending = false;
+      m_nPending--;
+      Release (index);
+      m_firedTimers++;
+      callback ();
+    }
+}
+
+void
+BleConnEventScheduler::Release (uint32_t index)
+{
+  Timer &timer = m_timers[index];
+  timer.callback = Callback<void> ();
+  // Old ids of this entry no longer match; id 0 is never handed out.
+  if (++timer.generation == 0)
+    {
+      timer.generation = 1;
+    }
+  m_free.push_back (index);
+}
+
+} // namespace ns3
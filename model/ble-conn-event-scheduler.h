@@ -0,0 +1,233 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BLE_CONN_EVENT_SCHEDULER_H
+#define BLE_CONN_EVENT_SCHEDULER_H
+
+#include <ns3/object.h>
+#include <ns3/nstime.h>
+#include <ns3/event-id.h>
+#include <ns3/callback.h>
+#include <ns3/traced-value.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup BLE
+ *
+ * Runs the connection events of many BLE links from a hierarchical timer
+ * wheel instead of from the simulator's event queue.
+ *
+ * Time is cut into ticks of 1.25 ms, the unit of BLE connection intervals
+ * and window offsets. The first level of the wheel has one slot per tick
+ * for the next 256 ticks; each further level has 64 slots that each cover
+ * 64 slots of the level below, and timers move down a level as their
+ * time comes closer. Only one simulator event is pending at any time: at
+ * the earliest timer in the current 256 ticks, or at the next point where
+ * timers move down from a higher level. The timers that expire at the
+ * same time run in the order they were scheduled, all from that one
+ * event. With KeepNodeContext, each runs in the node context it was
+ * scheduled for instead: those of the context the wheel's own event runs
+ * in directly, the others from one event per context, so a tick with
+ * links of k nodes costs up to k + 1 events. The wheel is re-armed once,
+ * after the callbacks ran.
+ *
+ * Scheduling and cancelling a timer take constant time, whatever the
+ * number of links.
+ */
+class BleConnEventScheduler : public Object
+{
+public:
+  /// Identifies a scheduled timer; 0 is never used
+  typedef uint64_t TimerId;
+
+  /**
+   * Get the type ID.
+   *
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  BleConnEventScheduler ();
+  virtual ~BleConnEventScheduler ();
+
+  /**
+   * \return the length of a tick of the wheel
+   */
+  static Time GetTick (void);
+
+  /**
+   * Run a callback after a delay, in the current context.
+   *
+   * \param delay the delay, not negative
+   * \param callback the callback
+   * \return an id to cancel the timer with
+   */
+  TimerId Schedule (Time delay, Callback<void> callback);
+
+  /**
+   * Run a callback after a delay, in a node context if KeepNodeContext
+   * is set.
+   *
+   * \param context the context, usually a node id
+   * \param delay the delay, not negative
+   * \param callback the callback
+   * \return an id to cancel the timer with
+   */
+  TimerId ScheduleWithContext (uint32_t context, Time delay, Callback<void> callback);
+
+  /**
+   * Run a member function after a delay.
+   *
+   * \param delay the delay, not negative
+   * \param memPtr the member function
+   * \param obj the object to call it on
+   * \return an id to cancel the timer with
+   */
+  template <typename MEM, typename OBJ>
+  TimerId Schedule (Time delay, MEM memPtr, OBJ obj)
+  {
+    return Schedule (delay, MakeCallback (memPtr, obj));
+  }
+
+  /**
+   * Run a member function after a delay, in a node context if
+   * KeepNodeContext is set.
+   *
+   * \param context the context, usually a node id
+   * \param delay the delay, not negative
+   * \param memPtr the member function
+   * \param obj the object to call it on
+   * \return an id to cancel the timer with
+   */
+  template <typename MEM, typename OBJ>
+  TimerId ScheduleWithContext (uint32_t context, Time delay, MEM memPtr, OBJ obj)
+  {
+    return ScheduleWithContext (context, delay, MakeCallback (memPtr, obj));
+  }
+
+  /**
+   * Cancel a timer. Cancelling a timer that already ran does nothing.
+   *
+   * \param id the timer
+   */
+  void Cancel (TimerId id);
+
+  /**
+   * \param id a timer
+   * \return whether the timer is still waiting to run
+   */
+  bool IsPending (TimerId id) const;
+
+  /**
+   * \return the number of timers waiting to run
+   */
+  uint32_t GetNPending (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /// A timer and its position in the wheel
+  struct Timer
+  {
+    Time expiry;             //!< when it runs
+    uint64_t tick;           //!< the tick expiry falls in
+    uint64_t seq;            //!< order in which timers were scheduled
+    Callback<void> callback; //!< what it runs
+    uint32_t context;        //!< context it runs in
+    uint32_t generation;     //!< distinguishes reuses of the same entry
+    bool pending;            //!< false once run or cancelled
+    bool dispatched;         //!< taken out of the wheel to run in its context
+  };
+
+  /// Indices in m_timers
+  typedef std::vector<uint32_t> Slot;
+
+  /**
+   * Put a timer in the slot its tick belongs to, given the current tick.
+   *
+   * \param index the timer
+   */
+  void Place (uint32_t index);
+
+  /**
+   * Move the timers of a slot of a higher level down the wheel, and
+   * free the ones that were cancelled.
+   *
+   * \param slot the slot
+   */
+  void Cascade (Slot &slot);
+
+  /**
+   * Advance the wheel to a tick, moving timers down the wheel on the way.
+   *
+   * \param tick the tick, not before the current one
+   */
+  void AdvanceTo (uint64_t tick);
+
+  /// Schedule the simulator event for the next timer or cascade.
+  void ScheduleNext (void);
+
+  /// Run the timers that expire now.
+  void Fire (void);
+
+  /**
+   * Run timers taken out of the wheel by Fire, from an event in their
+   * context.
+   *
+   * \param timers the timers, in the order they run
+   */
+  void FireInContext (Slot timers);
+
+  /**
+   * Run timers taken out of the wheel, skipping the cancelled ones.
+   *
+   * \param timers the timers, in the order they run
+   */
+  void RunTimers (const Slot &timers);
+
+  /**
+   * Return a timer entry to the free list.
+   *
+   * \param index the timer
+   */
+  void Release (uint32_t index);
+
+  std::vector<Timer> m_timers;    //!< all timer entries, pending or free
+  std::vector<uint32_t> m_free;   //!< entries that can be reused
+  std::vector<Slot> m_levels[4];  //!< the wheel, finest level first
+  Slot m_overflow;                //!< timers beyond the last level
+  uint64_t m_tick;                //!< current tick of the wheel
+  uint64_t m_seq;                 //!< sequence number of the next timer
+  uint32_t m_nInWheel;            //!< pending timers not yet taken out of the wheel
+  EventId m_event;                //!< the pending simulator event
+  Time m_eventTime;               //!< when m_event runs
+  bool m_firing;                  //!< whether timers are being run
+  bool m_rearm;                   //!< whether a timer scheduled while firing needs an earlier event
+  bool m_keepNodeContext;         //!< whether timers run in their own context
+  TracedValue<uint32_t> m_nPending;    //!< timers waiting to run
+  TracedValue<uint64_t> m_firedTimers; //!< timers that ran
+  TracedValue<uint64_t> m_simulatorEvents; //!< simulator events scheduled
+};
+
+} // namespace ns3
+
+#endif /* BLE_CONN_EVENT_SCHEDULER_H */
@@ -19,9 +19,13 @@
  */
 #include "ble-error-model.h"
 #include <ns3/log.h>
+#include <ns3/double.h>
+#include <ns3/boolean.h>
 
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <algorithm>
+#include <map>
 
 namespace ns3 {
 
@@ -34,17 +38,57 @@ BleErrorModel::GetTypeId (void)
 	static TypeId tid = TypeId ("ns3::BleErrorModel")
 		.SetParent<Object> ()
 		.AddConstructor<BleErrorModel> ()
+    .AddAttribute ("UseLookupTable",
+                   "Look the BER up in a precomputed table instead of "
+                   "evaluating the closed-form expression on every call.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&BleErrorModel::m_useTable),
+                   MakeBooleanChecker ())
+    .AddAttribute ("TableMinSnr",
+                   "Lowest SNR (dB) in the table. Lower SNRs are evaluated "
+                   "with the closed-form expression.",
+                   DoubleValue (-10.0),
+                   MakeDoubleAccessor (&BleErrorModel::SetTableMinSnr,
+                                       &BleErrorModel::GetTableMinSnr),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("TableMaxSnr",
+                   "Highest SNR (dB) in the table. Higher SNRs are reported "
+                   "as error free.",
+                   DoubleValue (20.0),
+                   MakeDoubleAccessor (&BleErrorModel::SetTableMaxSnr,
+                                       &BleErrorModel::GetTableMaxSnr),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("TablePointsPerDb",
+                   "Initial number of table samples per dB.",
+                   DoubleValue (20.0),
+                   MakeDoubleAccessor (&BleErrorModel::SetTablePointsPerDb,
+                                       &BleErrorModel::GetTablePointsPerDb),
+                   MakeDoubleChecker<double> (0.1))
+    .AddAttribute ("TableMaxRelativeError",
+                   "Largest allowed relative error of the interpolated BER "
+                   "with respect to the closed-form expression. The table "
+                   "resolution is doubled until the bound is met.",
+                   DoubleValue (0.01),
+                   MakeDoubleAccessor (&BleErrorModel::SetTableMaxRelativeError,
+                                       &BleErrorModel::GetTableMaxRelativeError),
+                   MakeDoubleChecker<double> (0.0))
 	;
 	return tid;
 }
 
 BleErrorModel::BleErrorModel (void)
+  : m_useTable (true),
+    m_minSnrDb (-10.0),
+    m_maxSnrDb (20.0),
+    m_pointsPerDb (20.0),
+    m_maxRelativeError (0.01),
+    m_table (0)
 {
 
 }
 
-long double 
-BleErrorModel::GetBER (double snr) const
+long double
+BleErrorModel::GetExactBER (double snr)
 {
   long double z = sqrtl((long double)snr);
 	if (snr > 0)
@@ -53,8 +97,230 @@ BleErrorModel::GetBER (double snr) const
 	}
 	else
 	{
-		return 0;
+		return 0.5;
 	}
 }
 
+long double 
+BleErrorModel::GetBER (double snr) const
+{
+  if (snr <= 0)
+    {
+      // Nothing of the signal is left: every bit is a guess
+      return 0.5;
+    }
+  if (!m_useTable)
+    {
+      return GetExactBER (snr);
+    }
+  Ptr<const BerTable> table = GetTable ();
+  double snrDb = 10 * std::log10 (snr);
+  uint32_t i;
+  double f;
+  if (Locate (table, snrDb, i, f))
+    {
+      return std::exp (table->logBer[i]
+                       + f * (table->logBer[i + 1] - table->logBer[i]));
+    }
+  if (snrDb >= table->maxSnrDb)
+    {
+      return 0;
+    }
+  return GetExactBER (snr);
+}
+
+double
+BleErrorModel::GetPER (double snr, uint32_t length) const
+{
+  if (length == 0)
+    {
+      return 0;
+    }
+  if (snr <= 0)
+    {
+      // Nothing of the signal is left
+      return 1;
+    }
+  double bits = 8.0 * length;
+  if (m_useTable)
+    {
+      Ptr<const BerTable> table = GetTable ();
+      double snrDb = 10 * std::log10 (snr);
+      uint32_t i;
+      double f;
+      if (Locate (table, snrDb, i, f))
+        {
+          // Interpolating ln (BER) keeps the relative error of the PER
+          // within that of the BER.
+          double ber = std::exp (table->logBer[i]
+                                 + f * (table->logBer[i + 1] - table->logBer[i]));
+          return -std::expm1 (bits * std::log1p (-ber));
+        }
+      if (snrDb >= table->maxSnrDb)
+        {
+          return 0;
+        }
+    }
+  long double ber = GetExactBER (snr);
+  return -std::expm1 (bits * log1pl (-ber));
+}
+
+long double
+BleErrorModel::GetBER (double snr, double gainDb) const
+{
+  return GetBER (snr * std::pow (10.0, gainDb / 10));
+}
+
+double
+BleErrorModel::GetPER (double snr, uint32_t length, double gainDb) const
+{
+  return GetPER (snr * std::pow (10.0, gainDb / 10), length);
+}
+
+void
+BleErrorModel::SetTableMinSnr (double snrDb)
+{
+  m_minSnrDb = snrDb;
+  m_table = 0;
+}
+
+double
+BleErrorModel::GetTableMinSnr (void) const
+{
+  return m_minSnrDb;
+}
+
+void
+BleErrorModel::SetTableMaxSnr (double snrDb)
+{
+  m_maxSnrDb = snrDb;
+  m_table = 0;
+}
+
+double
+BleErrorModel::GetTableMaxSnr (void) const
+{
+  return m_maxSnrDb;
+}
+
+void
+BleErrorModel::SetTablePointsPerDb (double pointsPerDb)
+{
+  m_pointsPerDb = pointsPerDb;
+  m_table = 0;
+}
+
+double
+BleErrorModel::GetTablePointsPerDb (void) const
+{
+  return m_pointsPerDb;
+}
+
+void
+BleErrorModel::SetTableMaxRelativeError (double maxRelativeError)
+{
+  m_maxRelativeError = maxRelativeError;
+  m_table = 0;
+}
+
+double
+BleErrorModel::GetTableMaxRelativeError (void) const
+{
+  return m_maxRelativeError;
+}
+
+Ptr<const BleErrorModel::BerTable>
+BleErrorModel::GetTable (void) const
+{
+  if (m_table == 0)
+    {
+      // One table per configuration, shared by every error model.
+      typedef std::map<std::vector<double>, Ptr<const BerTable> > TableCache;
+      static TableCache cache;
+      std::vector<double> key;
+      key.push_back (m_minSnrDb);
+      key.push_back (m_maxSnrDb);
+      key.push_back (m_pointsPerDb);
+      key.push_back (m_maxRelativeError);
+      TableCache::iterator it = cache.find (key);
+      if (it == cache.end ())
+        {
+          it = cache.insert (std::make_pair (key, BuildTable (m_minSnrDb, m_maxSnrDb,
+                                                              m_pointsPerDb,
+                                                              m_maxRelativeError))).first;
+        }
+      m_table = it->second;
+    }
+  return m_table;
+}
+
+Ptr<const BleErrorModel::BerTable>
+BleErrorModel::BuildTable (double minSnrDb, double maxSnrDb,
+                           double pointsPerDb, double maxRelativeError)
+{
+  NS_LOG_FUNCTION (minSnrDb << maxSnrDb << pointsPerDb << maxRelativeError);
+  NS_ASSERT (maxSnrDb > minSnrDb);
+  const double maxPointsPerDb = 10000;
+  while (true)
+    {
+      Ptr<BerTable> table = Create<BerTable> ();
+      uint32_t n = std::ceil ((maxSnrDb - minSnrDb) * pointsPerDb) + 1;
+      table->minSnrDb = minSnrDb;
+      table->maxSnrDb = minSnrDb + (n - 1) / pointsPerDb;
+      table->pointsPerDb = pointsPerDb;
+      table->logBer.reserve (n);
+      for (uint32_t i = 0; i < n; i++)
+        {
+          double snrDb = minSnrDb + i / pointsPerDb;
+          long double ber = GetExactBER (std::pow (10.0, snrDb / 10));
+          // Clamp so that samples where the BER underflows still
+          // interpolate to zero instead of NaN.
+          table->logBer.push_back (std::max (logl (ber), -10000.0L));
+        }
+
+      // Compare the interpolation against the exact curve halfway between
+      // samples, where the error of a linear interpolation peaks.
+      double worst = 0;
+      for (uint32_t i = 0; i + 1 < n; i++)
+        {
+          double snrDb = minSnrDb + (i + 0.5) / pointsPerDb;
+          long double exact = GetExactBER (std::pow (10.0, snrDb / 10));
+          if (exact <= 0)
+            {
+              continue;
+            }
+          double interpolated = (table->logBer[i] + table->logBer[i + 1]) / 2;
+          double error = std::fabs (std::expm1 (interpolated - logl (exact)));
+          worst = std::max (worst, error);
+        }
+
+      if (worst <= maxRelativeError || pointsPerDb >= maxPointsPerDb)
+        {
+          if (worst > maxRelativeError)
+            {
+              NS_LOG_WARN ("BER table error " << worst << " exceeds the bound "
+                           << maxRelativeError << " at the maximum resolution");
+            }
+          NS_LOG_INFO ("BER table with " << n << " samples, " << pointsPerDb
+                       << " per dB, max relative error " << worst);
+          return table;
+        }
+      pointsPerDb *= 2;
+    }
+}
+
+bool
+BleErrorModel::Locate (Ptr<const BerTable> table, double snrDb,
+                       uint32_t &index, double &fraction)
+{
+  double x = (snrDb - table->minSnrDb) * table->pointsPerDb;
+  if (x < 0 || x >= table->logBer.size () - 1)
+    {
+      return false;
+    }
+  index = static_cast<uint32_t> (x);
+  fraction = x - index;
+  return true;
+}
+
 } // namespace ns3
@@ -22,6 +22,8 @@
 
 
 #include <ns3/object.h>
+#include <ns3/simple-ref-count.h>
+#include <vector>
 
 namespace ns3 {
 
@@ -31,6 +33,11 @@ namespace ns3 {
  * Model the error rate for IEEE 802.15.4 2.4 GHz AWGN channel for OQPSK
  * the model description can be found in IEEE Std 802.15.4-2006, section
  * E.4.1.7
+ *
+ * By default the BER is not evaluated with the closed-form expression on
+ * every call, but looked up in a table that is sampled uniformly in dB
+ * and interpolated linearly in the log domain. Tables are built once per
+ * distinct configuration and shared by all error model instances.
  */
 class BleErrorModel : public Object
 {
@@ -45,15 +52,119 @@ public:
   BleErrorModel (void);
 
   /**
-   * Return BER for given SNR.
+   * Return BER for given SNR. Without signal, at an SNR of zero or
+   * less, half the bits are wrong.
    *
    * \return bit error rate
    * \param snr SNR expressed as a power ratio (i.e. not in dB)
    */
   long double GetBER (double snr) const;
 
+  /**
+   * Return the probability that a PDU of the given length contains at
+   * least one bit error when received at a constant SNR.
+   *
+   * \param snr SNR expressed as a power ratio (i.e. not in dB)
+   * \param length PDU length in bytes
+   * \return packet error rate, 1 if the SNR is not positive
+   */
+  double GetPER (double snr, uint32_t length) const;
+
+  /**
+   * Return BER for given SNR, for a PHY mode that is gainDb more
+   * sensitive than LE 1M: the SNR is scaled by the gain before the
+   * curve is evaluated.
+   *
+   * \param snr SNR expressed as a power ratio (i.e. not in dB)
+   * \param gainDb energy per bit and coding gain relative to LE 1M
+   * \return bit error rate
+   */
+  long double GetBER (double snr, double gainDb) const;
+
+  /**
+   * Return PER for given SNR and PDU length, for a PHY mode that is
+   * gainDb more sensitive than LE 1M.
+   *
+   * \param snr SNR expressed as a power ratio (i.e. not in dB)
+   * \param length PDU length in bytes
+   * \param gainDb energy per bit and coding gain relative to LE 1M
+   * \return packet error rate
+   */
+  double GetPER (double snr, uint32_t length, double gainDb) const;
+
+  /**
+   * Evaluate the closed-form BER expression.
+   *
+   * \param snr SNR expressed as a power ratio (i.e. not in dB)
+   * \return bit error rate
+   */
+  static long double GetExactBER (double snr);
+
+  /*
+   * The table configuration. Changing it makes the model look up the
+   * table of the new configuration on next use.
+   */
+  void SetTableMinSnr (double snrDb);
+  double GetTableMinSnr (void) const;
+  void SetTableMaxSnr (double snrDb);
+  double GetTableMaxSnr (void) const;
+  void SetTablePointsPerDb (double pointsPerDb);
+  double GetTablePointsPerDb (void) const;
+  void SetTableMaxRelativeError (double maxRelativeError);
+  double GetTableMaxRelativeError (void) const;
+
 private:
+  /**
+   * Sampled BER curve, shared between error models with the same
+   * table configuration.
+   */
+  struct BerTable : public SimpleRefCount<BerTable>
+  {
+    double minSnrDb;                 //!< SNR of the first sample
+    double maxSnrDb;                 //!< SNR of the last sample
+    double pointsPerDb;              //!< sample density
+    std::vector<double> logBer;      //!< ln (BER) at each sample
+  };
+
+  /**
+   * Return the shared table for the current configuration, building it
+   * on first use.
+   *
+   * \return the BER table
+   */
+  Ptr<const BerTable> GetTable (void) const;
+
+  /**
+   * Build a table and refine it until it meets the accuracy bound.
+   *
+   * \param minSnrDb lower end of the table
+   * \param maxSnrDb upper end of the table
+   * \param pointsPerDb initial sample density
+   * \param maxRelativeError accuracy bound on the interpolated BER
+   * \return the BER table
+   */
+  static Ptr<const BerTable> BuildTable (double minSnrDb, double maxSnrDb,
+                                         double pointsPerDb,
+                                         double maxRelativeError);
+
+  /**
+   * Locate an SNR in the table.
+   *
+   * \param table the BER table
+   * \param snrDb SNR in dB
+   * \param index set to the sample just below snrDb
+   * \param fraction set to the interpolation weight of the next sample
+   * \return false if snrDb lies outside the table
+   */
+  static bool Locate (Ptr<const BerTable> table, double snrDb,
+                      uint32_t &index, double &fraction);
 
+  bool m_useTable;            //!< look the BER up instead of evaluating it
+  double m_minSnrDb;          //!< lower end of the table
+  double m_maxSnrDb;          //!< upper end of the table
+  double m_pointsPerDb;       //!< table resolution
+  double m_maxRelativeError;  //!< accuracy bound on the interpolated BER
+  mutable Ptr<const BerTable> m_table; //!< table in use
 };
 
 
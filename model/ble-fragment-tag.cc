@@ -0,0 +1,82 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ble-fragment-tag.h"
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (BleFragmentTag);
+
+TypeId
+BleFragmentTag::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BleFragmentTag")
+    .SetParent<Tag> ()
+    .AddConstructor<BleFragmentTag> ()
+    ;
+  return tid;
+}
+
+TypeId
+BleFragmentTag::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+BleFragmentTag::BleFragmentTag ()
+  : m_messageSize (0)
+{
+}
+
+BleFragmentTag::BleFragmentTag (uint16_t messageSize)
+  : m_messageSize (messageSize)
+{
+}
+
+uint16_t
+BleFragmentTag::GetMessageSize (void) const
+{
+  return m_messageSize;
+}
+
+uint32_t
+BleFragmentTag::GetSerializedSize (void) const
+{
+  return 2;
+}
+
+void
+BleFragmentTag::Serialize (TagBuffer i) const
+{
+  i.WriteU16 (m_messageSize);
+}
+
+void
+BleFragmentTag::Deserialize (TagBuffer i)
+{
+  m_messageSize = i.ReadU16 ();
+}
+
+void
+BleFragmentTag::Print (std::ostream &os) const
+{
+  os << "messageSize=" << m_messageSize;
+}
+
+} // namespace ns3
@@ -0,0 +1,72 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BLE_FRAGMENT_TAG_H
+#define BLE_FRAGMENT_TAG_H
+
+#include <ns3/tag.h>
+
+namespace ns3 {
+
+/**
+ * \ingroup BLE
+ *
+ * Marks the first fragment of a payload that was split over several
+ * data channel PDUs, with the size of the whole payload.
+ *
+ * The first fragment is sent with LLID 0b10 and the others with LLID
+ * 0b01. The receiver needs the size of the whole payload to know when it
+ * has all fragments; on air it is the length field of the L2CAP header,
+ * which the BleMacHeader does not model.
+ */
+class BleFragmentTag : public Tag
+{
+public:
+  /**
+   * Get the type ID.
+   *
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+
+  BleFragmentTag ();
+
+  /**
+   * \param messageSize size of the whole payload, in octets
+   */
+  BleFragmentTag (uint16_t messageSize);
+
+  /**
+   * \return the size of the whole payload, in octets
+   */
+  uint16_t GetMessageSize (void) const;
+
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (TagBuffer i) const;
+  virtual void Deserialize (TagBuffer i);
+  virtual void Print (std::ostream &os) const;
+
+private:
+  uint16_t m_messageSize; //!< size of the whole payload
+};
+
+} // namespace ns3
+
+#endif /* BLE_FRAGMENT_TAG_H */
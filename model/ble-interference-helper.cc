@@ -0,0 +1,158 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ble-interference-helper.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/spectrum-model.h>
+
+#include <algorithm>
+#include <iterator>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BleInterferenceHelper");
+
+NS_OBJECT_ENSURE_REGISTERED (BleInterferenceHelper);
+
+TypeId
+BleInterferenceHelper::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BleInterferenceHelper")
+    .SetParent<Object> ()
+    .AddConstructor<BleInterferenceHelper> ()
+    ;
+  return tid;
+}
+
+BleInterferenceHelper::BleInterferenceHelper ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BleInterferenceHelper::~BleInterferenceHelper ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BleInterferenceHelper::AddSignal (Ptr<const SpectrumValue> psd, Time duration)
+{
+  NS_LOG_FUNCTION (this << duration);
+  uint32_t nBands = psd->GetSpectrumModel ()->GetNumBands ();
+  if (m_changes.size () < nBands)
+    {
+      m_changes.resize (nBands);
+      m_basePower.resize (nBands, 0);
+    }
+  Time start = Simulator::Now ();
+  Time end = start + duration;
+  uint32_t band = 0;
+  for (Values::const_iterator it = psd->ConstValuesBegin ();
+       it != psd->ConstValuesEnd (); ++it, ++band)
+    {
+      if (*it != 0)
+        {
+          AddChange (band, start, *it);
+          AddChange (band, end, -*it);
+        }
+    }
+}
+
+void
+BleInterferenceHelper::AddChange (uint32_t band, Time time, double delta)
+{
+  ChangePoints &changes = m_changes[band];
+  ChangePoints::iterator it = changes.lower_bound (time);
+  if (it == changes.end () || it->first != time)
+    {
+      double power = it == changes.begin () ? m_basePower[band] : std::prev (it)->second;
+      it = changes.insert (it, std::make_pair (time, power));
+    }
+  // Only the ends of signals still in the air come later.
+  for (; it != changes.end (); ++it)
+    {
+      it->second += delta;
+    }
+}
+
+void
+BleInterferenceHelper::GetChunks (uint32_t band, double signal, Time start,
+                                  Time end, std::vector<Chunk> &chunks) const
+{
+  NS_LOG_FUNCTION (this << band << signal << start << end);
+  chunks.clear ();
+  if (band >= m_changes.size ())
+    {
+      return;
+    }
+  const ChangePoints &changes = m_changes[band];
+
+  // Power at the start of the signal, including the signal itself.
+  ChangePoints::const_iterator it = changes.upper_bound (start);
+  double power = it == changes.begin () ? m_basePower[band] : std::prev (it)->second;
+
+  Time chunkStart = start;
+  while (chunkStart < end)
+    {
+      Time chunkEnd = end;
+      if (it != changes.end () && it->first < end)
+        {
+          chunkEnd = it->first;
+        }
+      if (chunkEnd > chunkStart)
+        {
+          Chunk chunk;
+          chunk.duration = chunkEnd - chunkStart;
+          // Guard against rounding when the other signals add up to zero.
+          chunk.interference = std::max (power - signal, 0.0);
+          chunks.push_back (chunk);
+        }
+      if (it != changes.end () && it->first == chunkEnd)
+        {
+          power = it->second;
+          ++it;
+        }
+      chunkStart = chunkEnd;
+    }
+}
+
+void
+BleInterferenceHelper::EraseBefore (Time time)
+{
+  NS_LOG_FUNCTION (this << time);
+  for (uint32_t band = 0; band < m_changes.size (); band++)
+    {
+      ChangePoints &changes = m_changes[band];
+      ChangePoints::iterator it = changes.lower_bound (time);
+      if (it != changes.begin ())
+        {
+          m_basePower[band] = std::prev (it)->second;
+          changes.erase (changes.begin (), it);
+        }
+      if (changes.empty ())
+        {
+          // Nothing left in the air in this band; drop the accumulated
+          // rounding error as well.
+          m_basePower[band] = 0;
+        }
+    }
+}
+
+} // namespace ns3
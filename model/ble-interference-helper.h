@@ -0,0 +1,118 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BLE_INTERFERENCE_HELPER_H
+#define BLE_INTERFERENCE_HELPER_H
+
+#include <ns3/object.h>
+#include <ns3/nstime.h>
+#include <ns3/spectrum-value.h>
+#include <map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup BLE
+ *
+ * Keeps track of the power received by a BlePhy.
+ *
+ * Instead of maintaining the total received power as a SpectrumValue and
+ * updating every in-flight reception whenever it changes, this helper only
+ * records the points in time where the power in a band changes. The
+ * band at channel index + 3 carries the centre of a BLE channel, so each
+ * channel index has its own timeline. When a reception ends, the
+ * interference it saw is returned as a list of chunks during which the
+ * interference was constant.
+ *
+ * Every change point also keeps the total power from that point on, so
+ * the power at the start of a reception is found with one lookup. A new
+ * signal only updates the totals of the points after it starts, which
+ * are the ends of the signals still in the air.
+ */
+class BleInterferenceHelper : public Object
+{
+public:
+  /**
+   * A period during which the interference seen by a signal is constant.
+   */
+  struct Chunk
+  {
+    Time duration;        //!< length of the chunk
+    double interference;  //!< power of all other signals in the band
+  };
+
+  /**
+   * Get the type ID.
+   *
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  BleInterferenceHelper ();
+  virtual ~BleInterferenceHelper ();
+
+  /**
+   * Record a signal that starts now.
+   *
+   * \param psd the received power spectral density of the signal
+   * \param duration the duration of the signal
+   */
+  void AddSignal (Ptr<const SpectrumValue> psd, Time duration);
+
+  /**
+   * Compute the interference seen by a signal.
+   *
+   * \param band the band the signal is received in
+   * \param signal the power of the signal itself in that band
+   * \param start the time the signal started
+   * \param end the time the signal ended
+   * \param chunks filled with the interference between start and end
+   */
+  void GetChunks (uint32_t band, double signal, Time start, Time end,
+                  std::vector<Chunk> &chunks) const;
+
+  /**
+   * Forget the change points before a given time. No chunks may be
+   * requested for signals that started earlier.
+   *
+   * \param time the earliest start time that is still needed
+   */
+  void EraseBefore (Time time);
+
+private:
+  /// Power in one band from each change on, keyed by the time it changes.
+  typedef std::map<Time, double> ChangePoints;
+
+  /**
+   * Add a change of the power in a band.
+   *
+   * \param band the band
+   * \param time when the power changes
+   * \param delta the change of the power
+   */
+  void AddChange (uint32_t band, Time time, double delta);
+
+  std::vector<ChangePoints> m_changes; //!< one timeline per band
+  std::vector<double> m_basePower;     //!< power before the first change point
+};
+
+} // namespace ns3
+
+#endif /* BLE_INTERFERENCE_HELPER_H */
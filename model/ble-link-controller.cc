@@ -23,6 +23,7 @@
 #include "ns3/ble-net-device.h"
 #include "ns3/ble-bb-manager.h"
 #include "ns3/ble-link-manager.h"
+#include "ns3/ble-link.h"
 #include "ns3/ble-phy.h"
 #include "ns3/log.h"
 #include "ns3/ble-mac-header.h"
@@ -68,7 +69,7 @@ namespace ns3 {
       m_netDevice = 0;
       m_currentPkt = 0;
       retransmissionCount = 0;
-
+      m_channelQuality.clear ();
     }
 
   /***********************
@@ -152,7 +153,7 @@ namespace ns3 {
 
   void
     BleLinkController::SetCheckedAckCallback (Callback<void, 
-        Ptr<Packet> > callback)
+        Ptr<const Packet>, const BleMacHeader &> callback)
     {
       NS_LOG_FUNCTION (this);
       m_ackChecked = callback;
@@ -160,7 +161,7 @@ namespace ns3 {
 
   void
     BleLinkController::SetCheckedAckErrorCallback (Callback<void, 
-        Ptr<Packet> > callback)
+        Ptr<const Packet> > callback)
     {
       NS_LOG_FUNCTION (this);
       m_ackCheckedError = callback;
@@ -175,9 +176,26 @@ namespace ns3 {
       m_allChannels = allChannels;
     }
 
+  void
+    BleLinkController::SetChannel (Ptr<SpectrumChannel> channel)
+    {
+      NS_LOG_FUNCTION (this);
+      m_channel = channel;
+    }
+
+  Ptr<SpectrumChannel>
+    BleLinkController::GetChannel (void) const
+    {
+      return m_channel;
+    }
+
   Ptr<SpectrumChannel>
     BleLinkController::GetChannelBasedOnChannelIndex (uint8_t channelIndex)
     {
+      if (m_channel != 0)
+      {
+        return m_channel;
+      }
       if (m_allChannels.size() == 0)
       {
         return 0;
@@ -208,12 +226,20 @@ namespace ns3 {
     BleLinkController::StartTransmissionNoArgs()
     {
       NS_LOG_FUNCTION(this);
-      NS_ASSERT (this->GetCurrentPacket() != 0);
-
-      if (StartTransmission (this->GetCurrentPacket()->Copy(), false))
+      Ptr<BleLinkManager> lm = this->GetBBManager()->GetActiveLinkManager();
+      NS_ASSERT (lm != 0 && lm->GetCurrentPacket() != 0);
+
+      // The PHY shares the packet instead of copying it; the header
+      // bytes of the packet are stale, the link manager has the header
+      // that goes on air.
+      const BleMacHeader &header = lm->GetCurrentHeader();
+      if (StartTransmission (lm->GetCurrentPacket(), header, false))
       {
         retransmissionCount++;
-        m_macTxTrace (this->GetCurrentPacket());
+        if (!m_macTxTrace.IsEmpty())
+        {
+          m_macTxTrace (GetTracedPacket (lm->GetCurrentPacket(), header));
+        }
         // Get lastSend time
         lastSend = Simulator::Now();
       }
@@ -224,7 +250,8 @@ namespace ns3 {
     }
 
   bool
-    BleLinkController::StartTransmission (Ptr<Packet> packet, bool ackPacket)
+    BleLinkController::StartTransmission (Ptr<Packet> packet, 
+        const BleMacHeader &header, bool ackPacket)
     {
       NS_LOG_FUNCTION (this);
       // Set parameters of phy device
@@ -236,7 +263,18 @@ namespace ns3 {
             << this->GetPhy()->GetState());
         return false;
       }
-      return this->GetPhy()->PrepareTX (packet);
+      return this->GetPhy()->PrepareTX (packet, header);
+    }
+
+  Ptr<const Packet>
+    BleLinkController::GetTracedPacket (Ptr<const Packet> packet, 
+        const BleMacHeader &header)
+    {
+      Ptr<Packet> copy = packet->Copy();
+      BleMacHeader stale;
+      copy->RemoveHeader(stale);
+      copy->AddHeader(header);
+      return copy;
     }
 
   void
@@ -264,9 +302,16 @@ namespace ns3 {
       NS_LOG_FUNCTION(this);
       NS_ASSERT (lm->GetCurrentPacket() != 0);
       
-      if (StartTransmission (lm->GetCurrentPacket()->Copy(), false)) 
+      // The link manager keeps the header fields that change between
+      // transmissions out of the packet; only trace sinks get a packet
+      // with them serialized.
+      const BleMacHeader &header = lm->GetCurrentHeader();
+      if (StartTransmission (lm->GetCurrentPacket(), header, false)) 
       {
-        m_macTxTrace (lm->GetCurrentPacket());
+        if (!m_macTxTrace.IsEmpty())
+        {
+          m_macTxTrace (GetTracedPacket (lm->GetCurrentPacket(), header));
+        }
       }
       else
       {
@@ -274,10 +319,57 @@ namespace ns3 {
       }
     }
 
+  void
+    BleLinkController::RecordReception (Ptr<BleLinkManager> lm, 
+        bool receptionError)
+    {
+      NS_LOG_FUNCTION (this << receptionError);
+      uint8_t channelIndex = lm->GetCurrentChannelIndex();
+      if (lm->GetAssociatedLink()->GetLinkType() 
+          != BleLink::LinkType::POINT_TO_POINT || channelIndex >= 37)
+      {
+        return;
+      }
+      std::vector<ChannelQuality> &quality = m_channelQuality[lm];
+      if (quality.empty ())
+      {
+        ChannelQuality none = {0, 0};
+        quality.resize (37, none);
+      }
+      if (receptionError)
+      {
+        quality[channelIndex].crcErrors++;
+      }
+      else
+      {
+        quality[channelIndex].received++;
+      }
+    }
+
+  std::vector<BleLinkController::ChannelQuality>
+    BleLinkController::GetChannelQuality (Ptr<BleLinkManager> lm)
+    {
+      std::map<Ptr<BleLinkManager>, std::vector<ChannelQuality>>::iterator it
+        = m_channelQuality.find (lm);
+      if (it == m_channelQuality.end ())
+      {
+        ChannelQuality none = {0, 0};
+        return std::vector<ChannelQuality> (37, none);
+      }
+      return it->second;
+    }
+
+  void
+    BleLinkController::ResetChannelQuality (Ptr<BleLinkManager> lm)
+    {
+      NS_LOG_FUNCTION (this);
+      m_channelQuality.erase (lm);
+    }
+
   // Checks if a received packet is arrived correctly or 
   // needs an acknowledgement and also sends this acknowledgement
   void
-    BleLinkController::CheckReceivedAckPacket (Ptr<Packet> packet, 
+    BleLinkController::CheckReceivedAckPacket (Ptr<const Packet> packet, 
         bool receptionError) 
     {
       NS_LOG_FUNCTION (this);
@@ -286,8 +378,9 @@ namespace ns3 {
       if (receptionError) // Error during packet reception,
       {
         // Ber was too high
-        BleMacHeader bmh;
-        packet->PeekHeader(bmh); 
+        BleMacHeader bmh = this->GetPhy()->GetLastRxHeader();
+        RecordReception (this->GetBBManager()->GetActiveLinkManager(), true);
+        this->GetBBManager()->GetActiveLinkManager()->NotifyFailedPacket ();
         
         // Ignore broadcast for error callback
         if (bmh.GetDestAddr() != Mac16Address("FF:FF") 
@@ -305,10 +398,10 @@ namespace ns3 {
       }
       else
       {
-        BleMacHeader bmh;
+        // The header travels with the signal, no need to deserialize it
+        BleMacHeader bmh = this->GetPhy()->GetLastRxHeader();
         Ptr<BleLinkManager> lm = this->GetBBManager()->GetActiveLinkManager();
         NS_ASSERT (lm != 0);
-        packet->PeekHeader(bmh);
         NS_LOG_DEBUG ("Header received. LLID = " <<
             int(bmh.GetLLID()) << " MD = " << bmh.GetMD() <<
             " SN = " << bmh.GetSN() << " NESN = " <<
@@ -320,12 +413,14 @@ namespace ns3 {
           {
             NS_LOG_INFO ("Received an ADVERTISING packet, length = " 
                 << int(bmh.GetLength()));
-            m_ackChecked (packet);
+            m_ackChecked (packet, bmh);
           }
           else
           {
             bool keepAlive = (bmh.GetLLID() == 0b01) 
               && (bmh.GetLength() == 0);
+            RecordReception (lm, false);
+            lm->NotifyValidPacket ();
 
             // Acknowledgements and flow control:
             lm->SetNESN(bmh.GetNESN()); 
@@ -334,6 +429,7 @@ namespace ns3 {
             if (receivedNew)
             {
               lm->SetPeerHasMoreData(bmh.GetMD());
+              lm->NotifyExchange(bmh);
               if (keepAlive)
               {
                 NS_LOG_INFO ("Received a Keep Alive packet");
@@ -343,7 +439,13 @@ namespace ns3 {
                 //NS_ASSERT (bmh.GetLength() > 0);
                 NS_LOG_INFO ("Received a data packet, length = " 
                     << int(bmh.GetLength()));
-                m_ackChecked (packet);
+                BleMacHeader messageHeader = bmh;
+                Ptr<const Packet> message = 
+                  lm->Reassemble (packet, messageHeader);
+                if (message != 0)
+                {
+                  m_ackChecked (message, messageHeader);
+                }
               }
             }
             else
@@ -359,7 +461,9 @@ namespace ns3 {
             {
               if (! (lm->GetState() == BleLinkManager::State::SCANNER))
               {
-                Simulator::Schedule(
+                // The reception may have been delivered from an event of
+                // the transmitting node; the answer is this node's own.
+                Simulator::ScheduleWithContext(lm->GetNodeContext(),
                     MicroSeconds(T_IFS),&BleLinkManager::SendNextPacket, lm);
               }
             }
@@ -34,6 +34,10 @@
 
 #include <ns3/constants.h>
 #include <ns3/spectrum-channel.h>
+#include <ns3/ble-mac-header.h>
+
+#include <map>
+#include <vector>
 
 namespace ns3 {
 
@@ -80,19 +84,50 @@ namespace ns3 {
       void StartPacketTransmission(Ptr<BleLinkManager> lm);
       void PrepareForReception (Ptr<BleLinkManager> lm);
 
+      // Copy of a PDU with its header bytes rewritten from header,
+      // for trace sinks only
+      static Ptr<const Packet> GetTracedPacket (Ptr<const Packet> packet,
+          const BleMacHeader &header);
+
       // Callback functions
       void SetGenericPhyTxStartCallback (GenericPhyTxStartCallback c);
 
-      void CheckReceivedAckPacket (Ptr<Packet> packet, bool receptionError);
+      void CheckReceivedAckPacket (Ptr<const Packet> packet, bool receptionError);
 
 
-      void SetCheckedAckCallback (Callback<void, Ptr<Packet> > callback);
-      void SetCheckedAckErrorCallback (Callback<void, Ptr<Packet> > callback);
+      // The header is the one received on air; the header bytes of the
+      // packet are stale
+      void SetCheckedAckCallback (Callback<void, Ptr<const Packet>, 
+          const BleMacHeader &> callback);
+      void SetCheckedAckErrorCallback (Callback<void, Ptr<const Packet> > callback);
 
       void SetAllChannels (std::vector<Ptr<SpectrumChannel>> allChannels);
+      /**
+       * Use a single channel for every channel index, e.g. a
+       * BleSpectrumChannel. Takes precedence over SetAllChannels.
+       */
+      void SetChannel (Ptr<SpectrumChannel> channel);
+      Ptr<SpectrumChannel> GetChannel (void) const;
 
       Ptr<SpectrumChannel> GetChannelBasedOnChannelIndex(uint8_t channelIndex);
+
+      /*
+       * Packets received correctly and with a CRC error on a data
+       * channel index, counted per point-to-point link.
+       */
+      struct ChannelQuality
+      {
+        uint32_t received;
+        uint32_t crcErrors;
+      };
+
+      // Counters of a link since the last reset, one per data channel
+      std::vector<ChannelQuality> GetChannelQuality (Ptr<BleLinkManager> lm);
+      void ResetChannelQuality (Ptr<BleLinkManager> lm);
     private:
+      // Count a reception on the current channel of a link
+      void RecordReception (Ptr<BleLinkManager> lm, bool receptionError);
+
       Ptr<BleNetDevice> m_netDevice; // Associated netdevice
 
       Ptr<Packet> m_currentPkt; //!< packet that is current being transmitted
@@ -101,8 +136,8 @@ namespace ns3 {
       Time startTimePacket; //!< time that device tried to send a 
                             //   packet for the first time
       Time lastSend; //!< time at which was last transmission 
-      Callback<void, Ptr<Packet> > m_ackChecked;
-      Callback<void, Ptr<Packet> > m_ackCheckedError;
+      Callback<void, Ptr<const Packet>, const BleMacHeader &> m_ackChecked;
+      Callback<void, Ptr<const Packet> > m_ackCheckedError;
       // Traceback functions:
       TracedCallback<Ptr<const Packet> > m_macTxTrace;
 
@@ -111,9 +146,12 @@ namespace ns3 {
 
       // Functions:
       
-      bool StartTransmission (Ptr<Packet> packet, bool ackPacket);
+      bool StartTransmission (Ptr<Packet> packet, const BleMacHeader &header,
+          bool ackPacket);
       
       std::vector<Ptr<SpectrumChannel>> m_allChannels;
+      Ptr<SpectrumChannel> m_channel; //!< shared by all channel indices, if set
+      std::map<Ptr<BleLinkManager>, std::vector<ChannelQuality>> m_channelQuality;
   };
 
 }
@@ -26,10 +26,16 @@
 #include <ns3/ble-link-controller.h>
 #include <ns3/ble-mac-header.h>
 #include <ns3/mac16-address.h>
-#include <ns3/queue.h>
-#include <ns3/drop-tail-queue.h>
-#include <ns3/queue-item.h>
+#include <ns3/ble-link-queue.h>
+#include <ns3/ble-fragment-tag.h>
 #include <ns3/multi-model-spectrum-channel.h>
+#include <ns3/ble-spectrum-channel.h>
+#include <ns3/boolean.h>
+#include <ns3/enum.h>
+#include <ns3/double.h>
+#include <ns3/uinteger.h>
+#include <cmath>
+#include <limits>
 
 namespace ns3 {
 
@@ -43,7 +49,166 @@ namespace ns3 {
       static TypeId tid = TypeId ("ns3::BleLinkManager")
         .SetParent<Object> ()
         .AddConstructor<BleLinkManager> ()
-        // Add attributes and tracesources
+        .AddAttribute ("IdleFastForward",
+            "Skip the connection events of a point-to-point link while "
+            "both ends have nothing to send, the other links of both "
+            "devices are idle, and so are the links of every receiver in "
+            "interference range of either end. The event counter, "
+            "hop sequence and radio energy of the skipped events are "
+            "accounted for when the link wakes up.",
+            BooleanValue (false),
+            MakeBooleanAccessor (&BleLinkManager::m_idleFastForward),
+            MakeBooleanChecker ())
+        .AddAttribute ("ChannelSelectionAlgorithm",
+            "The channel selection algorithm of new links.",
+            EnumValue (BleLinkManager::CSA_1),
+            MakeEnumAccessor (&BleLinkManager::m_channelSelection),
+            MakeEnumChecker (BleLinkManager::CSA_1, "CSA1",
+                             BleLinkManager::CSA_2, "CSA2"))
+        .AddAttribute ("TransmitWindowSize",
+            "Length of the connection events of new links, unless they are "
+            "extended.",
+            TimeValue (MilliSeconds (5)),
+            MakeTimeAccessor (&BleLinkManager::m_transmitWindowSize),
+            MakeTimeChecker ())
+        .AddAttribute ("MaxConnectionEventLength",
+            "Longest a connection event of a point-to-point link may last. "
+            "Past the transmit window the master goes on while either end "
+            "has more data, as long as it ends T_IFS before the next anchor "
+            "point of any link of both devices; the slave keeps listening "
+            "as long as the master polls it. Zero ends every event with "
+            "its transmit window.",
+            TimeValue (Seconds (0)),
+            MakeTimeAccessor (&BleLinkManager::m_maxEventLength),
+            MakeTimeChecker ())
+        .AddTraceSource ("PdusPerEvent",
+            "Number of PDUs this end sent and received in a connection "
+            "event, reported at its end.",
+            MakeTraceSourceAccessor (&BleLinkManager::m_pdusPerEventTrace),
+            "ns3::BleLinkManager::PdusPerEventCallback")
+        .AddAttribute ("PhyUpdateInterval",
+            "How often the master of a point-to-point link picks the PHY "
+            "mode from the SNR both ends received with and the receptions "
+            "that failed. Zero keeps the mode set with UpdatePhy.",
+            TimeValue (Seconds (0)),
+            MakeTimeAccessor (&BleLinkManager::m_phyUpdateInterval),
+            MakeTimeChecker ())
+        .AddAttribute ("PhyTargetSnr",
+            "SNR in dB, after the gain of the PHY mode, a link should keep. "
+            "The fastest mode that reaches it is used.",
+            DoubleValue (12.0),
+            MakeDoubleAccessor (&BleLinkManager::m_phyTargetSnr),
+            MakeDoubleChecker<double> ())
+        .AddAttribute ("PhySnrHysteresis",
+            "Extra SNR in dB needed to move to a faster PHY mode.",
+            DoubleValue (3.0),
+            MakeDoubleAccessor (&BleLinkManager::m_phySnrHysteresis),
+            MakeDoubleChecker<double> (0.0))
+        .AddAttribute ("PhyMaxPer",
+            "Fraction of the receptions of either end, over a "
+            "PhyUpdateInterval, that may fail with a CRC error before the "
+            "link moves to a more robust PHY mode, whatever the SNR.",
+            DoubleValue (0.1),
+            MakeDoubleAccessor (&BleLinkManager::m_phyMaxPer),
+            MakeDoubleChecker<double> (0.0, 1.0))
+        .AddTraceSource ("PhyUpdate",
+            "A new PHY mode was announced for the link.",
+            MakeTraceSourceAccessor (&BleLinkManager::m_phyUpdateTrace),
+            "ns3::BleLinkManager::PhyUpdateCallback")
+        .AddAttribute ("MaxTxOctets",
+            "Longest LL payload this end is able to send, in octets.",
+            UintegerValue (BLE_MAX_DATA_OCTETS),
+            MakeUintegerAccessor (&BleLinkManager::m_maxTxOctets),
+            MakeUintegerChecker<uint16_t> (BLE_MIN_DATA_OCTETS, 
+              BLE_MAX_DATA_OCTETS))
+        .AddAttribute ("MaxRxOctets",
+            "Longest LL payload this end is able to receive, in octets.",
+            UintegerValue (BLE_MAX_DATA_OCTETS),
+            MakeUintegerAccessor (&BleLinkManager::m_maxRxOctets),
+            MakeUintegerChecker<uint16_t> (BLE_MIN_DATA_OCTETS, 
+              BLE_MAX_DATA_OCTETS))
+        .AddTraceSource ("DataLength",
+            "The data lengths of a point-to-point link were negotiated.",
+            MakeTraceSourceAccessor (&BleLinkManager::m_dataLengthTrace),
+            "ns3::BleLinkManager::DataLengthCallback")
+        .AddAttribute ("TxQueue",
+            "The queue of the packets waiting to be sent on the link.",
+            TypeId::ATTR_GET,
+            PointerValue (),
+            MakePointerAccessor (&BleLinkManager::GetQueue),
+            MakePointerChecker<BleLinkQueue> ())
+        .AddAttribute ("LinkLossDetection",
+            "Tear a point-to-point link down when an end receives no valid "
+            "packet for the connection supervision timeout, or none in the "
+            "first six connection events. Each end runs its own timer; an "
+            "end that stops sending makes the other time out. The timeout "
+            "is raised to twice the time between the events the slave "
+            "listens to if it is shorter.",
+            BooleanValue (false),
+            MakeBooleanAccessor (&BleLinkManager::m_linkLossDetection),
+            MakeBooleanChecker ())
+        .AddAttribute ("SlaveLatency",
+            "Number of consecutive connection events a slave with nothing "
+            "to send may skip.",
+            UintegerValue (0),
+            MakeUintegerAccessor (&BleLinkManager::m_connSlaveLatency),
+            MakeUintegerChecker<uint16_t> (0, 499))
+        .AddAttribute ("SubrateFactor",
+            "Only every n-th connection event of a point-to-point link is "
+            "used while there is no traffic; 1 disables subrating. Data "
+            "queued at either end waits for the next used event; an event "
+            "that carries data or a set MD bit brings the link back to the "
+            "full rate.",
+            UintegerValue (1),
+            MakeUintegerAccessor (&BleLinkManager::m_subrateFactor),
+            MakeUintegerChecker<uint16_t> (1, 500))
+        .AddAttribute ("SubrateContinuation",
+            "Number of connection events a subrated link stays at the full "
+            "rate after an event with data.",
+            UintegerValue (0),
+            MakeUintegerAccessor (&BleLinkManager::m_subrateContinuation),
+            MakeUintegerChecker<uint16_t> ())
+        .AddTraceSource ("SkippedEvents",
+            "Number of connection events this end did not take part in "
+            "because of slave latency or subrating.",
+            MakeTraceSourceAccessor (&BleLinkManager::m_skippedEvents),
+            "ns3::TracedValueCallback::Uint64")
+        .AddAttribute ("AfhInterval",
+            "Time between two classifications of the data channels of a "
+            "point-to-point link by its master. Channels that keep failing "
+            "are taken out of the channel map. Zero disables adaptive "
+            "frequency hopping.",
+            TimeValue (Seconds (0)),
+            MakeTimeAccessor (&BleLinkManager::m_afhInterval),
+            MakeTimeChecker ())
+        .AddAttribute ("AfhErrorThreshold",
+            "Fraction of receptions with a CRC error above which a channel "
+            "is classified as bad.",
+            DoubleValue (0.3),
+            MakeDoubleAccessor (&BleLinkManager::m_afhErrorThreshold),
+            MakeDoubleChecker<double> (0, 1))
+        .AddAttribute ("AfhMinSamples",
+            "Number of receptions on a channel, by both ends together, "
+            "needed to classify it.",
+            UintegerValue (4),
+            MakeUintegerAccessor (&BleLinkManager::m_afhMinSamples),
+            MakeUintegerChecker<uint32_t> ())
+        .AddAttribute ("AfhHoldTime",
+            "Time a bad channel stays out of the channel map before it is "
+            "tried again.",
+            TimeValue (Seconds (10)),
+            MakeTimeAccessor (&BleLinkManager::m_afhHoldTime),
+            MakeTimeChecker ())
+        .AddTraceSource ("ChannelMapUpdate",
+            "A new channel map was chosen for the link, and the connection "
+            "event from which it is used.",
+            MakeTraceSourceAccessor (&BleLinkManager::m_channelMapUpdateTrace),
+            "ns3::BleLinkManager::ChannelMapUpdateCallback")
+        .AddTraceSource ("IdleEventsSkipped",
+            "Number of connection events skipped while the link was idle, "
+            "reported when it wakes up.",
+            MakeTraceSourceAccessor (&BleLinkManager::m_idleEventsSkippedTrace),
+            "ns3::BleLinkManager::IdleEventsSkippedCallback")
         ;
       return tid;
     }
@@ -59,11 +224,69 @@ namespace ns3 {
     m_peerHasMoreData = false;
     m_onePacketSend = false;
     m_lastUnmappedChannelIndex = 0;
+    m_usedChannelMask = 0;
+    m_channelSelection = CSA_1;
+    SetAccessAddress (0x8E89BED6);
+    m_afhInterval = Seconds (0);
+    m_afhErrorThreshold = 0.3;
+    m_afhMinSamples = 4;
+    m_afhHoldTime = Seconds (10);
+    m_channelMapPending = false;
+    m_channelMapInstant = 0;
+
+    m_latencyEventsSkipped = 0;
+    m_subrateFactor = 1;
+    m_subrateContinuation = 0;
+    m_continuationLeft = 0;
+    m_subrateDecided = false;
+    m_subrateCounter = 0;
+    m_subrateSkip = false;
+    m_trafficOnAir = false;
+    m_rxMessageLeft = 0;
+    m_skippedEvents = 0;
+
+    // Links start on LE 1M
+    m_phyMode = BlePhy::LE_1M;
+    m_phyUpdatePending = false;
+    m_phyUpdateInstant = 0;
+    m_pendingPhyMode = BlePhy::LE_1M;
+    m_phyUpdateInterval = Seconds (0);
+    m_phyTargetSnr = 12.0;
+    m_phySnrHysteresis = 3.0;
+    m_phyMaxPer = 0.1;
+    m_rxSnrDb = 0;
+    m_rxSnrValid = false;
+    m_rxGood = 0;
+    m_rxFailed = 0;
+
+    m_maxTxOctets = BLE_MAX_DATA_OCTETS;
+    m_maxRxOctets = BLE_MAX_DATA_OCTETS;
+    // Until negotiated, only the lengths every device supports
+    m_effectiveMaxTxOctets = BLE_MIN_DATA_OCTETS;
+    m_effectiveMaxRxOctets = BLE_MIN_DATA_OCTETS;
+
+    m_maxEventLength = Seconds (0);
+    m_eventPdus = 0;
+    m_extensionStart = Seconds (0);
+
+    m_linkLossDetection = false;
+    m_linkLost = false;
+    m_validRxSinceSetup = false;
 
     m_broadcastCollisionAvoidance = true;
     m_advSleepCounter = 0;
     m_advSleepMax = 10;
 
+    m_nextWindowTimer = 0;
+    m_endOfCurrentWindowTimer = 0;
+    m_anchorValid = false;
+    m_anchorPlanned = false;
+
+    m_idleFastForward = false;
+    m_idleMarked = false;
+    m_idleState = 0;
+    m_parked = false;
+
     SetHopIncrement (1);
     SetKeepAliveActive (true);
     // The numbers that will be defined now are just generic
@@ -75,15 +298,30 @@ namespace ns3 {
     SetTransmitWindowSize (MilliSeconds (5));
     SetTransmitWindowOffset (MicroSeconds (2500));
 
-    Ptr<DropTailQueue<QueueItem>> buffer = Create<DropTailQueue<QueueItem>> ();
-    buffer->SetMaxSize ( QueueSize(QUEUE_SIZE_PACKETS));
-    this->m_queue = buffer;
+    m_queue = CreateObject<BleLinkQueue> ();
   }
 
   void
     BleLinkManager::DoDispose () {
       NS_LOG_FUNCTION (this);
+      m_afhEvent.Cancel ();
+      m_phyEvent.Cancel ();
+      // The timer wheel is shared and may outlive this link
+      m_nextWindow.Cancel ();
+      m_endOfCurrentWindow.Cancel ();
+      Ptr<BleConnEventScheduler> scheduler = m_bbManager == 0 ? 0 :
+        m_bbManager->GetConnEventScheduler();
+      if (scheduler != 0)
+      {
+        scheduler->Cancel (m_nextWindowTimer);
+        scheduler->Cancel (m_endOfCurrentWindowTimer);
+      }
       m_queue = 0;
+      m_peer = 0;
+      m_currentPacket = 0;
+      m_txRemainder = 0;
+      m_rxMessage = 0;
+      m_emptyPdu = 0;
     }
 
   BleLinkManager::~BleLinkManager ()
@@ -227,6 +465,13 @@ namespace ns3 {
       otherLinkManager->m_sequenceNumber = false;
       this->m_lastUnmappedChannelIndex = 0;
       otherLinkManager->m_lastUnmappedChannelIndex = 0;
+      this->m_lastValidRxTime = Simulator::Now();
+      otherLinkManager->m_lastValidRxTime = Simulator::Now();
+      Ptr<UniformRandomVariable> randAA = CreateObject<UniformRandomVariable> ();
+      uint32_t accessAddress = randAA->GetInteger (0, 0xFFFFFFFF);
+      this->SetAccessAddress (accessAddress);
+      otherLinkManager->SetAccessAddress (accessAddress);
+      otherLinkManager->m_channelSelection = this->m_channelSelection;
       // If SLAVE: start advertising in order to find master
       //
       // to start: assume that links are created instantly 
@@ -237,6 +482,8 @@ namespace ns3 {
         link->SetMaster(otherLinkManager->GetBBManager());
         link->SetLinkType(BleLink::LinkType::POINT_TO_POINT);
         otherLinkManager->expectedRole = MASTER_ROLE;
+        this->m_peer = otherLinkManager;
+        otherLinkManager->m_peer = this;
       }
       else if (this->expectedRole == MASTER_ROLE)
       {
@@ -244,6 +491,8 @@ namespace ns3 {
         link->SetMaster(this->GetBBManager());
         link->SetLinkType(BleLink::LinkType::POINT_TO_POINT);
         otherLinkManager->expectedRole = SLAVE_ROLE;
+        this->m_peer = otherLinkManager;
+        otherLinkManager->m_peer = this;
       }
       else // STANDBY and CONNECTIONLESS can be different,
         // but lets start with connected links 
@@ -255,9 +504,13 @@ namespace ns3 {
       link->SetChannel (
           this->GetBBManager()->GetLinkController()
           ->GetChannelBasedOnChannelIndex (0));
+      if (m_peer != 0)
+      {
+        NegotiateDataLength ();
+      }
      
       int connInterval = nbConnectionInterval; //3200
-      int txWindowSize = 5000; //4*1250; // in Microseconds
+      int txWindowSize = GetTransmitWindowSize().GetMicroSeconds();
       int txWindowOffset = nbTxWindowOffset*(txWindowSize/1250+1); 
        
       if (scheduled)
@@ -281,15 +534,15 @@ namespace ns3 {
         this->SetConnInterval (MicroSeconds(connInterval*1250));
         otherLinkManager->SetConnInterval (MicroSeconds(connInterval*1250));
         this->SetTransmitWindowOffset (MicroSeconds (txWindowOffset*1250));
-        this->SetTransmitWindowSize (MilliSeconds (5));
+        this->SetTransmitWindowSize (MicroSeconds (txWindowSize));
         otherLinkManager->SetTransmitWindowOffset (
             MicroSeconds (txWindowOffset*1250));
-        otherLinkManager->SetTransmitWindowSize (MilliSeconds (5));
+        otherLinkManager->SetTransmitWindowSize (MicroSeconds (txWindowSize));
       }
 
       NS_LOG_INFO ("For link " << link << " connInterval = " 
           << connInterval*1250 << "us, txWindowOffset = " 
-          << txWindowOffset*1250 << "us, WindowSize = 5 ms ");
+          << txWindowOffset*1250 << "us, WindowSize = " << txWindowSize << "us");
 
 
       Simulator::ScheduleNow(
@@ -298,6 +551,21 @@ namespace ns3 {
       Simulator::ScheduleNow(
           &BleLinkManager::PrepareNextTransmitWindow,
           otherLinkManager);
+
+      // The master classifies the channels for adaptive frequency hopping
+      Ptr<BleLinkManager> master = (expectedRole == MASTER_ROLE) ? 
+        Ptr<BleLinkManager> (this) : otherLinkManager;
+      if (m_peer != 0 && master->m_afhInterval.IsStrictlyPositive())
+      {
+        master->m_afhChannels = master->m_remappingTable;
+        master->m_afhEvent = Simulator::Schedule (master->m_afhInterval,
+            &BleLinkManager::ClassifyChannels, master);
+      }
+      if (m_peer != 0 && master->m_phyUpdateInterval.IsStrictlyPositive())
+      {
+        master->m_phyEvent = Simulator::Schedule (
+            master->m_phyUpdateInterval, &BleLinkManager::ChoosePhy, master);
+      }
       
     }
 
@@ -316,7 +584,7 @@ namespace ns3 {
       this->SetState(BleLinkManager::State::SCANNER);
       
       int connInterval = nbConnectionInterval; //3200
-      int txWindowSize = 5000; // in Microseconds
+      int txWindowSize = GetTransmitWindowSize().GetMicroSeconds();
       int txWindowOffset = nbTxWindowOffset*(txWindowSize/1250+1); 
      
       if (! scheduled)
@@ -344,6 +612,9 @@ namespace ns3 {
       this->m_nextExpectedSequenceNumber = false;
       this->m_sequenceNumber = false;
       this->m_lastUnmappedChannelIndex = 0;
+      Ptr<UniformRandomVariable> randAA = CreateObject<UniformRandomVariable> ();
+      uint32_t accessAddress = randAA->GetInteger (0, 0xFFFFFFFF);
+      this->SetAccessAddress (accessAddress);
       uint16_t counter = 1;
       uint16_t max_counter = otherLinkManagers.size() + 1; 
  
@@ -357,6 +628,8 @@ namespace ns3 {
         lm->m_nextExpectedSequenceNumber = false;
         lm->m_sequenceNumber = false;
         lm->m_lastUnmappedChannelIndex = 0;
+        lm->SetAccessAddress (accessAddress);
+        lm->m_channelSelection = this->m_channelSelection;
         link->AddSlave(lm->GetBBManager());
         lm->expectedRole = BleLinkManager::Role::CONNECTIONLESS_ROLE;
         lm->SetState(BleLinkManager::State::SCANNER);
@@ -378,7 +651,7 @@ namespace ns3 {
  
       NS_LOG_INFO ("For link " << link << " connInterval = " 
           << connInterval*1250 << "us, txWindowOffset = " 
-          << txWindowOffset*1250 << "us, WindowSize = 5 ms ");
+          << txWindowOffset*1250 << "us, WindowSize = " << txWindowSize << "us");
 
       Simulator::ScheduleNow(
           &BleLinkManager::PrepareNextTransmitWindow,
@@ -417,6 +690,83 @@ namespace ns3 {
       return m_dataChannelIndex;
     }
 
+  void
+    BleLinkManager::SetChannelSelectionAlgorithm (
+        BleLinkManager::ChannelSelectionAlgorithm csa)
+    {
+      NS_LOG_FUNCTION (this << csa);
+      m_channelSelection = csa;
+      if (m_peer != 0)
+      {
+        m_peer->m_channelSelection = csa;
+      }
+    }
+
+  BleLinkManager::ChannelSelectionAlgorithm
+    BleLinkManager::GetChannelSelectionAlgorithm (void)
+    {
+      return m_channelSelection;
+    }
+
+  void
+    BleLinkManager::SetAccessAddress (uint32_t accessAddress)
+    {
+      NS_LOG_FUNCTION (this << accessAddress);
+      m_accessAddress = accessAddress;
+      m_channelIdentifier = (accessAddress >> 16) ^ (accessAddress & 0xFFFF);
+    }
+
+  uint32_t
+    BleLinkManager::GetAccessAddress (void)
+    {
+      return m_accessAddress;
+    }
+
+  void
+    BleLinkManager::SetMaxDataLength (uint16_t maxTxOctets, 
+        uint16_t maxRxOctets)
+    {
+      NS_LOG_FUNCTION (this << maxTxOctets << maxRxOctets);
+      NS_ASSERT (maxTxOctets >= BLE_MIN_DATA_OCTETS 
+          && maxTxOctets <= BLE_MAX_DATA_OCTETS);
+      NS_ASSERT (maxRxOctets >= BLE_MIN_DATA_OCTETS 
+          && maxRxOctets <= BLE_MAX_DATA_OCTETS);
+      m_maxTxOctets = maxTxOctets;
+      m_maxRxOctets = maxRxOctets;
+      if (m_peer != 0)
+      {
+        NegotiateDataLength ();
+      }
+    }
+
+  uint16_t
+    BleLinkManager::GetEffectiveMaxTxOctets (void)
+    {
+      return m_peer == 0 ? m_maxTxOctets : m_effectiveMaxTxOctets;
+    }
+
+  uint16_t
+    BleLinkManager::GetEffectiveMaxRxOctets (void)
+    {
+      return m_peer == 0 ? m_maxRxOctets : m_effectiveMaxRxOctets;
+    }
+
+  void
+    BleLinkManager::NegotiateDataLength (void)
+    {
+      NS_ASSERT (m_peer != 0);
+      // What one end sends, the other has to receive
+      m_effectiveMaxTxOctets = std::min (m_maxTxOctets, m_peer->m_maxRxOctets);
+      m_effectiveMaxRxOctets = std::min (m_maxRxOctets, m_peer->m_maxTxOctets);
+      m_peer->m_effectiveMaxTxOctets = m_effectiveMaxRxOctets;
+      m_peer->m_effectiveMaxRxOctets = m_effectiveMaxTxOctets;
+      NS_LOG_INFO (this << " Data length: " << m_effectiveMaxTxOctets 
+          << " octets TX, " << m_effectiveMaxRxOctets << " octets RX");
+      m_dataLengthTrace (m_effectiveMaxTxOctets, m_effectiveMaxRxOctets);
+      m_peer->m_dataLengthTrace (m_peer->m_effectiveMaxTxOctets, 
+          m_peer->m_effectiveMaxRxOctets);
+    }
+
   Ptr<BleLink>
     BleLinkManager::GetAssociatedLink()
     {
@@ -582,6 +932,7 @@ namespace ns3 {
     {
       NS_LOG_FUNCTION (this);
       m_lastTransmitWindowTime = lasttime;
+      m_eventEnd = lasttime + GetTransmitWindowSize();
       m_firstTransmitWindowDone = true;
     }
 
@@ -598,8 +949,8 @@ namespace ns3 {
       return m_peerHasMoreData;
     }
 
-  Ptr<DropTailQueue<QueueItem>> 
-    BleLinkManager::GetQueue (void)
+  Ptr<BleLinkQueue> 
+    BleLinkManager::GetQueue (void) const
     {
       NS_LOG_FUNCTION (this);
       NS_ASSERT(m_queue != 0);
@@ -632,6 +983,27 @@ namespace ns3 {
       m_currentPacket = packet;
     }
 
+  const BleMacHeader &
+    BleLinkManager::GetCurrentHeader (void) const
+    {
+      return m_currentHeader;
+    }
+
+  void
+    BleLinkManager::BuildEmptyPdu (void)
+    {
+      NS_LOG_FUNCTION (this);
+      m_emptyPduHeader = BleMacHeader ();
+      m_emptyPduHeader.SetLength(0);
+      m_emptyPduHeader.SetLLID(0b01);
+      m_emptyPduHeader.SetMD(0);
+      m_emptyPduHeader.SetSrcAddr(
+          this->GetBBManager()->GetNetDevice()->GetAddress16());
+      m_emptyPduHeader.SetDestAddr(Mac16Address("FF:FF"));
+      m_emptyPdu = Create<Packet> ();
+      m_emptyPdu->AddHeader(m_emptyPduHeader);
+    }
+
   void
     BleLinkManager::SetKeepAliveActive (bool keepAliveActive)
     {
@@ -684,7 +1056,12 @@ namespace ns3 {
       NS_LOG_FUNCTION (this);
 
       Time nextTXWindow = Seconds(0);
-      if (! m_firstTransmitWindowDone) // first window
+      if (! m_firstTransmitWindowDone && m_anchorPlanned 
+          && m_anchor > Simulator::Now()) // first window, at a planned anchor
+      {
+        nextTXWindow = m_anchor - Simulator::Now();
+      }
+      else if (! m_firstTransmitWindowDone) // first window
       {
         nextTXWindow = MicroSeconds (1250) + GetTransmitWindowOffset(); 
       }
@@ -709,11 +1086,92 @@ namespace ns3 {
        return m_lastMD;
      }
 
+   void
+     BleLinkManager::NotifyExchange (const BleMacHeader &received)
+     {
+       NS_LOG_FUNCTION (this);
+       if (received.GetLength() > 0 || received.GetMD() 
+           || m_currentHeader.GetLength() > 0 || m_currentHeader.GetMD())
+       {
+         m_trafficOnAir = true;
+       }
+     }
+
+   Ptr<Packet>
+     BleLinkManager::Fragment (Ptr<Packet> packet, uint32_t payloadSize)
+     {
+       NS_LOG_FUNCTION (this << packet << payloadSize);
+       uint32_t maxTxOctets = GetEffectiveMaxTxOctets();
+       Ptr<Packet> payload = packet->Copy();
+       BleMacHeader header;
+       payload->RemoveHeader (header);
+       // Every fragment carries the header bytes: they hold the addresses
+       Ptr<Packet> fragment = payload->CreateFragment (0, maxTxOctets);
+       fragment->AddHeader (header);
+       m_txRemainder = payload->CreateFragment (maxTxOctets, 
+           payloadSize - maxTxOctets);
+       m_txRemainder->AddHeader (header);
+       if (m_currentHeader.GetLLID() == 0b10)
+       {
+         fragment->AddPacketTag (BleFragmentTag (payloadSize));
+       }
+       NS_LOG_DEBUG ("Sending " << maxTxOctets << " of " << payloadSize 
+           << " octets, the rest follows as a continuation");
+       return fragment;
+     }
+
+   Ptr<const Packet>
+     BleLinkManager::Reassemble (Ptr<const Packet> pdu, 
+         BleMacHeader &header)
+     {
+       NS_LOG_FUNCTION (this << pdu);
+       if (header.GetLLID() == 0b10)
+       {
+         if (m_rxMessage != 0)
+         {
+           NS_LOG_WARN ("New payload before the last " << m_rxMessageLeft 
+               << " octets of the previous one, which is dropped");
+           m_rxMessage = 0;
+         }
+         BleFragmentTag tag;
+         if ((! pdu->PeekPacketTag (tag)) 
+             || tag.GetMessageSize() <= header.GetLength())
+         {
+           return pdu;
+         }
+         m_rxMessage = pdu->Copy();
+         m_rxMessage->RemovePacketTag (tag);
+         m_rxMessageHeader = header;
+         m_rxMessageLeft = tag.GetMessageSize() - header.GetLength();
+         return 0;
+       }
+       if (m_rxMessage == 0)
+       {
+         NS_LOG_WARN ("Continuation of a payload of which the start was "
+             "not received, dropped");
+         return 0;
+       }
+       Ptr<Packet> fragment = pdu->Copy();
+       BleMacHeader fragmentHeader;
+       fragment->RemoveHeader (fragmentHeader);
+       m_rxMessage->AddAtEnd (fragment);
+       m_rxMessageLeft -= std::min (m_rxMessageLeft, 
+           uint32_t (header.GetLength()));
+       if (m_rxMessageLeft > 0)
+       {
+         return 0;
+       }
+       Ptr<Packet> message = m_rxMessage;
+       m_rxMessage = 0;
+       header = m_rxMessageHeader;
+       return message;
+     }
+
    bool
      BleLinkManager::IsInsideLastTransmitWindow (Time thisTime)
      {
        return (thisTime >= GetLastTransmitWindowTime() 
-           && thisTime <= GetLastTransmitWindowTime () + GetTransmitWindowSize ());
+           && thisTime <= m_eventEnd);
      }
 
    // Prepares the simulator for the next transmitwindow
@@ -722,10 +1180,106 @@ namespace ns3 {
      BleLinkManager::PrepareNextTransmitWindow ()
      {
        NS_LOG_FUNCTION (this);
-       m_nextWindow = Simulator::Schedule(
-           GetNextTransmitWindowTime(),
-           &BleLinkManager::StartTransmitWindow,
-           this);
+       ScheduleWindowStart (GetNextTransmitWindowTime());
+     }
+
+   void
+     BleLinkManager::ScheduleWindowStart (Time delay)
+     {
+       m_anchor = Simulator::Now() + delay;
+       m_anchorValid = true;
+       Ptr<BleConnEventScheduler> scheduler = 
+         this->GetBBManager()->GetConnEventScheduler();
+       if (scheduler != 0)
+       {
+         m_nextWindowTimer = scheduler->ScheduleWithContext (GetNodeContext (),
+             delay, &BleLinkManager::StartTransmitWindow, this);
+       }
+       else
+       {
+         m_nextWindow = Simulator::Schedule(delay,
+             &BleLinkManager::StartTransmitWindow, this);
+       }
+     }
+
+   void
+     BleLinkManager::ScheduleWindowEnd (Time delay)
+     {
+       Ptr<BleConnEventScheduler> scheduler = 
+         this->GetBBManager()->GetConnEventScheduler();
+       if (scheduler != 0)
+       {
+         m_endOfCurrentWindowTimer = scheduler->ScheduleWithContext (GetNodeContext (),
+             delay, &BleLinkManager::EndTransmitWindow, this);
+       }
+       else
+       {
+         m_endOfCurrentWindow = Simulator::Schedule(delay,
+             &BleLinkManager::EndTransmitWindow, this);
+       }
+     }
+
+   uint32_t
+     BleLinkManager::GetNodeContext ()
+     {
+       Ptr<BleNetDevice> device = this->GetBBManager()->GetNetDevice();
+       if (device != 0 && device->GetNode() != 0)
+       {
+         return device->GetNode()->GetId();
+       }
+       return Simulator::GetContext();
+     }
+
+   bool
+     BleLinkManager::CancelNextWindow ()
+     {
+       bool pending = m_nextWindow.IsRunning ();
+       m_nextWindow.Cancel ();
+       Ptr<BleConnEventScheduler> scheduler = 
+         this->GetBBManager()->GetConnEventScheduler();
+       if (scheduler != 0)
+       {
+         pending = pending || scheduler->IsPending (m_nextWindowTimer);
+         scheduler->Cancel (m_nextWindowTimer);
+       }
+       return pending;
+     }
+
+   Time
+     BleLinkManager::GetAnchor ()
+     {
+       if (m_anchorValid)
+       {
+         return m_anchor;
+       }
+       // PrepareNextTransmitWindow has not run yet
+       return Simulator::Now() + GetNextTransmitWindowTime();
+     }
+
+   void
+     BleLinkManager::MoveAnchor (Time anchor, Time connInterval)
+     {
+       NS_LOG_FUNCTION (this << anchor << connInterval);
+       NS_ASSERT (anchor >= Simulator::Now());
+       // A parked link first catches up with the events it skipped
+       Ptr<BleLinkManager> master = m_peer;
+       if (expectedRole == MASTER_ROLE)
+       {
+         master = this;
+       }
+       if (master != 0 && master->m_parked)
+       {
+         master->Resume ();
+       }
+
+       SetConnInterval (connInterval);
+       m_anchor = anchor;
+       m_anchorValid = true;
+       m_anchorPlanned = true;
+       if (CancelNextWindow ())
+       {
+         ScheduleWindowStart (anchor - Simulator::Now());
+       }
      }
 
   bool 
@@ -787,33 +1341,59 @@ namespace ns3 {
            else // No current packet
            {
              NS_ASSERT(m_queue != 0);
-             if (! (m_queue->IsEmpty()))
+             if (m_txRemainder != 0 || ! (m_queue->IsEmpty()))
              {
-               BleMacHeader bmh1;
-               Ptr<QueueItem> item = m_queue->Dequeue ();
-               NS_ASSERT (item);
-               NS_LOG_DEBUG ("New packet set as current packet. "
-                   "This new packet is not a dummy / Keep Alive Packet. "
-                   "Packets left in the queue: "
-                   << m_queue->GetCurrentSize());
-               Ptr<Packet> packet = item->GetPacket();
-               packet->RemoveHeader(bmh1);
-
-               if (this->GetState() == ADVERTISER)
+               Ptr<Packet> packet;
+               if (m_txRemainder != 0)
                {
-                 // If advertising, dest address needs to be broadcast address
-                 NS_ASSERT (bmh1.GetDestAddr() == Mac16Address("ff:ff"));
+                 // Rest of a payload of which the start was sent
+                 packet = m_txRemainder;
+                 m_txRemainder = 0;
+                 packet->PeekHeader(m_currentHeader);
+                 m_currentHeader.SetLLID(0b01);
+               }
+               else
+               {
+                 packet = m_queue->Dequeue ();
+                 NS_ASSERT (packet);
+                 NS_LOG_DEBUG ("New packet set as current packet. "
+                     "This new packet is not a dummy / Keep Alive Packet. "
+                     "Packets left in the queue: "
+                     << m_queue->GetNPackets());
+                 // The addresses and protocol come from the header bytes;
+                 // the link layer fields are only kept in m_currentHeader.
+                 packet->PeekHeader(m_currentHeader);
+
+                 if (this->GetState() == ADVERTISER)
+                 {
+                   // If advertising, dest address needs to be broadcast address
+                   NS_ASSERT (m_currentHeader.GetDestAddr() == Mac16Address("ff:ff"));
+                 }
+                 m_currentHeader.SetLLID(0b10);
+               }
+               uint32_t payloadSize = packet->GetSize() 
+                 - m_currentHeader.GetSerializedSize();
+               if (payloadSize > GetEffectiveMaxTxOctets())
+               {
+                 if (this->GetState() == ADVERTISER)
+                 {
+                   // An advertising PDU cannot be continued
+                   NS_LOG_WARN ("Payload of " << payloadSize 
+                       << " octets exceeds the data length of " 
+                       << GetEffectiveMaxTxOctets() << " octets, dropped");
+                   this->GetBBManager()->GetNetDevice()
+                     ->NotifyTransmissionDrop (packet);
+                   this->SetState(SCANNER);
+                   return;
+                 }
+                 packet = Fragment (packet, payloadSize);
+                 payloadSize = GetEffectiveMaxTxOctets();
                }
-               
-               bmh1.SetLLID(0b10);
-               bmh1.SetNESN(m_nextExpectedSequenceNumber);
-               bmh1.SetSN(m_sequenceNumber);
                // More data to send
-               bmh1.SetMD(! m_queue->IsEmpty ());
-               this->SetMyLastMD(! m_queue->IsEmpty ());
-               //bmh1.SetLength(item->GetPacket ()->GetSize());
-               bmh1.SetLength(1);
-               packet->AddHeader(bmh1);
+               bool moreData = m_txRemainder != 0 || ! m_queue->IsEmpty ();
+               m_currentHeader.SetMD(moreData);
+               this->SetMyLastMD(moreData);
+               m_currentHeader.SetLength(payloadSize);
                this->SetCurrentPacket (packet);
                m_onePacketSend =true;
              }
@@ -833,19 +1413,14 @@ namespace ns3 {
                //   - If I don't answer, connection can be considered lost
                //   - I need to ack received packet
                {
-                 BleMacHeader bmh2;
-                 Ptr<Packet> dummyPacket = Create<Packet> ();
-                 bmh2.SetLength(0);
-                 bmh2.SetLLID(0b01);
-                 bmh2.SetMD(0);
+                 if (m_emptyPdu == 0)
+                 {
+                   BuildEmptyPdu ();
+                 }
+                 // Sequence numbers are set below, in the header only
+                 m_currentHeader = m_emptyPduHeader;
                  this->SetMyLastMD(! m_queue->IsEmpty ());
-                 bmh2.SetNESN(m_nextExpectedSequenceNumber);
-                 bmh2.SetSN(m_sequenceNumber);
-                 bmh2.SetSrcAddr(
-                     this->GetBBManager()->GetNetDevice()->GetAddress16());
-                 bmh2.SetDestAddr(Mac16Address("FF:FF"));
-                 dummyPacket->AddHeader(bmh2);
-                 SetCurrentPacket (dummyPacket);
+                 SetCurrentPacket (m_emptyPdu);
                  m_onePacketSend = true;
                }
                else
@@ -856,11 +1431,14 @@ namespace ns3 {
 
            if (! this->GetCurrentPacket() == 0)
            {
-             BleMacHeader bmh3;
-             this->GetCurrentPacket()->PeekHeader(bmh3);
+             // Retransmissions acknowledge what was received since the
+             // first attempt.
+             m_currentHeader.SetNESN(m_nextExpectedSequenceNumber);
+             m_currentHeader.SetSN(m_sequenceNumber);
              NS_LOG_INFO ("Src Addr for current packet: " 
-                 << bmh3.GetSrcAddr() << " Dest address for current packet: " 
-                 << bmh3.GetDestAddr()); 
+                 << m_currentHeader.GetSrcAddr() << " Dest address for current packet: " 
+                 << m_currentHeader.GetDestAddr()); 
+             m_eventPdus++;
              Simulator::ScheduleNow(
                      &BleLinkController::StartPacketTransmission, 
                      this->GetBBManager()->GetLinkController(),
@@ -916,6 +1494,15 @@ namespace ns3 {
        // wait for packet from master to arrive
 
        NS_LOG_FUNCTION (this);
+       if (CheckSupervision ())
+       {
+         return;
+       }
+       if (SkipThisEvent ())
+       {
+         SkipTransmitWindow ();
+         return;
+       }
        if ( this->GetBBManager()->GetActiveLinkManager() == 0)
        {
          this->GetBBManager()->SetActiveLinkManager(this);
@@ -926,14 +1513,15 @@ namespace ns3 {
              << this->GetBBManager());
 
          SetLastTransmitWindowTime(Simulator::Now());
-         m_endOfCurrentWindow = Simulator::Schedule (
-             GetTransmitWindowSize(),
-             &BleLinkManager::EndTransmitWindow,
-             this);
+         ScheduleWindowEnd (GetTransmitWindowSize());
 
          m_firstTransmitWindowDone = true;
          m_onePacketSend = false;
+         m_eventPdus = 0;
+         m_extensionStart = Simulator::Now();
          SetMyLastMD(true);
+         m_windowTxTime = this->GetBBManager()->GetPhy()->GetTotalTxTime();
+         m_windowRxTime = this->GetBBManager()->GetPhy()->GetTotalRxTime();
 
          PrepareNextTransmitWindow ();
          ManageChannelSelection();
@@ -1027,6 +1615,13 @@ namespace ns3 {
            << " this BBM = " << this->GetBBManager());
        
        NS_LOG_INFO ("End of a TransmitWindow");
+       if (ExtendEvent ())
+       {
+         return;
+       }
+       m_pdusPerEventTrace (m_eventPdus);
+       m_eventPdus = 0;
+
        // set phy in standby mode after current TX / RX event is done,
        // deactive activeLinkManager in BBM
        // schedule next tx window
@@ -1062,52 +1657,805 @@ namespace ns3 {
          }
        }
 
+       if (m_idleFastForward && expectedRole == MASTER_ROLE && m_peer != 0)
+       {
+         CheckIdle ();
+       }
+     }
+
+   Time
+     BleLinkManager::GetNextOtherAnchor (Ptr<BleBBManager> bbm, Time after)
+     {
+       Time next = Time::Max ();
+       for (auto lm : bbm->GetLinkManagers ())
+       {
+         if (lm->GetAssociatedLink() != this->GetAssociatedLink() 
+             && lm->GetAnchor() > after && lm->GetAnchor() < next)
+         {
+           next = lm->GetAnchor();
+         }
+       }
+       return next;
      }
 
    bool
-     BleLinkManager::IsUsedChannel (uint8_t channelIndex)
+     BleLinkManager::ExtendEvent ()
+     {
+       if (! m_maxEventLength.IsStrictlyPositive() || m_peer == 0
+           || this->GetBBManager()->GetActiveLinkManager() != this
+           || ! (GetMyLastMD() || GetPeerHasMoreData()))
+       {
+         return false;
+       }
+       Time now = Simulator::Now();
+       // The master decides; the slave only keeps listening while the
+       // master still polls it. If the last PDU of either end was lost,
+       // the slave stops after one extension without a packet instead
+       // of waiting for an event the master already ended.
+       if (expectedRole == SLAVE_ROLE && m_lastValidRxTime < m_extensionStart)
+       {
+         return false;
+       }
+       Time limit = GetLastTransmitWindowTime() + m_maxEventLength;
+       // Leave T_IFS before the next event of this link and of the
+       // other links of this device, and for the master also of those
+       // of the slave, whose anchors were negotiated with it
+       limit = std::min (limit, GetAnchor());
+       limit = std::min (limit, 
+           GetNextOtherAnchor (this->GetBBManager(), now));
+       if (expectedRole == MASTER_ROLE)
+       {
+         limit = std::min (limit, 
+             GetNextOtherAnchor (m_peer->GetBBManager(), now));
+       }
+       limit = limit - MicroSeconds (T_IFS);
+       // Not worth it if there is no room for another exchange
+       if (limit < now + MicroSeconds (4 * T_IFS))
+       {
+         return false;
+       }
+       m_eventEnd = std::min (limit, now + GetTransmitWindowSize());
+       m_extensionStart = now;
+       NS_LOG_INFO (this << " More data, connection event extended until " 
+           << m_eventEnd.GetSeconds() << "s");
+       ScheduleWindowEnd (m_eventEnd - now);
+       return true;
+     }
+
+   void
+     BleLinkManager::NotifyValidPacket ()
+     {
+       m_lastValidRxTime = Simulator::Now();
+       m_validRxSinceSetup = true;
+       m_eventPdus++;
+       m_rxGood++;
+       AddSnrSample ();
+     }
+
+   void
+     BleLinkManager::NotifyFailedPacket ()
+     {
+       if (m_peer == 0)
+       {
+         return;
+       }
+       // A failed reception says most about the link; leaving it out
+       // would only average the SNR of the lucky ones
+       m_rxFailed++;
+       AddSnrSample ();
+     }
+
+   void
+     BleLinkManager::AddSnrSample ()
+     {
+       double snr = this->GetBBManager()->GetPhy()->GetLastRxSnr();
+       if (snr > 0 && snr < std::numeric_limits<double>::infinity())
+       {
+         // Moving average, weight 1/8 for the new sample
+         double snrDb = 10 * std::log10 (snr);
+         m_rxSnrDb = m_rxSnrValid ? m_rxSnrDb + (snrDb - m_rxSnrDb) / 8 
+           : snrDb;
+         m_rxSnrValid = true;
+       }
+     }
+
+   Time
+     BleLinkManager::GetSupervisionTimeout ()
+     {
+       Ptr<BleLinkManager> master = m_peer;
+       Ptr<BleLinkManager> slave = this;
+       if (expectedRole == MASTER_ROLE)
+       {
+         master = this;
+         slave = m_peer;
+       }
+       int64_t interval = GetConnInterval().GetTimeStep() 
+         * master->m_subrateFactor;
+       if (! m_validRxSinceSetup)
+       {
+         // The link was never established
+         return MicroSeconds (1250) + GetTransmitWindowOffset() 
+           + TimeStep (6 * interval);
+       }
+       Time minimum = TimeStep (2 * (slave->m_connSlaveLatency + 1) * interval);
+       return std::max (GetConnSupervisionTimeout(), minimum);
+     }
+
+   bool
+     BleLinkManager::CheckSupervision ()
+     {
+       if (m_linkLost)
+       {
+         // Already torn down
+         return true;
+       }
+       if (m_peer == 0 || ! m_linkLossDetection)
+       {
+         return false;
+       }
+       if (Simulator::Now() - m_lastValidRxTime > GetSupervisionTimeout())
+       {
+         NS_LOG_INFO (this << " Link " << this->GetAssociatedLink() 
+             << " lost, last valid packet at " 
+             << m_lastValidRxTime.GetSeconds() << "s");
+         // The peer stops hearing this end and times out on its own
+         m_linkLost = true;
+         TearDown ();
+         return true;
+       }
+       return false;
+     }
+
+   void
+     BleLinkManager::TearDown ()
+     {
+       NS_LOG_FUNCTION (this);
+       CancelNextWindow ();
+       m_endOfCurrentWindow.Cancel ();
+       Ptr<BleConnEventScheduler> scheduler = 
+         this->GetBBManager()->GetConnEventScheduler();
+       if (scheduler != 0)
+       {
+         scheduler->Cancel (m_endOfCurrentWindowTimer);
+       }
+       m_afhEvent.Cancel ();
+       m_phyEvent.Cancel ();
+       Ptr<BleLinkManager> master = m_peer;
+       if (expectedRole == MASTER_ROLE)
+       {
+         master = this;
+       }
+       if (master != 0)
+       {
+         master->MarkIdle (false);
+       }
+       // The peer keeps its own reference until it times out as well
+       m_peer = 0;
+       this->GetBBManager()->GetLinkController()->ResetChannelQuality (this);
+       m_queue->Flush ();
+       m_currentPacket = 0;
+       m_txRemainder = 0;
+       m_rxMessage = 0;
+       if (this->GetBBManager()->GetActiveLinkManager() == this
+           && this->GetBBManager()->GetPhyState() != BlePhy::State::TX)
+       {
+         this->GetBBManager()->GetPhy()->ChangeState(BlePhy::State::IDLE);
+         this->GetBBManager()->SetActiveLinkManager(0);
+       }
+       this->GetBBManager()->LinkLost (this, m_validRxSinceSetup);
+     }
+
+   void
+     BleLinkManager::SetSubrating (uint16_t factor, uint16_t continuation)
      {
-       for (auto v : this->m_usedChannels) 
+       NS_LOG_FUNCTION (this << factor << continuation);
+       NS_ASSERT (factor >= 1);
+       m_subrateFactor = factor;
+       m_subrateContinuation = continuation;
+     }
+
+   bool
+     BleLinkManager::HasTraffic ()
+     {
+       return (! m_queue->IsEmpty()) 
+         || this->GetCurrentPacket() != 0
+         || m_txRemainder != 0
+         || GetPeerHasMoreData();
+     }
+
+   bool
+     BleLinkManager::SkipSubratedEvent (uint16_t counter)
+     {
+       if (m_subrateDecided && m_subrateCounter == counter 
+           && m_subrateTime == Simulator::Now())
+       {
+         return m_subrateSkip;
+       }
+       m_subrateDecided = true;
+       m_subrateCounter = counter;
+       m_subrateTime = Simulator::Now();
+       // Only what was exchanged on air counts; the slave's queue is not
+       // known here, and its data waits for a used event.
+       bool traffic = m_trafficOnAir;
+       m_trafficOnAir = false;
+       if (m_subrateFactor <= 1 || traffic)
+       {
+         // A burst brings the link back to the full rate
+         m_continuationLeft = m_subrateContinuation;
+         m_subrateSkip = false;
+       }
+       else if (m_continuationLeft > 0)
+       {
+         m_continuationLeft--;
+         m_subrateSkip = false;
+       }
+       else
+       {
+         m_subrateSkip = (counter % m_subrateFactor) != 0;
+       }
+       return m_subrateSkip;
+     }
+
+   bool
+     BleLinkManager::SkipThisEvent ()
+     {
+       if (m_peer == 0)
        {
-         if (v == channelIndex)
+         return false;
+       }
+       Ptr<BleLinkManager> master = m_peer;
+       if (expectedRole == MASTER_ROLE)
+       {
+         master = this;
+       }
+       if (master->SkipSubratedEvent (m_connEventCounter))
+       {
+         return true;
+       }
+
+       // The master polls every event; a slave with nothing to send
+       // only listens once every m_connSlaveLatency + 1 events.
+       if (expectedRole == SLAVE_ROLE && m_connSlaveLatency > 0)
+       {
+         if (m_latencyEventsSkipped < m_connSlaveLatency && ! HasTraffic ())
+         {
+           m_latencyEventsSkipped++;
            return true;
+         }
+         m_latencyEventsSkipped = 0;
        }
        return false;
      }
- 
+
    void
-     BleLinkManager::SetUsedChannels (std::vector<uint8_t> usedChannels)
+     BleLinkManager::SkipTransmitWindow ()
      {
        NS_LOG_FUNCTION (this);
-       m_usedChannels = usedChannels;
+       NS_LOG_INFO (this << " Skipping connection event " 
+           << m_connEventCounter << " my link = " << this->GetAssociatedLink());
+       m_skippedEvents++;
+       SetLastTransmitWindowTime(Simulator::Now());
+       PrepareNextTransmitWindow ();
+       ManageChannelSelection();
      }
 
+   bool
+     BleLinkManager::IsIdle ()
+     {
+       return m_queue->IsEmpty() 
+         && this->GetBBManager()->GetQueue()->IsEmpty()
+         && this->GetCurrentPacket() == 0
+         && m_txRemainder == 0
+         && m_rxMessage == 0
+         && (! GetPeerHasMoreData())
+         && this->GetBBManager()->CountLinks() == 1
+         && this->GetBBManager()->GetActiveLinkManager() == 0;
+     }
+
+   Ptr<BleSpectrumChannel>
+     BleLinkManager::GetBleChannel ()
+     {
+       return DynamicCast<BleSpectrumChannel> (
+           this->GetBBManager()->GetLinkController()->GetChannel());
+     }
+
+   uint8_t
+     BleLinkManager::GetSequenceState ()
+     {
+       return m_sequenceNumber | m_nextExpectedSequenceNumber << 1
+         | m_peer->m_sequenceNumber << 2 
+         | m_peer->m_nextExpectedSequenceNumber << 3;
+     }
 
    void
-     BleLinkManager::ManageChannelSelection ()
+     BleLinkManager::CheckIdle ()
+     {
+       NS_LOG_FUNCTION (this);
+       Ptr<BleSpectrumChannel> channel = GetBleChannel ();
+       // With slave latency or subrating the events of an idle link differ
+       // from each other, so none of them stands for the skipped ones.
+       if (channel == 0 || (! IsIdle ()) || (! m_peer->IsIdle ())
+           || m_subrateFactor > 1 || m_peer->m_connSlaveLatency > 0)
+       {
+         MarkIdle (false);
+         return;
+       }
+
+       // Radio activity of both ends during this event
+       Ptr<BlePhy> phy = this->GetBBManager()->GetPhy();
+       Ptr<BlePhy> peerPhy = m_peer->GetBBManager()->GetPhy();
+       m_idleTxTime = phy->GetTotalTxTime() - m_windowTxTime;
+       m_idleRxTime = phy->GetTotalRxTime() - m_windowRxTime;
+       m_peer->m_idleTxTime = peerPhy->GetTotalTxTime() - m_peer->m_windowTxTime;
+       m_peer->m_idleRxTime = peerPhy->GetTotalRxTime() - m_peer->m_windowRxTime;
+
+       // Only skip events once an empty exchange has been seen to leave
+       // the sequence numbers as they were, so skipping changes nothing.
+       uint8_t state = GetSequenceState ();
+       if ((! m_idleMarked) || state != m_idleState)
+       {
+         m_idleState = state;
+         MarkIdle (true);
+         return;
+       }
+
+       // Busy links that share a device with either end, or whose
+       // receivers are in range of ours, could have used the radio or the
+       // air during the events we would skip; keep simulating as long as
+       // there are any.
+       if (IsDeviceIdle (this->GetBBManager()) && IsDeviceIdle (m_peer->GetBBManager())
+           && channel->GetNBusyRx (phy) == 0 && channel->GetNBusyRx (peerPhy) == 0)
+       {
+         Park ();
+       }
+     }
+
+   bool
+     BleLinkManager::IsDeviceIdle (Ptr<BleBBManager> bbm)
+     {
+       for (auto lm : bbm->GetLinkManagers ())
+       {
+         if (lm == this || lm == m_peer)
+         {
+           continue;
+         }
+         Ptr<BleLinkManager> master = lm->m_peer;
+         if (lm->expectedRole == MASTER_ROLE)
+         {
+           master = lm;
+         }
+         if (master == 0 || ! master->m_idleMarked)
+         {
+           return false;
+         }
+       }
+       return true;
+     }
+
+   void
+     BleLinkManager::MarkIdle (bool idle)
+     {
+       NS_LOG_FUNCTION (this << idle);
+       if (m_idleMarked == idle)
+       {
+         return;
+       }
+       m_idleMarked = idle;
+       Ptr<BleSpectrumChannel> channel = GetBleChannel ();
+       if (channel != 0)
+       {
+         channel->SetRxIdle (this->GetBBManager()->GetPhy(), idle);
+         channel->SetRxIdle (m_peer->GetBBManager()->GetPhy(), idle);
+       }
+     }
+
+   void
+     BleLinkManager::Park ()
+     {
+       NS_LOG_FUNCTION (this);
+       NS_LOG_INFO (this << " Link " << this->GetAssociatedLink() 
+           << " is idle, skipping its connection events");
+       m_parked = true;
+       m_parkedAnchor = GetLastTransmitWindowTime() + GetConnInterval();
+       CancelNextWindow ();
+       m_peer->CancelNextWindow ();
+
+       Time interval = GetConnInterval();
+       this->GetBBManager()->GetPhy()->NotifyIdleEvents (
+           m_idleTxTime, m_idleRxTime, interval);
+       m_peer->GetBBManager()->GetPhy()->NotifyIdleEvents (
+           m_peer->m_idleTxTime, m_peer->m_idleRxTime, interval);
+
+       std::vector<Ptr<SpectrumPhy> > phys;
+       phys.push_back (this->GetBBManager()->GetPhy());
+       phys.push_back (m_peer->GetBBManager()->GetPhy());
+       GetBleChannel ()->NotifyWhenBusy (phys,
+           MakeCallback (&BleLinkManager::Resume, this));
+     }
+
+   void
+     BleLinkManager::Resume ()
      {
        NS_LOG_FUNCTION (this);
+       if (! m_parked)
+       {
+         return;
+       }
+       m_parked = false;
+
+       // Events that started before now are skipped for good;
+       // the link picks up at the next anchor point.
+       int64_t interval = GetConnInterval().GetTimeStep();
+       Time now = Simulator::Now();
+       uint64_t nbEvents = 0;
+       if (now > m_parkedAnchor)
+       {
+         nbEvents = ((now - m_parkedAnchor).GetTimeStep() + interval - 1) 
+           / interval;
+       }
+       Time nextAnchor = m_parkedAnchor + TimeStep (nbEvents * interval);
+       NS_LOG_INFO (this << " Link " << this->GetAssociatedLink() 
+           << " wakes up after " << nbEvents << " skipped events");
+
+       FastForward (nbEvents, nextAnchor);
+       m_peer->FastForward (nbEvents, nextAnchor);
+       m_idleEventsSkippedTrace (nbEvents);
+     }
+
+   void
+     BleLinkManager::FastForward (uint32_t nbEvents, Time nextAnchor)
+     {
+       NS_LOG_FUNCTION (this << nbEvents << nextAnchor);
+       // Each event advances the counter and the hop sequence once
+       m_connEventCounter += nbEvents;
+       m_lastUnmappedChannelIndex = (m_lastUnmappedChannelIndex 
+           + (nbEvents % 37) * m_hopIncrement) % 37;
+       if (nbEvents > 0)
+       {
+         SetLastTransmitWindowTime (nextAnchor - GetConnInterval());
+       }
+       this->GetBBManager()->GetPhy()->NotifyIdleEvents (
+           Seconds (0), Seconds (0), Seconds (0));
+       // The skipped events were empty exchanges that went through
+       m_lastValidRxTime = Simulator::Now();
+
+       ScheduleWindowStart (nextAnchor - Simulator::Now());
+     }
+
+   void
+     BleLinkManager::WakeUp ()
+     {
+       NS_LOG_FUNCTION (this);
+       Ptr<BleLinkManager> master = m_peer;
+       if (expectedRole == MASTER_ROLE)
+       {
+         master = this;
+       }
+       if (master == 0 || ! master->m_idleMarked)
+       {
+         return;
+       }
+       // Marking the link busy also wakes up the idle links
+       // that were waiting for the channel to become busy.
+       master->MarkIdle (false);
+       master->Resume ();
+     }
+
+   bool
+     BleLinkManager::IsUsedChannel (uint8_t channelIndex)
+     {
+       return channelIndex < 64 && (m_usedChannelMask >> channelIndex) & 1;
+     }
+ 
+   void
+     BleLinkManager::SetUsedChannels (std::vector<uint8_t> usedChannels)
+     {
+       NS_LOG_FUNCTION (this);
+       m_usedChannelMask = 0;
+       for (auto v : usedChannels)
+       {
+         NS_ASSERT (v < 64);
+         m_usedChannelMask |= uint64_t (1) << v;
+       }
+       m_remappingTable.clear ();
+       for (uint8_t i = 0; i < 64; i++)
+       {
+         if (IsUsedChannel (i))
+         {
+           m_remappingTable.push_back (i);
+         }
+       }
+     }
+
+   uint8_t
+     BleLinkManager::SelectChannelCsa1 ()
+     {
        m_unmappedChannelIndex = (m_lastUnmappedChannelIndex + m_hopIncrement) % 37;
+       m_lastUnmappedChannelIndex = m_unmappedChannelIndex;
        if (IsUsedChannel (m_unmappedChannelIndex)) 
          // Is unmappedChannelIndex = used channel
        {
-         // Select channel index
-         m_dataChannelIndex = m_unmappedChannelIndex;
+         return m_unmappedChannelIndex;
+       }
+       NS_ASSERT (m_remappingTable.size() != 0);
+       uint8_t remappingIndex = m_unmappedChannelIndex % m_remappingTable.size();
+       return m_remappingTable[remappingIndex];
+     }
+
+   void
+     BleLinkManager::ClassifyChannels ()
+     {
+       NS_LOG_FUNCTION (this);
+       if (m_peer == 0)
+       {
+         // The link is gone
+         return;
+       }
+       m_afhEvent = Simulator::Schedule (m_afhInterval,
+           &BleLinkManager::ClassifyChannels, this);
+       if (m_channelMapPending)
+       {
+         // Wait for the previous update to take effect
+         return;
+       }
+
+       // What both ends received since the last classification
+       Ptr<BleLinkController> lc = this->GetBBManager()->GetLinkController();
+       Ptr<BleLinkController> peerLc = 
+         m_peer->GetBBManager()->GetLinkController();
+       std::vector<BleLinkController::ChannelQuality> quality = 
+         lc->GetChannelQuality (this);
+       std::vector<BleLinkController::ChannelQuality> peerQuality = 
+         peerLc->GetChannelQuality (m_peer);
+       lc->ResetChannelQuality (this);
+       peerLc->ResetChannelQuality (m_peer);
+
+       Time now = Simulator::Now();
+       std::vector<uint8_t> channels;
+       for (auto ch : m_afhChannels)
+       {
+         std::map<uint8_t, Time>::iterator excluded = 
+           m_excludedChannels.find (ch);
+         if (excluded != m_excludedChannels.end())
+         {
+           if (excluded->second > now)
+           {
+             continue;
+           }
+           // Give it another chance
+           m_excludedChannels.erase (excluded);
+         }
+         if (ch < quality.size())
+         {
+           uint32_t errors = quality[ch].crcErrors + peerQuality[ch].crcErrors;
+           uint32_t total = errors + quality[ch].received 
+             + peerQuality[ch].received;
+           if (total >= m_afhMinSamples 
+               && errors > m_afhErrorThreshold * total)
+           {
+             NS_LOG_INFO (this << " Channel " << int(ch) << " is bad: " 
+                 << errors << " CRC errors in " << total << " receptions");
+             m_excludedChannels[ch] = now + m_afhHoldTime;
+             continue;
+           }
+         }
+         channels.push_back (ch);
+       }
+
+       if (channels.size() < 2)
+       {
+         // A channel map needs at least two channels
+         NS_LOG_WARN (this << " Too few good channels left, "
+             "using all channels of the link again");
+         m_excludedChannels.clear ();
+         channels = m_afhChannels;
+       }
+       if (channels != m_remappingTable)
+       {
+         // The master announces the new map for an instant at least six
+         // connection events ahead, so the slave has time to receive it.
+         UpdateChannelMap (channels, m_connEventCounter + 6);
+       }
+     }
+
+   void
+     BleLinkManager::UpdateChannelMap (std::vector<uint8_t> channels, 
+         uint16_t instant)
+     {
+       NS_LOG_FUNCTION (this << instant);
+       uint64_t mask = 0;
+       for (auto ch : channels)
+       {
+         mask |= uint64_t (1) << ch;
+       }
+       m_pendingChannelMap = channels;
+       m_channelMapInstant = instant;
+       m_channelMapPending = true;
+       m_peer->m_pendingChannelMap = channels;
+       m_peer->m_channelMapInstant = instant;
+       m_peer->m_channelMapPending = true;
+       m_channelMapUpdateTrace (mask, instant);
+     }
+
+   void
+     BleLinkManager::UpdatePhy (BlePhy::PhyMode mode)
+     {
+       NS_LOG_FUNCTION (this << mode);
+       if (m_peer == 0)
+       {
+         m_phyMode = mode;
+         return;
+       }
+       // The master runs the procedure, whichever end asked for it
+       Ptr<BleLinkManager> master = m_peer;
+       if (expectedRole == MASTER_ROLE)
+       {
+         master = this;
+       }
+       // As for a channel map update, the instant leaves the slave six
+       // connection events to receive the LL_PHY_UPDATE_IND
+       uint16_t instant = master->m_connEventCounter + 6;
+       master->m_pendingPhyMode = mode;
+       master->m_phyUpdateInstant = instant;
+       master->m_phyUpdatePending = true;
+       master->m_peer->m_pendingPhyMode = mode;
+       master->m_peer->m_phyUpdateInstant = instant;
+       master->m_peer->m_phyUpdatePending = true;
+       master->m_phyUpdateTrace (mode, instant);
+     }
+
+   BlePhy::PhyMode
+     BleLinkManager::GetPhyMode (void)
+     {
+       return m_phyMode;
+     }
+
+   void
+     BleLinkManager::ChoosePhy ()
+     {
+       NS_LOG_FUNCTION (this);
+       if (m_peer == 0)
+       {
+         // The link is gone
+         return;
+       }
+       m_phyEvent = Simulator::Schedule (m_phyUpdateInterval,
+           &BleLinkManager::ChoosePhy, this);
+       uint32_t received = m_rxGood + m_rxFailed 
+         + m_peer->m_rxGood + m_peer->m_rxFailed;
+       if (m_phyUpdatePending || received == 0)
+       {
+         return;
+       }
+       // Too many failed receptions rule out the current mode and the
+       // faster ones, whatever the SNR
+       double per = double (m_rxFailed + m_peer->m_rxFailed) / received;
+       bool failing = per > m_phyMaxPer;
+       m_rxGood = m_rxFailed = 0;
+       m_peer->m_rxGood = m_peer->m_rxFailed = 0;
+       if (! (failing || m_rxSnrValid || m_peer->m_rxSnrValid))
+       {
+         return;
+       }
+       // The SNR before the gain of the mode, so the same in every mode.
+       // The worst direction decides. Without a sample, only the failed
+       // receptions do.
+       double snrDb = std::numeric_limits<double>::infinity();
+       if (m_rxSnrValid)
+       {
+         snrDb = m_rxSnrDb;
+       }
+       if (m_peer->m_rxSnrValid)
+       {
+         snrDb = std::min (snrDb, m_peer->m_rxSnrDb);
+       }
+
+       // Fastest first
+       const BlePhy::PhyMode modes[] = {BlePhy::LE_2M, BlePhy::LE_1M, 
+         BlePhy::LE_CODED_S2, BlePhy::LE_CODED_S8};
+       Ptr<BlePhy> phy = this->GetBBManager()->GetPhy();
+       BlePhy::PhyMode chosen = BlePhy::LE_CODED_S8;
+       bool faster = true;
+       for (auto mode : modes)
+       {
+         if (mode == m_phyMode)
+         {
+           faster = false;
+         }
+         if (failing && (faster || mode == m_phyMode))
+         {
+           continue;
+         }
+         double needed = m_phyTargetSnr + (faster ? m_phySnrHysteresis : 0);
+         if (snrDb + phy->GetGainDb (mode) >= needed)
+         {
+           chosen = mode;
+           break;
+         }
+       }
+       if (chosen != m_phyMode)
+       {
+         NS_LOG_INFO (this << " SNR " << snrDb << " dB, moving from PHY " 
+             "mode " << m_phyMode << " to " << chosen);
+         UpdatePhy (chosen);
+       }
+     }
+
+   // Reverses the bits of both bytes of a 16 bit value
+   static uint16_t
+     Permute (uint16_t v)
+     {
+       uint16_t r = 0;
+       for (uint8_t i = 0; i < 8; i++)
+       {
+         r |= ((v >> i) & 0x0101) << (7 - i);
+       }
+       return r;
+     }
+
+   uint8_t
+     BleLinkManager::SelectChannelCsa2 (uint16_t counter)
+     {
+       // Pseudo random number from the event counter, in three rounds 
+       // of permutation and multiply-add-modulo
+       uint16_t prn = counter ^ m_channelIdentifier;
+       for (uint8_t round = 0; round < 3; round++)
+       {
+         prn = 17 * Permute (prn) + m_channelIdentifier;
+       }
+       prn ^= m_channelIdentifier;
+
+       uint8_t unmappedChannelIndex = prn % 37;
+       if (IsUsedChannel (unmappedChannelIndex))
+       {
+         return unmappedChannelIndex;
+       }
+       NS_ASSERT (m_remappingTable.size() != 0);
+       uint32_t remappingIndex = (uint32_t (m_remappingTable.size()) * prn) >> 16;
+       return m_remappingTable[remappingIndex];
+     }
+
+   void
+     BleLinkManager::ManageChannelSelection ()
+     {
+       NS_LOG_FUNCTION (this);
+       // A new channel map is used from its instant on. Skipped idle 
+       // events may have moved the counter past it.
+       if (m_channelMapPending 
+           && uint16_t (m_connEventCounter - m_channelMapInstant) < 0x8000)
+       {
+         NS_LOG_INFO (this << " New channel map with " 
+             << m_pendingChannelMap.size() << " channels");
+         SetUsedChannels (m_pendingChannelMap);
+         m_channelMapPending = false;
+       }
+       if (m_phyUpdatePending 
+           && uint16_t (m_connEventCounter - m_phyUpdateInstant) < 0x8000)
+       {
+         NS_LOG_INFO (this << " New PHY mode " << m_pendingPhyMode);
+         m_phyMode = m_pendingPhyMode;
+         m_phyUpdatePending = false;
+         // What was received in the old mode does not hold in the new one
+         m_rxSnrValid = false;
+         m_rxGood = 0;
+         m_rxFailed = 0;
+       }
+       if (m_channelSelection == CSA_2)
+       {
+         m_dataChannelIndex = SelectChannelCsa2 (m_connEventCounter);
        }
        else
        {
-         NS_ASSERT (m_usedChannels.size() != 0);
-         uint8_t remappingIndex = m_unmappedChannelIndex % m_usedChannels.size();
-         // Find corresponding channelIndex (m_dataChannelIndex)
-         m_dataChannelIndex = m_usedChannels.at(remappingIndex);
+         m_dataChannelIndex = SelectChannelCsa1 ();
        }
-       m_lastUnmappedChannelIndex = m_unmappedChannelIndex;
+       m_connEventCounter++;
       
        // Make sure PHY listens / sends on this channel
        this->GetBBManager()->GetPhy()->SetChannel(
            this->GetBBManager()->GetLinkController()->
            GetChannelBasedOnChannelIndex (m_dataChannelIndex));
        this->GetBBManager()->GetPhy()->SetChannelIndex(m_dataChannelIndex);
+       this->GetBBManager()->GetPhy()->SetPhyMode(m_phyMode);
        NS_LOG_INFO (this << " Current Channel Index is : " 
            << int(m_dataChannelIndex) );
      }
@@ -25,6 +25,7 @@
 // Includes
 #include <ns3/callback.h>
 #include <ns3/traced-callback.h>
+#include <ns3/traced-value.h>
 #include <ns3/object.h>
 #include <ns3/pointer.h>
 #include <ns3/ptr.h>
@@ -34,15 +35,19 @@
 #include <ns3/packet.h>
 #include <ns3/simulator.h>
 #include <ns3/multi-model-spectrum-channel.h>
+#include <ns3/ble-conn-event-scheduler.h>
+#include <ns3/ble-phy.h>
+#include <ns3/ble-mac-header.h>
+#include <map>
 
 namespace ns3 {
 
   // Classes
-  template <typename Item> class DropTailQueue;
   class BleBBManager;
   class BleLinkController;
   class BleNetDevice;
-  class QueueItem;
+  class BleSpectrumChannel;
+  class BleLinkQueue;
 /** 
  * \ingroup ble
  * \brief Implementation for the Link Manager of the BLE protocol
@@ -69,6 +74,13 @@ namespace ns3 {
         CONNECTIONLESS, CONNECTED
       };
 
+      // Channel selection algorithm #1 (hop increment) or 
+      // #2 (event counter based, from Bluetooth 5)
+      enum ChannelSelectionAlgorithm
+      {
+        CSA_1, CSA_2
+      };
+
       BleLinkManager ();
       ~BleLinkManager ();
 
@@ -147,10 +159,15 @@ namespace ns3 {
       /*
        * Put packet in the queue / buffer, so it can be transmitted
        */
-      Ptr<DropTailQueue<QueueItem>> GetQueue (void);
+      Ptr<BleLinkQueue> GetQueue (void) const;
 
       void SetCurrentPacket (Ptr<Packet> packet);
       Ptr<Packet> GetCurrentPacket (void);
+      /*
+       * Header of the current packet as it goes on air. NESN, SN and MD
+       * are only updated here, not in the header bytes of the packet.
+       */
+      const BleMacHeader &GetCurrentHeader (void) const;
 
       void StartTransmitWindow (void);
       void EndTransmitWindow (void);
@@ -179,6 +196,22 @@ namespace ns3 {
       void SetMyLastMD(bool md); // The last md bit that I have send to peer.
       bool GetMyLastMD ();
 
+      /*
+       * A new PDU was received from the peer. Whether it or the PDU it
+       * answers carried data or a set MD bit is all the ends of a 
+       * subrated link know about each other's traffic.
+       */
+      void NotifyExchange (const BleMacHeader &received);
+
+      /*
+       * A new data PDU was received from the peer, with the header it
+       * was received with. Returns the payload it completes, or 0 while
+       * more fragments are expected. With a payload, header is set to
+       * the one its first fragment was received with.
+       */
+      Ptr<const Packet> Reassemble (Ptr<const Packet> pdu, 
+          BleMacHeader &header);
+
 
       // Returns true if TX new data
       bool ManageSequenceNumberTX (void);
@@ -199,12 +232,199 @@ namespace ns3 {
 
       uint8_t GetCurrentChannelIndex ();
 
+      /*
+       * The channel selection algorithm of the link. Setting it on one 
+       * end of a point-to-point link also sets it on the other end.
+       */
+      void SetChannelSelectionAlgorithm (ChannelSelectionAlgorithm csa);
+      ChannelSelectionAlgorithm GetChannelSelectionAlgorithm (void);
+
+      /*
+       * The access address of the link, shared by all its ends. 
+       * CSA#2 derives its hop sequence from it.
+       */
+      void SetAccessAddress (uint32_t accessAddress);
+      uint32_t GetAccessAddress (void);
+
+      /*
+       * The data channel index CSA#2 gives a connection event, from the
+       * access address and the channel map in use
+       */
+      uint8_t SelectChannelCsa2 (uint16_t counter);
+
       void SetAdvSleepCounter (uint16_t cntr);
       void SetMaxAdvSleep (uint16_t max_counter);
       void SetAdvCollisionAvoidance (bool collAvoid);
 
+      /*
+       * Called by the link controller for every valid packet received
+       * over the link; restarts the supervision timer.
+       */
+      void NotifyValidPacket (void);
+      /*
+       * Called by the link controller for every packet received over the
+       * link with a CRC error.
+       */
+      void NotifyFailedPacket (void);
+
+      /*
+       * Connection subrating: outside bursts of traffic, only every 
+       * 'factor'-th connection event is used. After an event in which 
+       * either end had data, the link stays at the full rate for 
+       * 'continuation' events. Set on the master of a point-to-point link.
+       */
+      void SetSubrating (uint16_t factor, uint16_t continuation);
+
+      /*
+       * Data Length Extension: the longest LL payloads, in octets, this 
+       * end is able to send and receive (27 to 251). On a point-to-point
+       * link the ends agree on the largest lengths they both support.
+       */
+      void SetMaxDataLength (uint16_t maxTxOctets, uint16_t maxRxOctets);
+      // Negotiated lengths, or this end's own on unconnected links
+      uint16_t GetEffectiveMaxTxOctets (void);
+      uint16_t GetEffectiveMaxRxOctets (void);
+
+      /*
+       * PHY update procedure: both ends of a point-to-point link switch
+       * to 'mode' at a connection event at least six events ahead. On
+       * unconnected links the mode changes at the next event.
+       */
+      void UpdatePhy (BlePhy::PhyMode mode);
+      BlePhy::PhyMode GetPhyMode (void);
+
+      /*
+       * Returns an anchor point of the link: the start of a connection
+       * event. The other events follow every connection interval.
+       */
+      Time GetAnchor (void);
+
+      /*
+       * Move the connection events of this end of the link to start at
+       * 'anchor' and then every 'connInterval'. If the first window has
+       * not been scheduled yet, it will be at 'anchor' instead of after
+       * the transmit window offset.
+       */
+      void MoveAnchor (Time anchor, Time connInterval);
+
+      /*
+       * Called when a packet is put in the queue. Wakes up the link if
+       * its connection events are being skipped because it was idle.
+       */
+      void WakeUp (void);
+
+      /*
+       * Context the events of this end run in: the id of its node, or
+       * the current context if it has none.
+       */
+      uint32_t GetNodeContext (void);
+
+      /*
+       * TracedCallback signature for a channel map update: the new used
+       * channels, bit i set for channel index i, and the connection 
+       * event counter from which they are used.
+       */
+      typedef void (* ChannelMapUpdateCallback)(uint64_t usedChannels, 
+          uint16_t instant);
+
+      /*
+       * TracedCallback signature for the outcome of a data length 
+       * negotiation: the longest LL payloads this end sends and receives.
+       */
+      typedef void (* DataLengthCallback)(uint16_t maxTxOctets, 
+          uint16_t maxRxOctets);
+
+      /*
+       * TracedCallback signature for a PHY update: the new mode and the
+       * connection event counter from which it is used.
+       */
+      typedef void (* PhyUpdateCallback)(BlePhy::PhyMode mode, 
+          uint16_t instant);
+
+      /*
+       * TracedCallback signature for the number of PDUs this end sent
+       * and received in a connection event.
+       */
+      typedef void (* PdusPerEventCallback)(uint32_t nbPdus);
+
+      /*
+       * TracedCallback signature for the number of connection events
+       * skipped while the link was idle.
+       */
+      typedef void (* IdleEventsSkippedCallback)(uint32_t nbEvents);
+
     private:
 
+      // Adaptive frequency hopping: run by the master of a 
+      // point-to-point link every m_afhInterval
+      void ClassifyChannels (void);
+      // Switch both ends to a new channel map at connection event 'instant'
+      void UpdateChannelMap (std::vector<uint8_t> channels, uint16_t instant);
+
+      // Run by the master of a point-to-point link every 
+      // m_phyUpdateInterval: moves the link to the fastest PHY mode 
+      // that keeps the SNR both ends see above the target, or to a more
+      // robust one when too many receptions failed
+      void ChoosePhy (void);
+      // Add the SNR of the last reception to the average
+      void AddSnrSample (void);
+
+      // Agree on the data lengths with the other end of the link
+      void NegotiateDataLength (void);
+
+      // Move the end of the current connection event further if either
+      // end has more data and no anchor point is in the way. The master
+      // decides; the slave follows as long as the master polls it.
+      // Returns false if the event has to end now.
+      bool ExtendEvent (void);
+      // Earliest anchor point of the other links of a device
+      Time GetNextOtherAnchor (Ptr<BleBBManager> bbm, Time after);
+
+      // Returns true, and tears the link down, if no valid packet was
+      // received within the supervision timeout
+      bool CheckSupervision (void);
+      Time GetSupervisionTimeout (void);
+      // Stop using the link and hand it back to the BB manager
+      void TearDown (void);
+
+      // True if this end does not take part in the current connection 
+      // event because of slave latency or subrating
+      bool SkipThisEvent (void);
+      // Run by the master from what it saw on air; the same answer for 
+      // both ends of an event
+      bool SkipSubratedEvent (uint16_t counter);
+      // Advance the counter and hop sequence without using the window
+      void SkipTransmitWindow (void);
+      // True if this end has data to send or to receive
+      bool HasTraffic (void);
+
+      // Data channel index of the current connection event
+      uint8_t SelectChannelCsa1 (void);
+
+      // Schedule the windows on the BB manager's timer wheel, if it has
+      // one, and else in the simulator
+      void ScheduleWindowStart (Time delay);
+      void ScheduleWindowEnd (Time delay);
+      // Returns true if a window was pending
+      bool CancelNextWindow (void);
+
+      // True if this end has nothing to send or to answer
+      bool IsIdle (void);
+      // Returns the channel if it keeps track of idle receivers
+      Ptr<BleSpectrumChannel> GetBleChannel (void);
+      // Sequence numbers of both ends of the link
+      uint8_t GetSequenceState (void);
+      // Called by the master at the end of each window
+      void CheckIdle (void);
+      // True if every other link of the device is marked idle
+      bool IsDeviceIdle (Ptr<BleBBManager> bbm);
+      void MarkIdle (bool idle);
+      // Stop and restart the connection events of an idle link
+      void Park (void);
+      void Resume (void);
+      // Catch up with the nbEvents skipped events
+      void FastForward (uint32_t nbEvents, Time nextAnchor);
+
       // This is false as long as no transmit window has past
       // sinds last connection establishment. This value is
       // set to false by the SetLastTimeConnectionEstablished()
@@ -213,6 +433,9 @@ namespace ns3 {
 
       EventId m_nextWindow;
       EventId m_endOfCurrentWindow;
+      // Same, when the windows run from a timer wheel
+      BleConnEventScheduler::TimerId m_nextWindowTimer;
+      BleConnEventScheduler::TimerId m_endOfCurrentWindowTimer;
 
       State currentState;
       Role expectedRole;
@@ -222,6 +445,10 @@ namespace ns3 {
 
       Time m_lastTimeConnectionEstablished;
       Time m_lastTransmitWindowTime;
+      Time m_eventEnd; // end of the current connection event
+      Time m_anchor; // start of the last scheduled window
+      bool m_anchorValid; // m_anchor was set
+      bool m_anchorPlanned; // m_anchor was set by MoveAnchor
 
       // Scheduling parameters 
       Time m_connInterval;
@@ -234,10 +461,30 @@ namespace ns3 {
       Time m_transmitWindowSize;
 
       // Packet buffer
-      Ptr<DropTailQueue<QueueItem>> m_queue;
+      Ptr<BleLinkQueue> m_queue;
 
       Ptr<BleBBManager> m_bbManager;
       Ptr<Packet> m_currentPacket;
+      BleMacHeader m_currentHeader;
+      /*
+       * Empty PDU sent when there is no data, built once per link and
+       * shared by all its keep-alive transmissions; never modified.
+       */
+      Ptr<Packet> m_emptyPdu;
+      BleMacHeader m_emptyPduHeader;
+      void BuildEmptyPdu (void);
+      /*
+       * Payloads longer than the effective data length are sent in
+       * fragments of that length: the first with LLID 0b10 and a
+       * BleFragmentTag, the others with LLID 0b01. Fragment returns the
+       * first fragment and keeps the rest in m_txRemainder.
+       */
+      Ptr<Packet> Fragment (Ptr<Packet> packet, uint32_t payloadSize);
+      Ptr<Packet> m_txRemainder;
+      // Payload being reassembled, and its octets still to receive
+      Ptr<Packet> m_rxMessage;
+      BleMacHeader m_rxMessageHeader;
+      uint32_t m_rxMessageLeft;
       bool m_currentIsDummy;
 
       bool m_nextExpectedSequenceNumber;
@@ -261,7 +508,88 @@ namespace ns3 {
       uint8_t m_unmappedChannelIndex;
       uint8_t m_hopIncrement;
       uint8_t m_dataChannelIndex;
-      std::vector<uint8_t> m_usedChannels;
+      // Channel map: bit i is set if channel index i is used, and the
+      // used channel indices in ascending order for remapping
+      uint64_t m_usedChannelMask;
+      std::vector<uint8_t> m_remappingTable;
+      ChannelSelectionAlgorithm m_channelSelection;
+      uint32_t m_accessAddress;
+      uint16_t m_channelIdentifier; // CSA#2, derived from the access address
+
+      // Adaptive frequency hopping
+      Time m_afhInterval; // between two classifications, 0 if disabled
+      double m_afhErrorThreshold; // CRC error rate of a bad channel
+      uint32_t m_afhMinSamples; // receptions needed to classify a channel
+      Time m_afhHoldTime; // before a bad channel is tried again
+      EventId m_afhEvent;
+      std::vector<uint8_t> m_afhChannels; // channel map at link setup
+      std::map<uint8_t, Time> m_excludedChannels; // bad channels, until when
+      bool m_channelMapPending; // a new map waits for its instant
+      uint16_t m_channelMapInstant;
+      std::vector<uint8_t> m_pendingChannelMap;
+      TracedCallback<uint64_t, uint16_t> m_channelMapUpdateTrace;
+
+      // Fast-forward over the empty connection events of an idle link.
+      // Only the master of a point-to-point link decides.
+      bool m_idleFastForward;
+      Ptr<BleLinkManager> m_peer; // other end of a point-to-point link
+      bool m_idleMarked; // both ends are marked idle on the channel
+      uint8_t m_idleState; // sequence numbers after the last idle event
+      bool m_parked; // connection events are being skipped
+      Time m_parkedAnchor; // start of the first skipped event
+      Time m_windowTxTime; // PHY TX time at the start of the window
+      Time m_windowRxTime; // PHY RX time at the start of the window
+      Time m_idleTxTime; // TX time of this end during an idle event
+      Time m_idleRxTime; // RX time of this end during an idle event
+      TracedCallback<uint32_t> m_idleEventsSkippedTrace;
+
+      // Slave latency and connection subrating
+      uint16_t m_latencyEventsSkipped; // since the slave last listened
+      uint16_t m_subrateFactor;
+      uint16_t m_subrateContinuation;
+      uint16_t m_continuationLeft; // full rate events left after a burst
+      bool m_subrateDecided; // m_subrateSkip holds the current event
+      uint16_t m_subrateCounter; // event counter of m_subrateSkip
+      Time m_subrateTime; // start of the event of m_subrateSkip
+      bool m_subrateSkip;
+      bool m_trafficOnAir; // data or MD exchanged since the last decision
+      TracedValue<uint64_t> m_skippedEvents;
+
+      // Connection event length extension
+      Time m_maxEventLength; // 0 if events end with the transmit window
+      uint32_t m_eventPdus; // sent and received in the current event
+      Time m_extensionStart; // start of the window or extension running now
+      TracedCallback<uint32_t> m_pdusPerEventTrace;
+
+      // PHY mode of the link
+      BlePhy::PhyMode m_phyMode;
+      bool m_phyUpdatePending;
+      uint16_t m_phyUpdateInstant;
+      BlePhy::PhyMode m_pendingPhyMode;
+      Time m_phyUpdateInterval; // 0 if the mode is only set by hand
+      double m_phyTargetSnr; // dB
+      double m_phySnrHysteresis; // dB
+      double m_phyMaxPer;
+      double m_rxSnrDb; // average over the packets received in this mode
+      bool m_rxSnrValid;
+      // Receptions in this mode since the last ChoosePhy
+      uint32_t m_rxGood;
+      uint32_t m_rxFailed;
+      EventId m_phyEvent;
+      TracedCallback<BlePhy::PhyMode, uint16_t> m_phyUpdateTrace;
+
+      // Data Length Extension
+      uint16_t m_maxTxOctets;
+      uint16_t m_maxRxOctets;
+      uint16_t m_effectiveMaxTxOctets;
+      uint16_t m_effectiveMaxRxOctets;
+      TracedCallback<uint16_t, uint16_t> m_dataLengthTrace;
+
+      // Supervision of the link
+      bool m_linkLossDetection;
+      bool m_linkLost; // set when this end timed out
+      Time m_lastValidRxTime; // or the time the link was set up
+      bool m_validRxSinceSetup; // false while the link is being established
   };
 }
 #endif /* BLE_LINK_MANAGER_H */
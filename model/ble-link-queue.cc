@@ -0,0 +1,238 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ble-link-queue.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/uinteger.h>
+#include <ns3/trace-source-accessor.h>
+
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BleLinkQueue");
+
+NS_OBJECT_ENSURE_REGISTERED (BleLinkQueue);
+
+TypeId
+BleLinkQueue::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BleLinkQueue")
+    .SetParent<Object> ()
+    .AddConstructor<BleLinkQueue> ()
+    .AddAttribute ("MaxPackets",
+                   "The most packets the queue holds.",
+                   UintegerValue (100),
+                   MakeUintegerAccessor (&BleLinkQueue::SetMaxPackets,
+                                         &BleLinkQueue::GetMaxPackets),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MaxBytes",
+                   "The most bytes the queue holds, 0 for no limit.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&BleLinkQueue::SetMaxBytes,
+                                         &BleLinkQueue::GetMaxBytes),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddTraceSource ("Enqueue",
+                     "A packet entered the queue.",
+                     MakeTraceSourceAccessor (&BleLinkQueue::m_enqueueTrace),
+                     "ns3::Packet::TracedCallback")
+    .AddTraceSource ("Dequeue",
+                     "A packet left the queue to be sent.",
+                     MakeTraceSourceAccessor (&BleLinkQueue::m_dequeueTrace),
+                     "ns3::Packet::TracedCallback")
+    .AddTraceSource ("Drop",
+                     "A packet was dropped because the queue was full, "
+                     "or flushed.",
+                     MakeTraceSourceAccessor (&BleLinkQueue::m_dropTrace),
+                     "ns3::Packet::TracedCallback")
+    .AddTraceSource ("SojournTime",
+                     "Time a dequeued packet spent in the queue.",
+                     MakeTraceSourceAccessor (&BleLinkQueue::m_sojournTrace),
+                     "ns3::Time::TracedCallback")
+    ;
+  return tid;
+}
+
+BleLinkQueue::BleLinkQueue ()
+  : m_head (0),
+    m_nPackets (0),
+    m_nBytes (0),
+    m_maxPackets (100),
+    m_maxBytes (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BleLinkQueue::~BleLinkQueue ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BleLinkQueue::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_ring.clear ();
+  m_head = 0;
+  m_nPackets = 0;
+  m_nBytes = 0;
+  Object::DoDispose ();
+}
+
+bool
+BleLinkQueue::Enqueue (Ptr<Packet> packet)
+{
+  NS_LOG_FUNCTION (this << packet);
+  NS_ASSERT (packet != 0);
+  if (m_nPackets >= m_maxPackets
+      || (m_maxBytes != 0 && m_nBytes + packet->GetSize () > m_maxBytes))
+    {
+      NS_LOG_LOGIC ("Queue full, dropping " << packet);
+      m_dropTrace (packet);
+      return false;
+    }
+  if (m_nPackets == m_ring.size ())
+    {
+      Grow ();
+    }
+  Entry &entry = m_ring[(m_head + m_nPackets) % m_ring.size ()];
+  entry.packet = packet;
+  entry.enqueued = Simulator::Now ();
+  m_nPackets++;
+  m_nBytes += packet->GetSize ();
+  m_enqueueTrace (packet);
+  return true;
+}
+
+Ptr<Packet>
+BleLinkQueue::Dequeue (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_nPackets == 0)
+    {
+      return 0;
+    }
+  Entry &entry = m_ring[m_head];
+  Ptr<Packet> packet = entry.packet;
+  Time sojourn = Simulator::Now () - entry.enqueued;
+  entry.packet = 0;
+  m_head = (m_head + 1) % m_ring.size ();
+  m_nPackets--;
+  m_nBytes -= packet->GetSize ();
+  m_dequeueTrace (packet);
+  m_sojournTrace (sojourn);
+  return packet;
+}
+
+Ptr<const Packet>
+BleLinkQueue::Peek (void) const
+{
+  if (m_nPackets == 0)
+    {
+      return 0;
+    }
+  return m_ring[m_head].packet;
+}
+
+void
+BleLinkQueue::Flush (void)
+{
+  NS_LOG_FUNCTION (this);
+  while (m_nPackets > 0)
+    {
+      Entry &entry = m_ring[m_head];
+      m_dropTrace (entry.packet);
+      entry.packet = 0;
+      m_head = (m_head + 1) % m_ring.size ();
+      m_nPackets--;
+    }
+  m_head = 0;
+  m_nBytes = 0;
+}
+
+bool
+BleLinkQueue::IsEmpty (void) const
+{
+  return m_nPackets == 0;
+}
+
+uint32_t
+BleLinkQueue::GetNPackets (void) const
+{
+  return m_nPackets;
+}
+
+uint32_t
+BleLinkQueue::GetNBytes (void) const
+{
+  return m_nBytes;
+}
+
+uint32_t
+BleLinkQueue::GetCapacity (void) const
+{
+  return m_ring.size ();
+}
+
+void
+BleLinkQueue::SetMaxPackets (uint32_t maxPackets)
+{
+  NS_LOG_FUNCTION (this << maxPackets);
+  NS_ASSERT (maxPackets >= 1);
+  // Packets already in the queue stay; new ones wait until it drains
+  m_maxPackets = maxPackets;
+}
+
+uint32_t
+BleLinkQueue::GetMaxPackets (void) const
+{
+  return m_maxPackets;
+}
+
+void
+BleLinkQueue::SetMaxBytes (uint32_t maxBytes)
+{
+  NS_LOG_FUNCTION (this << maxBytes);
+  m_maxBytes = maxBytes;
+}
+
+uint32_t
+BleLinkQueue::GetMaxBytes (void) const
+{
+  return m_maxBytes;
+}
+
+void
+BleLinkQueue::Grow (void)
+{
+  uint32_t size = std::max (uint32_t (4), uint32_t (m_ring.size ()) * 2);
+  size = std::min (size, std::max (m_maxPackets, m_nPackets + 1));
+  NS_LOG_FUNCTION (this << size);
+  // Unwrap the packets to the front of the new buffer
+  std::vector<Entry> ring (size);
+  for (uint32_t i = 0; i < m_nPackets; i++)
+    {
+      ring[i] = m_ring[(m_head + i) % m_ring.size ()];
+    }
+  m_ring.swap (ring);
+  m_head = 0;
+}
+
+} // namespace ns3
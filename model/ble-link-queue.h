@@ -0,0 +1,145 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BLE_LINK_QUEUE_H
+#define BLE_LINK_QUEUE_H
+
+#include <ns3/object.h>
+#include <ns3/nstime.h>
+#include <ns3/packet.h>
+#include <ns3/traced-callback.h>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup BLE
+ *
+ * First-in first-out queue of the packets waiting to be sent on a link.
+ *
+ * Packets are kept in a ring buffer of packet pointers, without a
+ * QueueItem around each of them. The buffer starts empty and doubles
+ * when it is full, up to MaxPackets, so idle links hold no storage.
+ * MaxPackets is a limit, not an allocation: the buffer keeps room for
+ * at most twice the most packets the queue held, and at least 4. An
+ * entry takes 16 bytes, so a queue keeps at most 1600 bytes with the
+ * default of 100 packets, and links that never queued a packet none.
+ * A packet that would take the queue over MaxPackets or MaxBytes is
+ * dropped.
+ */
+class BleLinkQueue : public Object
+{
+public:
+  /**
+   * Get the type ID.
+   *
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  BleLinkQueue ();
+  virtual ~BleLinkQueue ();
+
+  /**
+   * Add a packet at the back of the queue.
+   *
+   * \param packet the packet
+   * \return false if the packet was dropped because the queue is full
+   */
+  bool Enqueue (Ptr<Packet> packet);
+
+  /**
+   * Take the packet at the front of the queue.
+   *
+   * \return the packet, or 0 if the queue is empty
+   */
+  Ptr<Packet> Dequeue (void);
+
+  /**
+   * \return the packet at the front of the queue, or 0 if it is empty
+   */
+  Ptr<const Packet> Peek (void) const;
+
+  /**
+   * Drop all packets in the queue.
+   */
+  void Flush (void);
+
+  /**
+   * \return whether the queue holds no packets
+   */
+  bool IsEmpty (void) const;
+
+  /**
+   * \return the number of packets in the queue
+   */
+  uint32_t GetNPackets (void) const;
+
+  /**
+   * \return the number of bytes in the queue
+   */
+  uint32_t GetNBytes (void) const;
+
+  /**
+   * \return the number of packets the buffer has room for
+   */
+  uint32_t GetCapacity (void) const;
+
+  /**
+   * \param maxPackets the most packets the queue holds, at least 1
+   */
+  void SetMaxPackets (uint32_t maxPackets);
+  uint32_t GetMaxPackets (void) const;
+
+  /**
+   * \param maxBytes the most bytes the queue holds, 0 for no limit
+   */
+  void SetMaxBytes (uint32_t maxBytes);
+  uint32_t GetMaxBytes (void) const;
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /// A packet and when it entered the queue
+  struct Entry
+  {
+    Ptr<Packet> packet; //!< the packet
+    Time enqueued;      //!< when it was enqueued
+  };
+
+  /// Make room for one more packet, up to m_maxPackets.
+  void Grow (void);
+
+  std::vector<Entry> m_ring; //!< the buffer, m_nPackets of it in use
+  uint32_t m_head;           //!< index of the front packet
+  uint32_t m_nPackets;       //!< packets in the queue
+  uint32_t m_nBytes;         //!< bytes in the queue
+  uint32_t m_maxPackets;     //!< packet limit
+  uint32_t m_maxBytes;       //!< byte limit, 0 for none
+
+  TracedCallback<Ptr<const Packet> > m_enqueueTrace; //!< packet enqueued
+  TracedCallback<Ptr<const Packet> > m_dequeueTrace; //!< packet dequeued
+  TracedCallback<Ptr<const Packet> > m_dropTrace;    //!< packet dropped
+  TracedCallback<Time> m_sojournTrace; //!< time spent in the queue
+};
+
+} // namespace ns3
+
+#endif /* BLE_LINK_QUEUE_H */
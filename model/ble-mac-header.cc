@@ -215,12 +215,13 @@ BleMacHeader::Serialize (Buffer::Iterator start) const
   WriteTo (i, m_src_addr);
   WriteTo (i, m_dest_addr);
   i.WriteU16 (GetProtocol());
-  i.WriteU8 (GetLLID());
+  // LL data channel PDU header: LLID, NESN, SN and MD, then the length
   i.WriteU8 (
-      (this->GetLength()&0x5 << 3) |
-      (this->GetNESN()&0x1 << 2 ) |  
-      (this->GetSN()&0x1 << 1 ) |
-      (this->GetMD()&0x1 ) );
+      (this->GetLLID() & 0x3) |
+      ((this->GetNESN() & 0x1) << 2) |  
+      ((this->GetSN() & 0x1) << 3) |
+      ((this->GetMD() & 0x1) << 4) );
+  i.WriteU8 (GetLength());
 }
 
 
@@ -234,12 +235,12 @@ BleMacHeader::Deserialize (Buffer::Iterator start)
   ReadFrom (i, m_src_addr);
   ReadFrom (i, m_dest_addr);
   SetProtocol (i.ReadU16 ());
-  SetLLID (i.ReadU8 ());
   uint8_t temp = i.ReadU8();
-  SetLength (bool((temp >> 3) & 0x5));
+  SetLLID (temp & 0x3);
   SetNESN (bool((temp >> 2) & 0x1));
-  SetSN (bool((temp >> 1) & 0x1));
-  SetMD (bool((temp) & 0x1));
+  SetSN (bool((temp >> 3) & 0x1));
+  SetMD (bool((temp >> 4) & 0x1));
+  SetLength (i.ReadU8 ());
   return i.GetDistanceFrom (start);
 }
 
@@ -88,7 +88,7 @@ private:
   bool m_sn;
   bool m_md;
   uint8_t m_llid; // this is only 2 bits
-  uint8_t m_length; // 5 bits long
+  uint8_t m_length; // 8 bits long, payload of up to 251 octets
   uint8_t m_rfu; //6 bits reserved for future use
 }; //BleMacHeader
 
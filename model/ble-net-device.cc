@@ -25,9 +25,7 @@
 
 #include "ns3/ble-phy.h"
 #include "ns3/log.h"
-#include "ns3/queue.h"
-#include "ns3/drop-tail-queue.h"
-#include "ns3/queue-item.h"
+#include "ns3/ble-link-queue.h"
 #include "ns3/simulator.h"
 #include "ns3/enum.h"
 #include "ns3/boolean.h"
@@ -74,6 +72,15 @@ namespace ns3 {
 						MakePointerAccessor (&BleNetDevice::GetPhy,
 							&BleNetDevice::SetPhy),
 						MakePointerChecker<Object> ())
+				.AddAttribute ("DirectEnqueue",
+						"Put packets to send straight into the queue of "
+						"the link to their destination, instead of "
+						"staging them in the queue of the device. Send "
+						"then returns false if that link is missing or "
+						"its queue is full.",
+						BooleanValue (true),
+						MakeBooleanAccessor (&BleNetDevice::m_directEnqueue),
+						MakeBooleanChecker ())
 				.AddTraceSource ("MacTx",
 						"Trace source indicating a packet has arrived "
 						"for transmission by this device",
@@ -126,6 +133,7 @@ namespace ns3 {
 	{
 		NS_LOG_FUNCTION (this);
 	    m_node = 0;
+    m_directEnqueue = true;
 
     Ptr<BleNetDevice> nd_pointer = Ptr<BleNetDevice>(this);
 
@@ -139,10 +147,7 @@ namespace ns3 {
     this->SetLinkController(CreateObject<BleLinkController> ());
     this->GetLinkController()->SetNetDevice(nd_pointer);
 
-    Ptr<DropTailQueue<QueueItem>> packetQueue = 
-      Create<DropTailQueue<QueueItem>> ();
-    packetQueue->SetMaxSize( QueueSize (QUEUE_SIZE_PACKETS));
-    this->SetQueue(packetQueue);
+    this->SetQueue(CreateObject<BleLinkQueue> ());
 
     //NS_LOG_INFO ("BleNetDevice constructor done");
 	}
@@ -158,7 +163,15 @@ namespace ns3 {
 			NS_LOG_FUNCTION (this);
 			m_queue = 0;
 			m_node = 0;
+			if (m_phy != 0)
+			{
+				m_phy->Dispose ();
+			}
 			m_phy = 0;
+			if (m_bbManager != 0)
+			{
+				m_bbManager->Dispose ();
+			}
 			m_rxCallback = MakeNullCallback <bool, 
                          Ptr<NetDevice>, Ptr<const Packet>, 
                          uint16_t, const Address& > ();
@@ -207,7 +220,7 @@ namespace ns3 {
 
 
 	void
-		BleNetDevice::SetQueue (Ptr<DropTailQueue<QueueItem>> q)
+		BleNetDevice::SetQueue (Ptr<BleLinkQueue> q)
 		{
 			NS_LOG_FUNCTION (this);
 			NS_LOG_FUNCTION (q);
@@ -441,6 +454,15 @@ namespace ns3 {
       header.SetDestAddr(dest16);
       header.SetProtocol(protocolNumber);
       packet->AddHeader (header);		
+      if (m_directEnqueue)
+      {
+        bool sendOk = this->GetBBManager()->EnqueuePacket (packet, dest16);
+        if (sendOk)
+          m_macTxTrace (packet);
+        else
+          m_macTxDropTrace (packet);
+        return sendOk;
+      }
       bool sendOk = true;
 			// If the device is idle, transmission starts immediately. Otherwise,
 			// the transmission will be started by NotifyTransmissionEnd
@@ -449,15 +471,13 @@ namespace ns3 {
          this->GetBBManager());
       NS_ASSERT(m_queue !=0);
       NS_ASSERT(packet !=0);
-      Ptr<QueueItem> item = Create<QueueItem> (packet);
-      NS_ASSERT(item !=0);
-      NS_LOG_INFO ("Max size of queue = " << m_queue->GetMaxSize());
-      NS_LOG_INFO ("Current size of queue = " << m_queue->GetCurrentSize());
-      NS_LOG_INFO ("Size of packet item = " << item->GetSize());
+      NS_LOG_INFO ("Max size of queue = " << m_queue->GetMaxPackets());
+      NS_LOG_INFO ("Current size of queue = " << m_queue->GetNPackets());
+      NS_LOG_INFO ("Size of packet = " << packet->GetSize());
      // std::cout << std::endl;
     //  packet->Print(std::cout);
      // std::cout << std::endl;
-      if (m_queue->Enqueue (Create<QueueItem> (packet)) == false)
+      if (m_queue->Enqueue (packet) == false)
       {
           NS_LOG_LOGIC ("Enqueueing new packet failed");
           m_macTxDropTrace (packet);
@@ -515,7 +535,7 @@ namespace ns3 {
       this->m_linkController = linkController;
     }
 
-  Ptr<DropTailQueue<QueueItem>>
+  Ptr<BleLinkQueue>
   BleNetDevice::GetQueue (void)
   {
     NS_LOG_FUNCTION_NOARGS ();
@@ -542,21 +562,27 @@ namespace ns3 {
         m_macTXWindowSkipped (this);
       }
 
+    void
+      BleNetDevice::NotifyTransmissionDrop (Ptr<const Packet> packet)
+      {
+        NS_LOG_FUNCTION (this << packet);
+        m_macTxDropTrace (packet);
+      }
+
 	void
-		BleNetDevice::NotifyReceptionEndError (Ptr<Packet> packet)
+		BleNetDevice::NotifyReceptionEndError (Ptr<const Packet> packet)
 		{
 			NS_LOG_FUNCTION (this);
             m_macRxErrorTrace (packet);
 		}
 
 	void
-		BleNetDevice::NotifyReceptionEndOk (Ptr<Packet> packet)
+		BleNetDevice::NotifyReceptionEndOk (Ptr<const Packet> packet, 
+            const BleMacHeader &header)
 		{
 			NS_LOG_FUNCTION (this << packet);
 
             NS_ASSERT(packet != 0);
-			BleMacHeader header;
-			packet->PeekHeader (header);
 			NS_LOG_LOGIC ("packet : Source --> " 
                 << header.GetSrcAddr () << " Dest --> " 
                 << header.GetDestAddr()
@@ -579,7 +605,17 @@ namespace ns3 {
 			}
 
 			NS_LOG_LOGIC ("packet type = " << packetType );
+            // Trace sinks get the header as it was received
+            Ptr<const Packet> traced = packet;
+            if (!(m_macPromiscRxTrace.IsEmpty() && m_macRxTrace.IsEmpty()
+                  && m_macRxBroadcastTrace.IsEmpty()))
+            {
+              traced = BleLinkController::GetTracedPacket (packet, header);
+            }
+            m_macPromiscRxTrace (traced);
             Ptr<NetDevice> nd_pointer = Ptr<BleNetDevice>(this);
+            // The received packet is shared with the other receivers;
+            // copy it before stripping the header.
             Ptr<Packet> packet_copy1 = packet->Copy();
             short unsigned int protocol = header.GetProtocol();
             const Address src_addr = Address(header.GetSrcAddr());
@@ -587,10 +623,10 @@ namespace ns3 {
 			NS_LOG_LOGIC ("packet size = " << packet_copy1->GetSize() );
 			BleMacHeader rmheader;
 			packet_copy1->RemoveHeader (rmheader);
-            Ptr<const Packet> packet_copy = packet_copy1->Copy();
+            Ptr<const Packet> packet_copy = packet_copy1;
             if (packetType == PACKET_BROADCAST )
             {
-			  m_macRxBroadcastTrace(packet, this);
+			  m_macRxBroadcastTrace(traced, this);
               NS_ASSERT(packet_copy != 0);
               m_rxCallback (nd_pointer, packet_copy, protocol, src_addr);
             }
@@ -609,13 +645,17 @@ namespace ns3 {
                 NS_ASSERT(header.GetSrcAddr() != temp.GetSrcAddr());
                 NS_ASSERT(header.GetDestAddr() != temp.GetSrcAddr());    
                 NS_ASSERT(packet != 0);
-				m_macRxTrace(packet);
+				m_macRxTrace(traced);
                 NS_ASSERT(packet_copy != 0);
 				m_rxCallback (nd_pointer, packet_copy, protocol, src_addr);
 				// m_promiscRxCallback (nd_pointer, packet_copy, 
                     // protocol, src_addr, dest_addr, packetType);
-				Simulator::ScheduleNow(&BleBBManager::TryAgain, 
-                    this->GetBBManager());
+				if (!m_directEnqueue)
+				{
+					// Packets sent meanwhile may wait in the device queue
+					Simulator::ScheduleWithContext(GetNode()->GetId(), Seconds(0),
+                        &BleBBManager::TryAgain, this->GetBBManager());
+				}
 			}
 			else // Received packet is not for me
 			{
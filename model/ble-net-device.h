@@ -46,11 +46,10 @@
 
 namespace ns3 {
 
-template <typename Item> class DropTailQueue;
 class BlePhy;
 class SpectrumChannel;
 class Channel;
-class QueueItem;
+class BleLinkQueue;
 class BleChannel;
 class SpectrumErrorModel;
 class BleBBManager;
@@ -82,7 +81,7 @@ public:
    *
    * \param queue the wanted queue structure
    */
-  virtual void SetQueue (Ptr<DropTailQueue<QueueItem>> queue);
+  virtual void SetQueue (Ptr<BleLinkQueue> queue);
 
 
   /**
@@ -101,19 +100,26 @@ public:
   /**
    * Notify the MAC that the PHY finished a reception with an error
    */
-  void NotifyReceptionEndError (Ptr<Packet> packet);
+  void NotifyReceptionEndError (Ptr<const Packet> packet);
 
   /**
    * Notify the MAC that the PHY finished a reception successfully
    *
-   * \param p the received packet
-	 * \param rssi the received signal strength of the received packet
+   * \param p the received packet, with stale header bytes
+   * \param header the header the packet was received with
    */
-  void NotifyReceptionEndOk (Ptr<Packet> p);
+  void NotifyReceptionEndOk (Ptr<const Packet> p, const BleMacHeader &header);
 
 
   void NotifyTXWindowSkipped ();
 
+  /**
+   * Notify the MAC that the link layer dropped a packet it could not send
+   *
+   * \param packet the dropped packet
+   */
+  void NotifyTransmissionDrop (Ptr<const Packet> packet);
+
   /**
    * This class doesn't talk directly with the underlying channel (a
    * dedicated PHY class is expected to do it), however the NetDevice
@@ -194,7 +200,7 @@ public:
   Mac16Address GetAddress16 (void) const;
 
  
-  Ptr<DropTailQueue<QueueItem>> GetQueue (void);
+  Ptr<BleLinkQueue> GetQueue (void);
   Ptr<BleBBManager> GetBBManager();
   void SetBBManager(Ptr<BleBBManager> bbManager);
 
@@ -206,7 +212,8 @@ public:
 
 protected:
 
-  Ptr<DropTailQueue<QueueItem>> m_queue; //!< queue for packets to send
+  Ptr<BleLinkQueue> m_queue; //!< queue for packets to send
+  bool m_directEnqueue; //!< whether packets skip m_queue
   Ptr<Node>    m_node; //!< node of this netdevice
   Mac16Address m_address; //!< address of this device
   Ipv4Address m_ip_address; //!< address of this device
@@ -22,9 +22,9 @@
 #ifndef BLE_PHY_LISTENER_H
 #define BLE_PHY_LISTENER_H
 
-namespace ns3 {
+#include <ns3/nstime.h>
 
-class Time;
+namespace ns3 {
 
 /**
  * \brief receive notifications about PHY events.
@@ -116,6 +116,19 @@ public:
    * Notify listeners that we went to switch on
    */
   virtual void NotifyOn (void) = 0;
+  /**
+   * \param txTime the time spent transmitting in each skipped event
+   * \param rxTime the time spent receiving in each skipped event
+   * \param interval the time between two skipped events, zero when the
+   *        link runs its connection events again
+   *
+   * The link layer stopped simulating the empty connection events of an
+   * idle link. Until this is called again, the radio is taken to transmit
+   * and receive for txTime and rxTime once every interval.
+   */
+  virtual void NotifyIdleEvents (Time txTime, Time rxTime, Time interval)
+  {
+  }
 };
 
 } //namespace ns3
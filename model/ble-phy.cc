@@ -24,8 +24,11 @@
 
 #include "ble-phy.h"
 #include "ble-spectrum-signal-parameters.h"
+#include "ble-interference-helper.h"
 #include <ns3/ble-net-device.h>
 #include <ns3/ble-bb-manager.h>
+#include <ns3/ble-mac-header.h>
+#include <ns3/constants.h>
 #include <ns3/object.h>
 #include <ns3/spectrum-phy.h>
 #include <ns3/net-device.h>
@@ -39,6 +42,13 @@
 #include <ns3/event-id.h>
 #include <ns3/random-variable-stream.h>
 #include <ns3/double.h>
+#include <ns3/enum.h>
+#include <ns3/boolean.h>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <map>
+#include <tuple>
 #include "/home/mihir/IoT_HOLA_Project/ns3/ns-3-dev-master/src/ble/model/ble-radio-energy-model.h"
 #include "/home/mihir/IoT_HOLA_Project/ns3/ns-3-dev-master/src/ble/model/ble-phy-listener.h"
 
@@ -55,6 +65,61 @@ namespace ns3 {
 			static TypeId tid = TypeId ("ns3::BlePhy")
 				.SetParent<Object> ()
 				.AddConstructor<BlePhy> ()
+				.AddAttribute ("BitErrorSampling",
+				               "How the number of bit errors is drawn from "
+				               "the bit error rate.",
+				               EnumValue (BlePhy::BINOMIAL_SAMPLING),
+				               MakeEnumAccessor (&BlePhy::SetBitErrorSampling,
+				                                 &BlePhy::GetBitErrorSampling),
+				               MakeEnumChecker (BlePhy::PER_BIT_SAMPLING, "PerBit",
+				                                BlePhy::BINOMIAL_SAMPLING, "Binomial"))
+				.AddAttribute ("SyncDuration",
+				               "Time needed to synchronise to a signal: the "
+				               "preamble and access address, in the LE 1M "
+				               "mode.",
+				               TimeValue (MicroSeconds (40)),
+				               MakeTimeAccessor (&BlePhy::m_syncDuration),
+				               MakeTimeChecker ())
+				.AddAttribute ("CoChannelRejection",
+				               "Power in dB a signal needs above a co-channel "
+				               "interferer to survive it.",
+				               DoubleValue (11.0),
+				               MakeDoubleAccessor (&BlePhy::m_coChannelRejection),
+				               MakeDoubleChecker<double> ())
+				.AddAttribute ("AdjacentChannelRejection",
+				               "Power in dB a signal needs above an interferer "
+				               "one channel away to survive it.",
+				               DoubleValue (-17.0),
+				               MakeDoubleAccessor (&BlePhy::m_adjacentChannelRejection),
+				               MakeDoubleChecker<double> ())
+				.AddAttribute ("AlternateChannelRejection",
+				               "Power in dB a signal needs above an interferer "
+				               "two or more channels away to survive it.",
+				               DoubleValue (-27.0),
+				               MakeDoubleAccessor (&BlePhy::m_alternateChannelRejection),
+				               MakeDoubleChecker<double> ())
+				.AddAttribute ("LateCapture",
+				               "Whether a signal that arrives after the receiver "
+				               "synchronised to another one takes over when it "
+				               "is CoChannelRejection stronger. Without it, the "
+				               "receiver stays with the first signal and a later "
+				               "one only adds interference.",
+				               BooleanValue (true),
+				               MakeBooleanAccessor (&BlePhy::m_lateCapture),
+				               MakeBooleanChecker ())
+				.AddAttribute ("CodingGain",
+				               "Gain in dB of the convolutional code of the "
+				               "LE Coded modes, on top of their energy per "
+				               "bit.",
+				               DoubleValue (2.0),
+				               MakeDoubleAccessor (&BlePhy::m_codingGain),
+				               MakeDoubleChecker<double> ())
+				.AddAttribute ("Encryption",
+				               "Whether PDUs with a payload carry a MIC, "
+				               "which adds to their airtime.",
+				               BooleanValue (false),
+				               MakeBooleanAccessor (&BlePhy::m_encryption),
+				               MakeBooleanChecker ())
 				;
 			return tid;
 		}
@@ -67,24 +132,39 @@ namespace ns3 {
 		m_temperature = 273;
 		m_bandWidth = BANDWIDTH; // 100;
 		m_antenna = 0;
-		m_bitrate = 1000000 * 4; 
-                // times 4 to allow for larger packets 
-                // (necessary for ipv4 routing protocols)  
+		m_phyMode = LE_1M;
+		m_codingGain = 2.0;
+		m_encryption = false;
+		m_lastRxSnr = 0;
 		m_mobility = 0;
 		m_channelIndex = 20;
 		m_receiver = false;
 		m_channel = 0;
 		m_netDevice = 0;
-		m_random=CreateObject<UniformRandomVariable> ();
 		m_channelSelector=CreateObject<UniformRandomVariable> ();
-		m_random->SetAttribute ("Min",DoubleValue(0.0));
-		m_random->SetAttribute ("Max",DoubleValue(1.0));
 		m_equivalentNoiseTemperature = 293;
 		m_power = 0.010; 
                 // BLE specifications: min output power: 0.01 mW, max 10 mW
-		m_errorModel =Create<BleErrorModel> (); 
+		m_errorModel =CreateObject<BleErrorModel> (); 
+		SetBitErrorSampling (BINOMIAL_SAMPLING);
 		InitTxPowerSpectralDensity (m_channelIndex,m_power); //0.001);
-		m_receivingPower = Create<SpectrumValue> (m_txPsd->GetSpectrumModel ());
+		m_interference = CreateObject<BleInterferenceHelper> ();
+		m_syncDuration = MicroSeconds (40);
+		m_coChannelRejection = 11.0;
+		m_adjacentChannelRejection = -17.0;
+		m_alternateChannelRejection = -27.0;
+		m_lateCapture = true;
+	}
+
+	void
+	BlePhy::DoDispose (void)
+	{
+		NS_LOG_FUNCTION (this);
+		// The parameters of the last transmission refer to this PHY
+		m_txParams = 0;
+		m_params.clear ();
+		m_synced = 0;
+		SpectrumPhy::DoDispose ();
 	}
 
 	BlePhy::~BlePhy ()
@@ -93,6 +173,8 @@ namespace ns3 {
 		m_netDevice = 0;
 		m_mobility = 0;
 		m_channel = 0;
+		m_bleChannel = 0;
+		m_synced = 0;
 		m_antenna = 0;
 		m_txPsd = 0;
 		m_BleRadioEnergyModel = 0;
@@ -108,6 +190,7 @@ namespace ns3 {
 BlePhy::NotifyTxStart (Time duration, double txPowerDbm)
 {
   NS_LOG_FUNCTION (this);
+  m_totalTxTime += duration;
   for (Listeners::const_iterator i = m_listeners.begin (); i != m_listeners.end (); i++)
     {
       (*i)->NotifyTxStart (duration, txPowerDbm);
@@ -118,6 +201,7 @@ void
 BlePhy::NotifyRxStart (Time duration)
 {
   NS_LOG_FUNCTION (this);
+  m_totalRxTime += duration;
   for (Listeners::const_iterator i = m_listeners.begin (); i != m_listeners.end (); i++)
     {
       (*i)->NotifyRxStart (duration);
@@ -204,6 +288,168 @@ BlePhy::NotifyOn (void)
     }
 }
 
+void
+BlePhy::NotifyIdleEvents (Time txTime, Time rxTime, Time interval)
+{
+  NS_LOG_FUNCTION (this << txTime << rxTime << interval);
+  for (Listeners::const_iterator i = m_listeners.begin (); i != m_listeners.end (); i++)
+    {
+      (*i)->NotifyIdleEvents (txTime, rxTime, interval);
+    }
+}
+
+void
+BlePhy::SetPhyMode (PhyMode mode)
+{
+  NS_LOG_FUNCTION (this << mode);
+  m_phyMode = mode;
+}
+
+BlePhy::PhyMode
+BlePhy::GetPhyMode (void) const
+{
+  return m_phyMode;
+}
+
+double
+BlePhy::GetBitrate (PhyMode mode)
+{
+  switch (mode)
+  {
+    case LE_2M:
+      return 2000000;
+    case LE_CODED_S2:
+      return 500000;
+    case LE_CODED_S8:
+      return 125000;
+    default:
+      return 1000000;
+  }
+}
+
+double
+BlePhy::GetGainDb (PhyMode mode) const
+{
+  // Energy per bit relative to LE 1M, in dB
+  switch (mode)
+  {
+    case LE_2M:
+      return 10 * std::log10 (0.5);
+    case LE_CODED_S2:
+      return 10 * std::log10 (2.0) + m_codingGain;
+    case LE_CODED_S8:
+      return 10 * std::log10 (8.0) + m_codingGain;
+    default:
+      return 0;
+  }
+}
+
+Time
+BlePhy::GetSyncDuration (PhyMode mode) const
+{
+  switch (mode)
+  {
+    case LE_2M:
+      // 2 octet preamble and access address at 2 Mb/s
+      return MicroSeconds (24);
+    case LE_CODED_S2:
+    case LE_CODED_S8:
+      // 80 us preamble, access address coded with S=8
+      return MicroSeconds (80 + 256);
+    default:
+      return m_syncDuration;
+  }
+}
+
+Time
+BlePhy::GetAirtime (uint32_t payloadSize, PhyMode mode) const
+{
+  uint32_t octets = BLE_LL_HEADER_SIZE + payloadSize + BLE_CRC_SIZE;
+  if (m_encryption && payloadSize > 0)
+  {
+    octets += BLE_MIC_SIZE;
+  }
+  if (mode == LE_CODED_S2 || mode == LE_CODED_S8)
+  {
+    // Preamble, access address, coding indicator and TERM1 are always
+    // coded with S=8; the PDU and its 3 bit TERM2 with S=2 or S=8.
+    uint32_t s = (mode == LE_CODED_S2) ? 2 : 8;
+    return MicroSeconds (80 + 256 + 16 + 24 + (octets*8 + 3)*s);
+  }
+  uint32_t preamble = (mode == LE_2M) ? 2 : BLE_PREAMBLE_SIZE;
+  octets += preamble + BLE_ACCESS_ADDRESS_SIZE;
+  return Seconds (octets*8/GetBitrate (mode));
+}
+
+Time
+BlePhy::GetAirtime (uint32_t payloadSize) const
+{
+  return GetAirtime (payloadSize, m_phyMode);
+}
+
+double
+BlePhy::GetLastRxSnr (void) const
+{
+  return m_lastRxSnr;
+}
+
+const BleMacHeader &
+BlePhy::GetLastRxHeader (void) const
+{
+  return m_lastRxHeader;
+}
+
+Time
+BlePhy::GetTotalTxTime (void) const
+{
+  return m_totalTxTime;
+}
+
+Time
+BlePhy::GetTotalRxTime (void) const
+{
+  return m_totalRxTime;
+}
+
+	void
+	BlePhy::SetBitErrorSampling (BitErrorSampling sampling)
+	{
+		NS_LOG_FUNCTION (this << sampling);
+		m_bitErrorSampling = sampling;
+		switch (sampling)
+		{
+			case PER_BIT_SAMPLING :
+				m_bitErrorSampler = CreateObject<BlePerBitErrorSampler> ();
+				break;
+			case BINOMIAL_SAMPLING :
+				m_bitErrorSampler = CreateObject<BleBinomialBitErrorSampler> ();
+				break;
+			default :
+				NS_FATAL_ERROR ("Unknown bit error sampling method");
+				break;
+		}
+	}
+
+	BlePhy::BitErrorSampling
+	BlePhy::GetBitErrorSampling (void) const
+	{
+		return m_bitErrorSampling;
+	}
+
+	void
+	BlePhy::SetBitErrorSampler (Ptr<BleBitErrorSampler> sampler)
+	{
+		NS_LOG_FUNCTION (this << sampler);
+		NS_ASSERT (sampler != 0);
+		m_bitErrorSampler = sampler;
+	}
+
+	Ptr<BleBitErrorSampler>
+	BlePhy::GetBitErrorSampler (void) const
+	{
+		return m_bitErrorSampler;
+	}
+
 	void BlePhy::ResumeFromOff(void)
 	{
 		return;
@@ -258,8 +504,19 @@ BlePhy::NotifyOn (void)
 		BlePhy::SetChannel (Ptr<SpectrumChannel> c)
 		{
 			NS_LOG_FUNCTION (this);
+			if (c == m_channel)
+			{
+				return;
+			}
+			// Stop listening on the old channel, or it keeps delivering
+			// every transmission to this phy.
+			if (m_bleChannel != 0)
+			{
+				m_bleChannel->RemoveRx (this);
+			}
 			c->AddRx(this);
 			m_channel = c;
+			m_bleChannel = DynamicCast<BleSpectrumChannel> (c);
 		}
 
     Ptr<SpectrumChannel>
@@ -268,31 +525,60 @@ BlePhy::NotifyOn (void)
           return m_channel;
         }
 
-	void
-		BlePhy::InitTxPowerSpectralDensity (uint8_t channeloffset, double power)
+	Ptr<const SpectrumModel>
+		BlePhy::GetBleSpectrumModel (void)
 		{
-			NS_LOG_FUNCTION (this);
-			Bands bands;
-			for (int i= 0; i < NB_BANDS+6;i++){ //0 to 40
-				BandInfo bi;
-                bi.fc = 2402e6+(i-3)*BANDWIDTH;
-				bi.fl = bi.fc-BANDWIDTH/2;
-				bi.fh = bi.fc+BANDWIDTH/2;
-				bands.push_back (bi);
+			static Ptr<const SpectrumModel> sm;
+			if (sm == 0)
+			{
+				Bands bands;
+				for (int i= 0; i < NB_BANDS+6;i++){ //0 to 40
+					BandInfo bi;
+	                bi.fc = 2402e6+(i-3)*BANDWIDTH;
+					bi.fl = bi.fc-BANDWIDTH/2;
+					bi.fh = bi.fc+BANDWIDTH/2;
+					bands.push_back (bi);
+				}
+				sm = Create<SpectrumModel> (bands);
+			}
+			return sm;
+		}
+
+	Ptr<const SpectrumValue>
+		BlePhy::GetTxPsd (Ptr<const SpectrumModel> model, uint8_t channeloffset,
+                          double txPowerDensity)
+		{
+			// The masks are shared by every PHY and may still be referenced by
+			// signals in flight, so an entry is never written after it is built.
+			typedef std::tuple<uint32_t, uint8_t, double> TxPsdKey;
+			static std::map<TxPsdKey, Ptr<const SpectrumValue> > cache;
+			TxPsdKey key = std::make_tuple (model->GetUid (), channeloffset,
+                                            txPowerDensity);
+			std::map<TxPsdKey, Ptr<const SpectrumValue> >::iterator it = cache.find (key);
+			if (it != cache.end ())
+			{
+				return it->second;
 			}
-			Ptr<SpectrumModel> sm = Create<SpectrumModel> (bands);
-			m_txPsd = Create <SpectrumValue> (sm);
-			double txPowerDensity = power;
-//			channeloffset = 0;
             NS_ASSERT(channeloffset >= 0);
             NS_ASSERT(channeloffset <= 40);
-			(*m_txPsd)[channeloffset + 3] = txPowerDensity*0.7737; 
-			(*m_txPsd)[channeloffset + 2] = txPowerDensity*0.0787;
-			(*m_txPsd)[channeloffset + 1] = txPowerDensity*0.0140;
-			(*m_txPsd)[channeloffset + 0] = txPowerDensity*0.0059;
-			(*m_txPsd)[channeloffset + 4] = txPowerDensity*0.0787;
-			(*m_txPsd)[channeloffset + 5] = txPowerDensity*0.0140;
-			(*m_txPsd)[channeloffset + 6] = txPowerDensity*0.0059;
+			Ptr<SpectrumValue> psd = Create <SpectrumValue> (model);
+			(*psd)[channeloffset + 3] = txPowerDensity*0.7737; 
+			(*psd)[channeloffset + 2] = txPowerDensity*0.0787;
+			(*psd)[channeloffset + 1] = txPowerDensity*0.0140;
+			(*psd)[channeloffset + 0] = txPowerDensity*0.0059;
+			(*psd)[channeloffset + 4] = txPowerDensity*0.0787;
+			(*psd)[channeloffset + 5] = txPowerDensity*0.0140;
+			(*psd)[channeloffset + 6] = txPowerDensity*0.0059;
+			cache.insert (std::make_pair (key, psd));
+			return psd;
+		}
+
+	void
+		BlePhy::InitTxPowerSpectralDensity (uint8_t channeloffset, double power)
+		{
+			NS_LOG_FUNCTION (this);
+			m_spectrumModel = GetBleSpectrumModel ();
+			SetTxPowerSpectralDensity (channeloffset, power);
 		}
 
 	void
@@ -300,35 +586,27 @@ BlePhy::NotifyOn (void)
 		{
 			NS_LOG_FUNCTION(this << channeloffset << power);
 			double txPowerDensity = power/m_bandWidth;
-			//reset m_txPsd
-			for (uint32_t i = 0; i<NB_BANDS+6; i++) //40
-			{
-				(*m_txPsd)[i]=0;
-			}
-            NS_ASSERT(channeloffset >= 0);
-            NS_ASSERT(channeloffset <= 40);
-			(*m_txPsd)[channeloffset + 3] = txPowerDensity*0.7737; 
-			(*m_txPsd)[channeloffset + 2] = txPowerDensity*0.0787;
-			(*m_txPsd)[channeloffset + 1] = txPowerDensity*0.0140;
-			(*m_txPsd)[channeloffset + 0] = txPowerDensity*0.0059;
-			(*m_txPsd)[channeloffset + 4] = txPowerDensity*0.0787;
-			(*m_txPsd)[channeloffset + 5] = txPowerDensity*0.0140;
-			(*m_txPsd)[channeloffset + 6] = txPowerDensity*0.0059;
+			m_txPsd = GetTxPsd (m_spectrumModel, channeloffset, txPowerDensity);
+		}
+
+	Ptr<const SpectrumValue>
+		BlePhy::GetTxPowerSpectralDensity (void) const
+		{
+			return m_txPsd;
 		}
 
 	Ptr<const SpectrumModel>
 		BlePhy::GetRxSpectrumModel () const
 		{
 			NS_LOG_FUNCTION (this);
-			return m_txPsd->GetSpectrumModel ();
+			return m_spectrumModel;
 		}
 
     void
       BlePhy::SetRxSpectrumModel (Ptr<const SpectrumModel> model)
       {
-        m_txPsd = 0;
-        m_txPsd = Create <SpectrumValue> (model);
-        m_receivingPower = Create<SpectrumValue> (m_txPsd->GetSpectrumModel ());
+        m_spectrumModel = model;
+        SetTxPowerSpectralDensity (m_channelIndex, m_power);
       }
 
 	void
@@ -368,32 +646,44 @@ BlePhy::NotifyOn (void)
 		}
 
 	void
-		BlePhy::SetReceptionEndCallback (Callback<void,Ptr<Packet>, bool > callback)
+		BlePhy::SetReceptionEndCallback (Callback<void,Ptr<const Packet>, bool > callback)
 		{
 			NS_LOG_FUNCTION (this);
 			m_ReceptionEnd = callback;
 		}
 
 	bool
-		BlePhy::StartTx (Ptr<Packet> packet)
+		BlePhy::StartTx (Ptr<Packet> packet, BleMacHeader header)
 		{
 			NS_LOG_FUNCTION (this);
 			if(this->GetState() == BlePhy::State::TX)
 			{
               this->ChangeState(BlePhy::State::TX_BUSY);
-				Ptr<BleSpectrumSignalParameters> txParams = 
-                  Create<BleSpectrumSignalParameters> ();
-				txParams->duration = Seconds((packet->GetSize()-1)*8/m_bitrate);
+				// The channel hands copies to the receivers, so the
+				// parameters of the previous transmission are reused
+				// unless something still holds them
+				if (m_txParams == 0 || m_txParams->GetReferenceCount () > 1)
+				{
+					m_txParams = Create<BleSpectrumSignalParameters> ();
+				}
+				Ptr<BleSpectrumSignalParameters> txParams = m_txParams;
+				// The BleMacHeader also carries the addresses and 
+				//  protocol, which are not sent on air
+				txParams->duration = GetAirtime (packet->GetSize() 
+				    - BleMacHeader ().GetSerializedSize ());
 				txParams->packet = packet;
 				txParams->txPhy = GetObject<SpectrumPhy> ();
-                SetTxPowerSpectralDensity(m_channelIndex,m_power);
-				txParams->psd = m_txPsd;
+				// SpectrumSignalParameters only holds a mutable psd; the
+				// channel scales a copy of it for every receiver.
+				txParams->psd = ConstCast<SpectrumValue> (m_txPsd);
 				txParams->txAntenna = m_antenna;
 				txParams->SetChannel(m_channelIndex);
+				txParams->SetPhyMode(m_phyMode);
+				txParams->SetHeader(header);
                 NS_ASSERT(m_channel != 0);
 				m_channel->StartTx (txParams);
 				Simulator::Schedule(txParams->duration,
-                    &BlePhy::EndTx,this,packet->Copy());
+                    &BlePhy::EndTx,this,txParams->packet);
                 NS_LOG_INFO ("EndTx event scheduled in: " << txParams->duration);
 				NotifyTxStart(txParams->duration, m_power);
 				return true;
@@ -402,7 +692,7 @@ BlePhy::NotifyOn (void)
 		}
 
 	void 
-	BlePhy::EndTx (Ptr<Packet> packet)
+	BlePhy::EndTx (Ptr<const Packet> packet)
 	{
       NS_LOG_FUNCTION (this);
       this->ChangeState(BlePhy::State::IDLE);
@@ -421,66 +711,84 @@ BlePhy::NotifyOn (void)
 			if (this->GetState() == BlePhy::State::RX_BUSY) //m_receiver)
 			{
                 NS_LOG_INFO ("Receiving starts now");
-				//update BER
-				UpdateBer();
-				NS_LOG_FUNCTION (this);
 				// do something with params
 				Ptr<BleSpectrumSignalParameters> sfParams = 
                   DynamicCast<BleSpectrumSignalParameters> (params);
 				// add power to received power
-				Simulator::Schedule(params->duration,
-                    &BlePhy::EndNoise,this,params->psd);
-				*m_receivingPower += *params->psd;
+				m_interference->AddSignal (params->psd, params->duration);
 				//m_ReceptionStart();
 				if (sfParams != 0){
-					uint8_t channel = sfParams->GetChannel();
-					//Choose highest SNR if multiple
-					if (m_params.size()<1){
-						m_params.push_back(sfParams);
-						sfParams->SetBer(0);
-						//generate ending event
+					sfParams->SetRxStart (Simulator::Now ());
+					sfParams->SetRxPower (Integral (*params->psd));
+					sfParams->SetBer(0);
+					//generate ending event
+					if (!sfParams->GetEndRxByChannel ())
+					{
 						sfParams->SetEvent(Simulator::Schedule(
                               sfParams->duration,&BlePhy::EndRx,this,sfParams));
 					}
-					else {
-						//check if there is a collision
-						sfParams->SetBer(0);
-						sfParams->SetEvent(Simulator::Schedule(
-                              sfParams->duration,&BlePhy::EndRx,this,sfParams));  
-						for (auto &it : m_params)
+					sfParams->SetSnr(std::numeric_limits<double>::infinity ());
+					// Only signals on the channel the receiver is tuned to,
+					// in its PHY mode, can be demodulated; the others only
+					// interfere.
+					if (sfParams->GetChannel () != m_channelIndex
+                        || sfParams->GetPhyMode () != m_phyMode)
+					{
+						sfParams->SetBer(10);
+					}
+					// Synchronisation: once the preamble and access address
+					// of a signal have been received, the receiver stays
+					// with it. A later co-channel signal is dropped, unless
+					// LateCapture is set and it is strong enough to take
+					// the receiver over.
+					double newPower = sfParams->GetRxPower ();
+					bool locked = m_synced != 0 && m_synced->GetBer () < 1
+					    && Simulator::Now () >= m_synced->GetRxStart ()
+					    + GetSyncDuration (m_phyMode);
+					bool capture = false;
+					if (locked && sfParams->GetBer () < 1)
+					{
+						capture = m_lateCapture && newPower >= m_synced->GetRxPower ()
+						    * std::pow (10.0, m_coChannelRejection / 10);
+						if (!capture)
+						{
+							sfParams->SetBer(10);
+						}
+					}
+					//check for collisions: a signal is lost when it is not
+					//strong enough to reject an overlapping one. A signal
+					//the receiver stays locked to is only corrupted by a
+					//co-channel arrival that may capture it; otherwise that
+					//arrival only adds interference to its SINR.
+					bool candidate = sfParams->GetChannel () == m_channelIndex
+					    && sfParams->GetPhyMode () == m_phyMode;
+					for (auto &it : m_params)
+					{
+						double oldPower = it->GetRxPower ();
+						bool keepLock = it == m_synced && locked && candidate
+						    && !m_lateCapture;
+						if (!keepLock && oldPower < newPower * std::pow (10.0, 
+                              GetRejectionDb (it->GetChannel (), sfParams->GetChannel ()) / 10))
 						{
-							if (it->GetChannel() == channel){
-                                // Co-channel rejection:
-                                // 6 dB ==> 4.0
-                                // 11 dB ==> 12.6
-                                double ccrejection = 12.6;
-
-								//if there is a collision, 
-                                //  No problem if 6dB power difference, 
-                                //  but other is corrupted;
-								if (Integral(*it->psd)*ccrejection 
-                                    < Integral(*sfParams->psd)){
-									it->SetBer(10);
-								}
-								else{
-									//if 6dB lower power, there is no detection
-									if (Integral(*it->psd) 
-                                        > ccrejection*Integral(*sfParams->psd)){
-										sfParams->SetBer(10);
-									}
-									else
-									{
-										// in all the other cases, 
-                                        // the signal gets not detected, 
-                                        // but the other packet is corrupted.
-										sfParams->SetBer(10);
-										it->SetBer(10);
-									}
-								}
-							}
+							it->SetBer(10);
+						}
+						if (newPower < oldPower * std::pow (10.0,
+                              GetRejectionDb (sfParams->GetChannel (), it->GetChannel ()) / 10))
+						{
+							sfParams->SetBer(10);
 						}
-						m_params.push_back(sfParams);
 					}
+					if (capture)
+					{
+						NS_LOG_INFO ("Captured by a stronger signal");
+						m_synced->SetBer(10);
+					}
+					// Only a signal the receiver can sync to is still intact
+					if (sfParams->GetBer () < 1)
+					{
+						m_synced = sfParams;
+					}
+					m_params.push_back(sfParams);
 				}
 				NotifyRxStart(params->duration);
 			}
@@ -491,32 +799,34 @@ BlePhy::NotifyOn (void)
             }
 		}
 
-	void
-		BlePhy::EndNoise (Ptr<SpectrumValue> sv)
-		{
-			NS_LOG_FUNCTION(this);
-			UpdateBer();
-			*m_receivingPower -= *sv;
-		}
-
 	void 
 		BlePhy::EndRx (Ptr<BleSpectrumSignalParameters> params)
 		{
 			NS_LOG_FUNCTION(this);
             NS_LOG_INFO ("Receiving stops now");
+			// The event of this EndRx holds the parameters; forget it so
+			// they are released once the event has run.
+			params->SetEvent (EventId ());
+			m_params.erase (std::remove (m_params.begin (), m_params.end (), params),
+                            m_params.end ());
+			if (params == m_synced)
+			{
+				m_synced = 0;
+			}
 			//update BER
-			UpdateBer();
-			int temp = 0;
+			UpdateBer (params);
+			// Only receptions that are still in progress need the
+			// interference history.
+			Time earliestStart = Simulator::Now ();
 			for (auto &it : m_params)
 			{
-				if (it==params)
-				{
-					m_params.erase(m_params.begin()+temp);
-				}
-				temp++;
+				earliestStart = std::min (earliestStart, it->GetRxStart ());
 			}
+			m_interference->EraseBefore (earliestStart);
+			m_lastRxHeader = params->GetHeader();
 			//decide packet error or not
 			//if(m_random->GetValue()>=per)
+			m_lastRxSnr = params->GetSnr();
 			if(params->GetBer()<1)
 			{
 				//no packet error
@@ -531,6 +841,32 @@ BlePhy::NotifyOn (void)
             this->ChangeState(BlePhy::State::IDLE);
 		}
 
+	void
+		BlePhy::EndSignal (Ptr<BleSpectrumSignalParameters> params)
+		{
+			NS_LOG_FUNCTION (this);
+			// Only signals that arrived while receiving were accepted.
+			if (std::find (m_params.begin (), m_params.end (), params) != m_params.end ())
+			{
+				EndRx (params);
+			}
+		}
+
+   double
+     BlePhy::GetRejectionDb (uint8_t wanted, uint8_t interferer) const
+     {
+       uint8_t distance = wanted > interferer ? wanted - interferer : interferer - wanted;
+       if (distance == 0)
+       {
+         return m_coChannelRejection;
+       }
+       if (distance == 1)
+       {
+         return m_adjacentChannelRejection;
+       }
+       return m_alternateChannelRejection;
+     }
+
    BlePhy::State
      BlePhy::GetState ()
      {
@@ -581,16 +917,40 @@ BlePhy::NotifyOn (void)
      {
        NS_LOG_FUNCTION (this);
        m_bandWidth = bandwidth;
+       SetTxPowerSpectralDensity (m_channelIndex, m_power);
+     }
+
+   void
+     BlePhy::SetPower (double power)
+     {
+       NS_LOG_FUNCTION (this << power);
+       m_power = power;
+       SetTxPowerSpectralDensity (m_channelIndex, m_power);
      }
 
    void
      BlePhy::SetChannelIndex (uint8_t channelIndex)
      {
+        if (channelIndex == m_channelIndex)
+        {
+          return;
+        }
         m_channelIndex = channelIndex;
+        SetTxPowerSpectralDensity (m_channelIndex, m_power);
+        if (m_bleChannel != 0)
+        {
+          m_bleChannel->UpdateRx (this);
+        }
+     }
+
+   uint8_t
+     BlePhy::GetChannelIndex (void) const
+     {
+        return m_channelIndex;
      }
 
    bool
-    BlePhy::PrepareTX (Ptr<Packet> packet)
+    BlePhy::PrepareTX (Ptr<Packet> packet, const BleMacHeader &header)
     {
 			NS_LOG_FUNCTION(this);
 
@@ -601,7 +961,7 @@ BlePhy::NotifyOn (void)
         SetReceiverMode (false);
         // Schedule TX on event
         Simulator::Schedule(MicroSeconds(TX_PREP_TIME), 
-            &BlePhy::StartTx, this, packet);
+            &BlePhy::StartTx, this, packet, header);
         // Manage battery?
         return true;
       }
@@ -647,37 +1007,35 @@ BlePhy::NotifyOn (void)
     }
 
   void 
-		BlePhy::UpdateBer ()
+		BlePhy::UpdateBer (Ptr<BleSpectrumSignalParameters> params)
 		{
-			double timeNow = Simulator::Now().GetSeconds(); 
-			for (auto &i : m_params) {
-              uint8_t paramsChannelIndex = i->GetChannel();
-              if (m_channelIndex == paramsChannelIndex )
-              {
-				int m_bitErrors = 0;
+			uint32_t channel = params->GetChannel();
+			if (m_channelIndex != channel || params->GetBer() >= 1)
+			{
+				// Not listening on this channel, or already lost anyway
+				return;
+			}
+			double signal = (*params->psd)[channel+3];
+			std::vector<BleInterferenceHelper::Chunk> chunks;
+			m_interference->GetChunks (channel+3, signal, params->GetRxStart (),
+                                       Simulator::Now (), chunks);
+			for (auto &chunk : chunks)
+			{
 				//calculate SNR
-				Ptr<SpectrumValue> noise = m_receivingPower->Copy();
-				*noise -= *i->psd;
-				uint32_t channel = i->GetChannel();
-				double snr = 
-                  (*i->psd)[channel+3]/((*noise)[channel+3]+m_k*m_temperature);
+				double snr = signal/(chunk.interference+m_k*m_temperature);
 				//getBER
-				long double berEs = m_errorModel->GetBER (snr);
-				int bits = (timeNow - m_lastCheck)*m_bitrate / 4; 
-                // Divided by 4 to compensate for higher bitrate 
-                //  (see other remark at bitrate instantiation)
-				for ( int it = 0; it < bits; it++)
+				params->SetSnr (std::min (params->GetSnr (), snr));
+				PhyMode mode = PhyMode (params->GetPhyMode ());
+				long double berEs = m_errorModel->GetBER (snr, GetGainDb (mode));
+				int bits = chunk.duration.GetSeconds()*GetBitrate (mode); 
+				if (bits > 0 && berEs > 0)
 				{
-					if(m_random->GetValue()<berEs)
-					{
-						//calculate numbers of biterrors	
-						m_bitErrors += 1;
-					}
+					//calculate numbers of biterrors	
+					uint32_t bitErrors = 
+                      m_bitErrorSampler->GetBitErrors (bits, berEs);
+					params->SetBer(bitErrors+params->GetBer());
 				}
-				i->SetBer(m_bitErrors+i->GetBer());
-              }
 			}
-			m_lastCheck = timeNow;
 		}
 
 		void
@@ -31,7 +31,9 @@
 #include <ns3/spectrum-channel.h>
 #include <ns3/spectrum-phy.h>
 #include "ble-error-model.h"
+#include "ble-bit-error-sampler.h"
 #include "ble-spectrum-signal-parameters.h"
+#include "ble-spectrum-channel.h"
 #include <ns3/event-id.h>
 #include <ns3/random-variable-stream.h>
 namespace ns3 {
@@ -51,6 +53,7 @@ class SpectrumModel;
 class NetDevice;
 class BleRadioEnergyModel;
 class BlePhyListener;
+class BleInterferenceHelper;
 struct SpectrumSignalParameters;
 
 class BleBBManager;
@@ -67,6 +70,7 @@ class BlePhy : public SpectrumPhy
 public:
   BlePhy ();
   ~BlePhy ();
+  virtual void DoDispose (void);
 
   /**
    * State of the transceiver
@@ -81,6 +85,27 @@ public:
     OFF 
   };
 
+  /**
+   * How the number of bit errors is drawn from the BER
+   */
+  enum BitErrorSampling
+  {
+    PER_BIT_SAMPLING,   //!< one uniform draw per received bit
+    BINOMIAL_SAMPLING   //!< one binomial draw per interval of constant SNR
+  };
+
+  /**
+   * PHY modes: uncoded GFSK at 1 or 2 Mb/s, or the LE Coded PHY at
+   * 1 Msym/s with 2 or 8 symbols per bit
+   */
+  enum PhyMode
+  {
+    LE_1M,
+    LE_2M,
+    LE_CODED_S2,
+    LE_CODED_S8
+  };
+
   static TypeId GetTypeId (void);
 
   /**
@@ -139,6 +164,19 @@ public:
    void InitTxPowerSpectralDensity (uint8_t channeloffset, double power);
    void SetTxPowerSpectralDensity (uint8_t channeloffset, double power);
 
+  /**
+   * @return the power spectral density this PHY transmits with
+   */
+  Ptr<const SpectrumValue> GetTxPowerSpectralDensity (void) const;
+
+  /**
+   * Get the spectrum model shared by all BLE PHYs: the 40 BLE channels
+   * plus three guard bands on either side.
+   *
+   * @return the BLE spectrum model
+   */
+  static Ptr<const SpectrumModel> GetBleSpectrumModel (void);
+
   /**
    * get the AntennaModel used by the NetDevice for reception
    *
@@ -160,7 +198,14 @@ public:
    * @param params the parameters of the signals being received
    */
   void EndRx (Ptr<BleSpectrumSignalParameters> params);
-  void EndNoise (Ptr<SpectrumValue> sv);
+  /**
+   * End of a signal whose EndRx is left to the channel
+   * (see BleSpectrumSignalParameters::m_endRxByChannel). Calls EndRx if
+   * the signal was being received.
+   *
+   * @param params the parameters of the signal
+   */
+  void EndSignal (Ptr<BleSpectrumSignalParameters> params);
   /**
    *
    */
@@ -174,7 +219,7 @@ public:
   /**
    *
    */
-  void SetReceptionEndCallback(Callback<void,Ptr<Packet>, bool> callback);
+  void SetReceptionEndCallback(Callback<void,Ptr<const Packet>, bool> callback);
   
   /**
    *
@@ -184,14 +229,15 @@ public:
   /**
    *
    */
-  bool StartTx (Ptr<Packet> packet);
-  void EndTx (Ptr<Packet> packet);
+  bool StartTx (Ptr<Packet> packet, BleMacHeader header);
+  void EndTx (Ptr<const Packet> packet);
   /**
    *
    */
   void SetReceiverMode (bool receiver);
 
   void SetChannelIndex(uint8_t channelIndex);
+  uint8_t GetChannelIndex (void) const;
   void SetPower (double power);
   void SetBandwidth (uint32_t bandwidth);
   
@@ -199,22 +245,131 @@ public:
   void ChangeState (BlePhy::State state);
 
   // TX states
-  bool PrepareTX (Ptr<Packet> packet); // Startup transmitter
+  /**
+   * Startup transmitter
+   * \param packet the PDU, shared with the receivers
+   * \param header the link layer header of the PDU, which overrides the
+   *        header bytes in the packet
+   */
+  bool PrepareTX (Ptr<Packet> packet, const BleMacHeader &header);
   
   // RX states
   bool PrepareRX (); // Startup receiver and look for preamble
 
   bool SetIdle (); // Return to the IDLE state and turn transceiver off
 
+  /**
+   * Select one of the built-in bit error samplers.
+   *
+   * \param sampling the sampling method
+   */
+  void SetBitErrorSampling (BitErrorSampling sampling);
+  BitErrorSampling GetBitErrorSampling (void) const;
+
+  /**
+   * Use a custom bit error sampler.
+   *
+   * \param sampler the sampler that turns a BER into a number of bit errors
+   */
+  void SetBitErrorSampler (Ptr<BleBitErrorSampler> sampler);
+  Ptr<BleBitErrorSampler> GetBitErrorSampler (void) const;
+
   void SetOffMode (void);
   void ResumeFromOff (void);
+
+  /**
+   * Get the power ratio a wanted signal needs over an interferer to
+   * survive it, from the co-, adjacent- and alternate-channel rejection.
+   *
+   * \param wanted channel index of the wanted signal
+   * \param interferer channel index of the interferer
+   * \return the required ratio in dB
+   */
+  double GetRejectionDb (uint8_t wanted, uint8_t interferer) const;
   void SetBleRadioEnergyModel (const Ptr<BleRadioEnergyModel> BleRadioEnergyModel);
 
+  /**
+   * Select the PHY mode of the next transmissions and receptions.
+   * Signals sent in another mode only interfere.
+   *
+   * \param mode the PHY mode
+   */
+  void SetPhyMode (PhyMode mode);
+  PhyMode GetPhyMode (void) const;
+
+  /**
+   * \param mode a PHY mode
+   * \return the bitrate of the PDU in that mode, in b/s
+   */
+  static double GetBitrate (PhyMode mode);
+
+  /**
+   * Sensitivity of a PHY mode relative to LE 1M: the energy per bit,
+   * plus CodingGain for the coded modes.
+   *
+   * \param mode a PHY mode
+   * \return the gain in dB
+   */
+  double GetGainDb (PhyMode mode) const;
+
+  /**
+   * \param mode a PHY mode
+   * \return the time to receive the preamble and access address
+   */
+  Time GetSyncDuration (PhyMode mode) const;
+
+  /**
+   * Time on air of an LL PDU: preamble, access address, LL header,
+   * payload, MIC if encrypted and CRC, plus the coding indicator and
+   * termination fields in the coded modes.
+   *
+   * \param payloadSize length of the LL payload in octets
+   * \param mode the PHY mode
+   * \return the airtime
+   */
+  Time GetAirtime (uint32_t payloadSize, PhyMode mode) const;
+  // In the current PHY mode
+  Time GetAirtime (uint32_t payloadSize) const;
+
+  /**
+   * \return the lowest SNR, as a power ratio, during the last packet
+   *         received, with or without errors
+   */
+  double GetLastRxSnr (void) const;
+
+  /**
+   * \return the link layer header of the last packet received, valid
+   *         while the reception end callback runs
+   */
+  const BleMacHeader &GetLastRxHeader (void) const;
+
+  /**
+   * \return the time spent transmitting since the PHY was created
+   */
+  Time GetTotalTxTime (void) const;
+  /**
+   * \return the time spent receiving since the PHY was created
+   */
+  Time GetTotalRxTime (void) const;
+
+  /**
+   * Notify all listeners that the link layer skips the empty connection
+   * events of an idle link (see BlePhyListener::NotifyIdleEvents).
+   *
+   * \param txTime the time spent transmitting in each skipped event
+   * \param rxTime the time spent receiving in each skipped event
+   * \param interval the time between two skipped events, zero when the
+   *        events are simulated again
+   */
+  void NotifyIdleEvents (Time txTime, Time rxTime, Time interval);
+
 private:
  Ptr<NetDevice> m_netDevice; //upper layer
  Ptr<MobilityModel> m_mobility; //position
  Ptr<SpectrumChannel> m_channel; //channel to transmit on
- Ptr<SpectrumValue> m_txPsd; //Current transmit psd
+ Ptr<BleSpectrumChannel> m_bleChannel; //m_channel, if it sorts receivers by channel index
+ Ptr<const SpectrumValue> m_txPsd; //Current transmit psd, shared
+ Ptr<const SpectrumModel> m_spectrumModel; //model used for tx and rx
  Ptr<AntennaModel> m_antenna; //antenna to be used
  bool m_receiver; // whether or not this physical layer 
                   // is a sender or receiver 
@@ -222,28 +377,40 @@ private:
  double m_k; //boltzman
  double m_temperature; //noise temperature
  double m_bandWidth; //bandwith
- double m_bitrate; //bitrate
+ PhyMode m_phyMode; //mode of transmissions and receptions
+ double m_codingGain; //dB, gain of the FEC of the coded modes
+ bool m_encryption; //whether non-empty PDUs carry a MIC
+ double m_lastRxSnr; //lowest SNR of the last reception
+ BleMacHeader m_lastRxHeader; //header of the last reception
  double m_power; //power of transmission
  uint8_t m_channelIndex; //channel to transmit on
  double m_bitErrors[40]; //biterrors collected 
  std::vector <Ptr<BleSpectrumSignalParameters> > m_params; 
             //all transmissions that are happening at the moment
+ Ptr<BleSpectrumSignalParameters> m_synced; //signal the receiver is synchronised to
+ Ptr<BleSpectrumSignalParameters> m_txParams; //of the last transmission, reused
+ Time m_syncDuration; //preamble and access address, LE 1M
+ double m_coChannelRejection; //dB
+ double m_adjacentChannelRejection; //dB, 1 channel apart
+ double m_alternateChannelRejection; //dB, 2 or more channels apart
+ bool m_lateCapture; //whether a much stronger later signal takes over
  EventId m_events[40]; //current receiving events for sending
- double m_lastCheck; //last time check
  double m_equivalentNoiseTemperature; //noise temperature
- Ptr<SpectrumValue> m_receivingPower; //all the power at the receiving antenna
+ Ptr<BleInterferenceHelper> m_interference; //all the power at the receiving antenna
  Ptr<BleErrorModel> m_errorModel; // error model for this device
- Ptr<UniformRandomVariable> m_random; //determines whether received package 
-                                      //is lost are not
+ BitErrorSampling m_bitErrorSampling; // selected built-in sampler
+ Ptr<BleBitErrorSampler> m_bitErrorSampler; // draws the bit errors from the BER
  Ptr<UniformRandomVariable> m_channelSelector; //selects the channel
  //callbackfunctions
  Callback<void, Ptr<const Packet> > m_transmissionEnd; 
  Callback<void> m_ReceptionStart;
  Callback<void> m_ReceptionError;
- Callback<void, Ptr<Packet>, bool > m_ReceptionEnd;
+ Callback<void, Ptr<const Packet>, bool > m_ReceptionEnd;
 
  BlePhy::State m_currentState;
  Ptr<BleRadioEnergyModel> m_BleRadioEnergyModel;
+ Time m_totalTxTime; //time spent transmitting
+ Time m_totalRxTime; //time spent receiving
  
 
  /**
@@ -324,9 +491,26 @@ private:
   void CreateTxPowerSpectralDensity (uint32_t channeloffset, double power);
 
   /**
-   * Update the BER for all receiving transmissions based on latest information 
+   * Look up the transmit mask for a channel and power level. Masks are
+   * built on first use and shared by all PHYs; they must not be modified.
+   *
+   * @param model the spectrum model of the mask
+   * @param channeloffset channel index of the transmission
+   * @param txPowerDensity power spectral density in the centre band
+   *
+   * @return the shared transmit power spectral density
+   */
+  static Ptr<const SpectrumValue> GetTxPsd (Ptr<const SpectrumModel> model,
+                                            uint8_t channeloffset,
+                                            double txPowerDensity);
+
+  /**
+   * Add the bit errors of a reception that just ended, based on the
+   * interference it saw while it was in the air
+   *
+   * \param params the signal that was received
    */
-  void UpdateBer (void);
+  void UpdateBer (Ptr<BleSpectrumSignalParameters> params);
 };
 
 
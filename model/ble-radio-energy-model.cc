@@ -24,6 +24,7 @@
 #include "ns3/energy-source.h"
 #include "ble-radio-energy-model.h"
 #include "ble-tx-current-model.h"
+#include <algorithm>
 
 namespace ns3 {
 
@@ -88,6 +89,7 @@ BleRadioEnergyModel::GetTypeId (void)
 
 BleRadioEnergyModel::BleRadioEnergyModel ()
   : m_source (0),
+    m_idleEventsCurrentA (0),
     m_currentState (BlePhy::State::IDLE),
     m_lastUpdateTime (Seconds (0.0)),
     m_nPendingChangeState (0)
@@ -99,6 +101,8 @@ BleRadioEnergyModel::BleRadioEnergyModel ()
   m_listener->SetChangeStateCallback (MakeCallback (&DeviceEnergyModel::ChangeState, this));
   // set callback for updating the TX current
   m_listener->SetUpdateTxCurrentCallback (MakeCallback (&BleRadioEnergyModel::SetTxCurrentFromModel, this));
+  // set callback for the connection events skipped by idle links
+  m_listener->SetIdleEventsCallback (MakeCallback (&BleRadioEnergyModel::SetIdleEvents, this));
 }
 
 BleRadioEnergyModel::~BleRadioEnergyModel ()
@@ -267,6 +271,34 @@ BleRadioEnergyModel::SetTxCurrentFromModel (double txPowerDbm)
     }
 }
 
+void
+BleRadioEnergyModel::SetIdleEvents (Time txTime, Time rxTime, Time interval)
+{
+  NS_LOG_FUNCTION (this << txTime << rxTime << interval);
+  double idleEventsCurrentA = 0;
+  if (interval.IsStrictlyPositive ())
+    {
+      double charge = txTime.GetSeconds () * (m_txCurrentA - m_idleCurrentA)
+        + rxTime.GetSeconds () * (m_rxCurrentA - m_idleCurrentA);
+      idleEventsCurrentA = std::max (charge / interval.GetSeconds (), 0.0);
+    }
+  if (m_source == 0)
+    {
+      m_idleEventsCurrentA = idleEventsCurrentA;
+      return;
+    }
+
+  // Settle the energy used so far at the old current before changing it.
+  Time duration = Simulator::Now () - m_lastUpdateTime;
+  NS_ASSERT (duration.IsPositive ());
+  double supplyVoltage = m_source->GetSupplyVoltage ();
+  m_totalEnergyConsumption += duration.GetSeconds () * GetStateA (m_currentState) * supplyVoltage;
+  m_lastUpdateTime = Simulator::Now ();
+  m_source->UpdateEnergySource ();
+
+  m_idleEventsCurrentA = idleEventsCurrentA;
+}
+
 Time
 BleRadioEnergyModel::GetMaximumTimeInState (int state) const
 {
@@ -399,7 +431,7 @@ BleRadioEnergyModel::GetStateA (int state) const
   switch (state)
     {
     case BlePhy::State::IDLE:
-      return m_idleCurrentA;
+      return m_idleCurrentA + m_idleEventsCurrentA;
     // case BlePhy::State::CCA_BUSY:
     //   return m_ccaBusyCurrentA;
     case BlePhy::State::TX:
@@ -473,6 +505,7 @@ BleRadioEnergyModelPhyListener::BleRadioEnergyModelPhyListener ()
   NS_LOG_FUNCTION (this);
   m_changeStateCallback.Nullify ();
   m_updateTxCurrentCallback.Nullify ();
+  m_idleEventsCallback.Nullify ();
 }
 
 BleRadioEnergyModelPhyListener::~BleRadioEnergyModelPhyListener ()
@@ -496,6 +529,14 @@ BleRadioEnergyModelPhyListener::SetUpdateTxCurrentCallback (UpdateTxCurrentCallb
   m_updateTxCurrentCallback = callback;
 }
 
+void
+BleRadioEnergyModelPhyListener::SetIdleEventsCallback (IdleEventsCallback callback)
+{
+  NS_LOG_FUNCTION (this << &callback);
+  NS_ASSERT (!callback.IsNull ());
+  m_idleEventsCallback = callback;
+}
+
 void
 BleRadioEnergyModelPhyListener::NotifyRxStart (Time duration)
 {
@@ -623,6 +664,16 @@ BleRadioEnergyModelPhyListener::NotifyOn (void)
   m_changeStateCallback (BlePhy::State::IDLE);
 }
 
+void
+BleRadioEnergyModelPhyListener::NotifyIdleEvents (Time txTime, Time rxTime, Time interval)
+{
+  NS_LOG_FUNCTION (this << txTime << rxTime << interval);
+  if (!m_idleEventsCallback.IsNull ())
+    {
+      m_idleEventsCallback (txTime, rxTime, interval);
+    }
+}
+
 void
 BleRadioEnergyModelPhyListener::SwitchToIdle (void)
 {
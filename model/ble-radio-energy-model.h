@@ -47,6 +47,11 @@ public:
    */
   typedef Callback<void, double> UpdateTxCurrentCallback;
 
+  /**
+   * Callback type for accounting the connection events skipped by an idle link.
+   */
+  typedef Callback<void, Time, Time, Time> IdleEventsCallback;
+
   BleRadioEnergyModelPhyListener ();
   virtual ~BleRadioEnergyModelPhyListener ();
 
@@ -64,6 +69,13 @@ public:
    */
   void SetUpdateTxCurrentCallback (UpdateTxCurrentCallback callback);
 
+  /**
+   * \brief Sets the idle events callback.
+   *
+   * \param callback Idle events callback.
+   */
+  void SetIdleEventsCallback (IdleEventsCallback callback);
+
   /**
    * \brief Switches the BleRadioEnergyModel to RX state.
    *
@@ -138,6 +150,15 @@ public:
    */
   void NotifyOn (void) override;
 
+  /**
+   * \param txTime the time spent transmitting in each skipped event
+   * \param rxTime the time spent receiving in each skipped event
+   * \param interval the time between two skipped events
+   *
+   * Defined in ns3::BlePhyListener
+   */
+  void NotifyIdleEvents (Time txTime, Time rxTime, Time interval) override;
+
 
 private:
   /**
@@ -157,6 +178,11 @@ private:
    */
   UpdateTxCurrentCallback m_updateTxCurrentCallback;
 
+  /**
+   * Callback used to account for the connection events skipped by an idle link.
+   */
+  IdleEventsCallback m_idleEventsCallback;
+
   EventId m_switchToIdleEvent; ///< switch to idle event
 };
 
@@ -353,6 +379,20 @@ public:
    */
   void SetTxCurrentFromModel (double txPowerDbm);
 
+  /**
+   * \brief Accounts for the connection events the link layer skips while
+   *        a link is idle.
+   *
+   * The skipped events are spread evenly over time: the IDLE current is
+   * raised by the charge they would have drawn above it, divided by the
+   * interval between them.
+   *
+   * \param txTime the time spent transmitting in each skipped event
+   * \param rxTime the time spent receiving in each skipped event
+   * \param interval the time between two skipped events, zero to stop
+   */
+  void SetIdleEvents (Time txTime, Time rxTime, Time interval);
+
   /**
    * \brief Changes state of the BleRadioEnergyMode.
    *
@@ -429,6 +469,7 @@ private:
   double m_ccaBusyCurrentA; ///< CCA busy current in Amperes
   double m_switchingCurrentA; ///< switching current in Amperes
   double m_sleepCurrentA; ///< sleep current in Amperes
+  double m_idleEventsCurrentA; ///< average current of skipped connection events
   Ptr<BleTxCurrentModel> m_txCurrentModel; ///< current model
 
   /// This variable keeps track of the total energy consumed by this model in watts.
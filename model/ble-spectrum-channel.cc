@@ -0,0 +1,946 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include "ble-spectrum-channel.h"
+#include "ble-phy.h"
+#include "ble-spectrum-signal-parameters.h"
+#include <ns3/log.h>
+#include <ns3/simulator.h>
+#include <ns3/uinteger.h>
+#include <ns3/double.h>
+#include <ns3/boolean.h>
+#include <ns3/nstime.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/node.h>
+#include <ns3/net-device.h>
+#include <ns3/antenna-model.h>
+#include <ns3/angles.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <ns3/spectrum-propagation-loss-model.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BleSpectrumChannel");
+
+NS_OBJECT_ENSURE_REGISTERED (BleSpectrumChannel);
+
+/// Largest number of signal parameters kept for reuse
+static const uint32_t MAX_REUSED_PARAMS = 1024;
+/// Entries of the pool a delivery tries before it allocates
+static const uint32_t MAX_REUSE_TRIES = 4;
+
+TypeId
+BleSpectrumChannel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::BleSpectrumChannel")
+    .SetParent<SpectrumChannel> ()
+    .AddConstructor<BleSpectrumChannel> ()
+    .AddAttribute ("AdjacentChannels",
+                   "Number of neighbouring channel indices on either side "
+                   "of the transmission whose listeners also receive it. "
+                   "0 delivers a BLE transmission to co-channel listeners only.",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&BleSpectrumChannel::m_adjacentChannels),
+                   MakeUintegerChecker<uint32_t> (0, NB_BANDS - 1))
+    .AddAttribute ("SpatialIndex",
+                   "Skip receivers beyond the interference range of a transmission.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&BleSpectrumChannel::m_spatialIndex),
+                   MakeBooleanChecker ())
+    .AddAttribute ("GridCellSize",
+                   "Size in meters of the square cells receivers are sorted into.",
+                   TypeId::ATTR_GET | TypeId::ATTR_CONSTRUCT,
+                   DoubleValue (50.0),
+                   MakeDoubleAccessor (&BleSpectrumChannel::m_cellSize),
+                   MakeDoubleChecker<double> (1.0))
+    .AddAttribute ("RxSensitivity",
+                   "Received power in dBm below which a signal is not delivered "
+                   "when the interference range is derived from the loss model.",
+                   DoubleValue (-120.0),
+                   MakeDoubleAccessor (&BleSpectrumChannel::m_rxSensitivity),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("MaxInterferenceRange",
+                   "Distance in meters beyond which a transmission is not delivered. "
+                   "0 derives it from the TX power, the propagation loss model and "
+                   "RxSensitivity; set it when the loss model is not deterministic.",
+                   DoubleValue (0.0),
+                   MakeDoubleAccessor (&BleSpectrumChannel::m_maxRange),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("PathLossCache",
+                   "Remember the path loss and delay between receivers that stand "
+                   "still until one of them changes course. Disable it when the "
+                   "loss model is not deterministic.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&BleSpectrumChannel::m_pathLossCacheEnabled),
+                   MakeBooleanChecker ())
+    .AddTraceSource ("PathLossCacheHits",
+                     "Number of deliveries that used a cached path loss.",
+                     MakeTraceSourceAccessor (&BleSpectrumChannel::m_pathLossCacheHits),
+                     "ns3::TracedValueCallback::Uint64")
+    .AddTraceSource ("PathLossCacheMisses",
+                     "Number of path losses computed and stored in the cache.",
+                     MakeTraceSourceAccessor (&BleSpectrumChannel::m_pathLossCacheMisses),
+                     "ns3::TracedValueCallback::Uint64")
+    .AddAttribute ("BatchedDelivery",
+                   "Deliver a BLE transmission with one start and one end event per "
+                   "distinct propagation delay rather than with events per receiver.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&BleSpectrumChannel::m_batchedDelivery),
+                   MakeBooleanChecker ())
+    .AddAttribute ("BatchResolution",
+                   "With BatchedDelivery, round propagation delays to a multiple of "
+                   "this, so receivers at similar distances share events. The "
+                   "default of one LE 1M symbol puts every receiver within 150 m "
+                   "in one batch. 0 only groups identical delays.",
+                   TimeValue (MicroSeconds (1)),
+                   MakeTimeAccessor (&BleSpectrumChannel::m_batchResolution),
+                   MakeTimeChecker ())
+    .AddAttribute ("ReuseSignalParameters",
+                   "Copy a BLE signal for its receivers into the parameters of an "
+                   "earlier delivery that no receiver holds any more, rather than "
+                   "allocating new ones.",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&BleSpectrumChannel::m_reuseParams),
+                   MakeBooleanChecker ())
+    .AddTraceSource ("RxEvents",
+                     "Number of events scheduled to start and end receptions.",
+                     MakeTraceSourceAccessor (&BleSpectrumChannel::m_rxEvents),
+                     "ns3::TracedValueCallback::Uint64")
+    ;
+  return tid;
+}
+
+BleSpectrumChannel::BleSpectrumChannel ()
+  : m_buckets (NB_BANDS + 1),
+    m_adjacentChannels (0),
+    m_spatialIndex (true),
+    m_cellSize (50.0),
+    m_rxSensitivity (-120.0),
+    m_maxRange (0.0),
+    m_largestRange (0.0),
+    m_pathLossCacheEnabled (true),
+    m_pathLossCacheHits (0),
+    m_pathLossCacheMisses (0),
+    m_batchedDelivery (false),
+    m_batchResolution (MicroSeconds (1)),
+    m_batching (false),
+    m_rxEvents (0),
+    m_reuseParams (true),
+    m_rxParamsNext (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+BleSpectrumChannel::~BleSpectrumChannel ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+BleSpectrumChannel::DoDispose (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_buckets.clear ();
+  m_rxPositions.clear ();
+  m_mobilities.clear ();
+  m_pathLossCache.clear ();
+  m_batches.clear ();
+  m_rxParams.clear ();
+  m_idleRx.clear ();
+  m_busyCallbacks.clear ();
+  SpectrumChannel::DoDispose ();
+}
+
+uint32_t
+BleSpectrumChannel::GetBucket (Ptr<SpectrumPhy> phy) const
+{
+  Ptr<BlePhy> blePhy = DynamicCast<BlePhy> (phy);
+  if (blePhy != 0 && blePhy->GetChannelIndex () < NB_BANDS)
+    {
+      return blePhy->GetChannelIndex ();
+    }
+  return NB_BANDS;
+}
+
+BleSpectrumChannel::Cell
+BleSpectrumChannel::GetCell (const Vector &position) const
+{
+  return Cell (static_cast<int32_t> (std::floor (position.x / m_cellSize)),
+               static_cast<int32_t> (std::floor (position.y / m_cellSize)));
+}
+
+BleSpectrumChannel::RxList &
+BleSpectrumChannel::GetRxList (const RxPosition &position)
+{
+  RxBucket &bucket = m_buckets[position.bucket];
+  return position.inGrid ? bucket.cells[position.cell] : bucket.others;
+}
+
+void
+BleSpectrumChannel::Insert (Ptr<SpectrumPhy> phy)
+{
+  RxPosition position;
+  position.bucket = GetBucket (phy);
+  position.inGrid = false;
+  Ptr<MobilityModel> mobility = phy->GetMobility ();
+  if (mobility != 0)
+    {
+      Vector velocity = mobility->GetVelocity ();
+      if (velocity.x == 0 && velocity.y == 0 && velocity.z == 0)
+        {
+          position.inGrid = true;
+          position.cell = GetCell (mobility->GetPosition ());
+          // Makes sure m_largestRange covers it for GetNBusyRx.
+          Ptr<BlePhy> blePhy = DynamicCast<BlePhy> (phy);
+          if (blePhy != 0)
+            {
+              GetInterferenceRange (blePhy->GetTxPowerSpectralDensity (), mobility);
+            }
+        }
+    }
+  RxList &list = GetRxList (position);
+  position.index = list.size ();
+  list.push_back (phy);
+  m_rxPositions[phy] = position;
+}
+
+bool
+BleSpectrumChannel::Erase (Ptr<SpectrumPhy> phy)
+{
+  std::map<Ptr<SpectrumPhy>, RxPosition>::iterator it = m_rxPositions.find (phy);
+  if (it == m_rxPositions.end ())
+    {
+      return false;
+    }
+  RxPosition position = it->second;
+  m_rxPositions.erase (it);
+  RxList &list = GetRxList (position);
+  // Fill the hole with the last receiver of the list.
+  if (position.index + 1 != list.size ())
+    {
+      list[position.index] = list.back ();
+      m_rxPositions[list[position.index]].index = position.index;
+    }
+  list.pop_back ();
+  if (position.inGrid && list.empty ())
+    {
+      m_buckets[position.bucket].cells.erase (position.cell);
+    }
+  return true;
+}
+
+void
+BleSpectrumChannel::AddRx (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  if (m_rxPositions.find (phy) != m_rxPositions.end ())
+    {
+      return;
+    }
+  Insert (phy);
+  Ptr<MobilityModel> mobility = phy->GetMobility ();
+  if (mobility != 0)
+    {
+      std::map<Ptr<const MobilityModel>, WatchedMobility>::iterator it = m_mobilities.find (mobility);
+      if (it == m_mobilities.end ())
+        {
+          mobility->TraceConnectWithoutContext ("CourseChange",
+              MakeCallback (&BleSpectrumChannel::CourseChanged, this));
+          WatchedMobility watched;
+          watched.generation = 0;
+          it = m_mobilities.insert (std::make_pair (mobility, watched)).first;
+        }
+      it->second.phys.push_back (phy);
+    }
+  RunBusyCallbacks (phy);
+}
+
+void
+BleSpectrumChannel::RemoveRx (Ptr<SpectrumPhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  if (!Erase (phy))
+    {
+      return;
+    }
+  m_idleRx.erase (phy);
+  // The trace stays connected; CourseChanged ignores an empty list.
+  std::map<Ptr<const MobilityModel>, WatchedMobility>::iterator it = m_mobilities.find (phy->GetMobility ());
+  if (it != m_mobilities.end ())
+    {
+      RxList &phys = it->second.phys;
+      phys.erase (std::remove (phys.begin (), phys.end (), phy), phys.end ());
+    }
+}
+
+void
+BleSpectrumChannel::UpdateRx (Ptr<BlePhy> phy)
+{
+  NS_LOG_FUNCTION (this << phy);
+  std::map<Ptr<SpectrumPhy>, RxPosition>::iterator it = m_rxPositions.find (phy);
+  if (it == m_rxPositions.end () || it->second.bucket == GetBucket (phy))
+    {
+      return;
+    }
+  Erase (phy);
+  Insert (phy);
+}
+
+void
+BleSpectrumChannel::SetRxIdle (Ptr<SpectrumPhy> phy, bool idle)
+{
+  NS_LOG_FUNCTION (this << phy << idle);
+  if (m_rxPositions.find (phy) == m_rxPositions.end ())
+    {
+      return;
+    }
+  if (idle)
+    {
+      m_idleRx.insert (phy);
+    }
+  else if (m_idleRx.erase (phy) > 0)
+    {
+      RunBusyCallbacks (phy);
+    }
+}
+
+uint32_t
+BleSpectrumChannel::GetNBusyRx (void) const
+{
+  return m_rxPositions.size () - m_idleRx.size ();
+}
+
+uint32_t
+BleSpectrumChannel::GetNBusyRx (Ptr<SpectrumPhy> phy)
+{
+  Ptr<MobilityModel> mobility = phy->GetMobility ();
+  Ptr<BlePhy> blePhy = DynamicCast<BlePhy> (phy);
+  double range = blePhy == 0 ? -1 : GetInterferenceRange (blePhy->GetTxPowerSpectralDensity (),
+                                                          mobility);
+  if (range < 0 || m_largestRange < 0)
+    {
+      uint32_t busy = 0;
+      for (std::map<Ptr<SpectrumPhy>, RxPosition>::const_iterator it = m_rxPositions.begin ();
+           it != m_rxPositions.end (); ++it)
+        {
+          if (it->first != phy && m_idleRx.find (it->first) == m_idleRx.end ()
+              && InRange (phy, it->first))
+            {
+              busy++;
+            }
+        }
+      return busy;
+    }
+
+  // A receiver in the grid is in range if it is within the larger of the
+  // two interference ranges, which m_largestRange bounds.
+  if (m_maxRange <= 0)
+    {
+      range = std::max (range, m_largestRange);
+    }
+  Vector position = mobility->GetPosition ();
+  Cell low = GetCell (Vector (position.x - range, position.y - range, 0));
+  Cell high = GetCell (Vector (position.x + range, position.y + range, 0));
+  double nCells = (double (high.first) - low.first + 1) * (double (high.second) - low.second + 1);
+  uint32_t busy = 0;
+  for (std::vector<RxBucket>::const_iterator bucket = m_buckets.begin ();
+       bucket != m_buckets.end (); ++bucket)
+    {
+      if (bucket - m_buckets.begin () == NB_BANDS)
+        {
+          // Receivers that are not BlePhys have no range.
+          for (std::map<Cell, RxList>::const_iterator cell = bucket->cells.begin ();
+               cell != bucket->cells.end (); ++cell)
+            {
+              busy += CountBusyInRange (cell->second, phy);
+            }
+        }
+      else if (nCells < bucket->cells.size ())
+        {
+          for (int32_t x = low.first; x <= high.first; x++)
+            {
+              for (int32_t y = low.second; y <= high.second; y++)
+                {
+                  std::map<Cell, RxList>::const_iterator cell = bucket->cells.find (Cell (x, y));
+                  if (cell != bucket->cells.end ())
+                    {
+                      busy += CountBusyInRange (cell->second, phy);
+                    }
+                }
+            }
+        }
+      else
+        {
+          for (std::map<Cell, RxList>::const_iterator cell = bucket->cells.begin ();
+               cell != bucket->cells.end (); ++cell)
+            {
+              if (cell->first.first >= low.first && cell->first.first <= high.first
+                  && cell->first.second >= low.second && cell->first.second <= high.second)
+                {
+                  busy += CountBusyInRange (cell->second, phy);
+                }
+            }
+        }
+      busy += CountBusyInRange (bucket->others, phy);
+    }
+  return busy;
+}
+
+uint32_t
+BleSpectrumChannel::CountBusyInRange (const RxList &list, Ptr<SpectrumPhy> phy)
+{
+  uint32_t busy = 0;
+  for (RxList::const_iterator it = list.begin (); it != list.end (); ++it)
+    {
+      if (*it != phy && m_idleRx.find (*it) == m_idleRx.end () && InRange (phy, *it))
+        {
+          busy++;
+        }
+    }
+  return busy;
+}
+
+void
+BleSpectrumChannel::NotifyWhenBusy (const std::vector<Ptr<SpectrumPhy> > &phys,
+                                    Callback<void> callback)
+{
+  NS_LOG_FUNCTION (this);
+  m_busyCallbacks.push_back (std::make_pair (phys, callback));
+}
+
+void
+BleSpectrumChannel::RunBusyCallbacks (Ptr<SpectrumPhy> busy)
+{
+  // A callback may ask to be notified again, so the ones to run are
+  // taken out first.
+  std::vector<Callback<void> > callbacks;
+  std::vector<std::pair<RxList, Callback<void> > >::iterator it = m_busyCallbacks.begin ();
+  while (it != m_busyCallbacks.end ())
+    {
+      bool inRange = false;
+      for (RxList::const_iterator phy = it->first.begin (); phy != it->first.end () && !inRange; ++phy)
+        {
+          inRange = InRange (*phy, busy);
+        }
+      if (inRange)
+        {
+          callbacks.push_back (it->second);
+          it = m_busyCallbacks.erase (it);
+        }
+      else
+        {
+          ++it;
+        }
+    }
+  for (std::vector<Callback<void> >::iterator cb = callbacks.begin (); cb != callbacks.end (); ++cb)
+    {
+      (*cb) ();
+    }
+}
+
+bool
+BleSpectrumChannel::InRange (Ptr<SpectrumPhy> a, Ptr<SpectrumPhy> b)
+{
+  if (a == b)
+    {
+      return true;
+    }
+  Ptr<MobilityModel> aMobility = a->GetMobility ();
+  Ptr<MobilityModel> bMobility = b->GetMobility ();
+  Ptr<BlePhy> aPhy = DynamicCast<BlePhy> (a);
+  Ptr<BlePhy> bPhy = DynamicCast<BlePhy> (b);
+  if (aMobility == 0 || bMobility == 0 || aPhy == 0 || bPhy == 0)
+    {
+      return true;
+    }
+  double aRange = GetInterferenceRange (aPhy->GetTxPowerSpectralDensity (), aMobility);
+  double bRange = GetInterferenceRange (bPhy->GetTxPowerSpectralDensity (), bMobility);
+  if (aRange < 0 || bRange < 0)
+    {
+      return true;
+    }
+  return aMobility->GetDistanceFrom (bMobility) <= std::max (aRange, bRange);
+}
+
+void
+BleSpectrumChannel::CourseChanged (Ptr<const MobilityModel> mobility)
+{
+  NS_LOG_FUNCTION (this << mobility);
+  std::map<Ptr<const MobilityModel>, WatchedMobility>::iterator it = m_mobilities.find (mobility);
+  if (it == m_mobilities.end ())
+    {
+      return;
+    }
+  // Invalidates every cached path loss to and from this position.
+  it->second.generation++;
+  RxList phys = it->second.phys;
+  for (RxList::const_iterator phy = phys.begin (); phy != phys.end (); ++phy)
+    {
+      if (Erase (*phy))
+        {
+          Insert (*phy);
+        }
+    }
+  // A receiver may have come in range of idle links waiting for a busy
+  // neighbour, or brought an idle one in range of a busy receiver.
+  for (RxList::const_iterator phy = phys.begin (); phy != phys.end (); ++phy)
+    {
+      if (m_idleRx.find (*phy) == m_idleRx.end () || GetNBusyRx (*phy) > 0)
+        {
+          RunBusyCallbacks (*phy);
+        }
+    }
+}
+
+bool
+BleSpectrumChannel::GetStaticGeneration (Ptr<SpectrumPhy> phy, uint32_t &generation) const
+{
+  std::map<Ptr<SpectrumPhy>, RxPosition>::const_iterator position = m_rxPositions.find (phy);
+  if (position == m_rxPositions.end () || !position->second.inGrid)
+    {
+      return false;
+    }
+  // A receiver only enters the grid while it stands still and leaves it
+  // at its next course change, so its position is known to be fixed.
+  std::map<Ptr<const MobilityModel>, WatchedMobility>::const_iterator it = m_mobilities.find (phy->GetMobility ());
+  if (it == m_mobilities.end ())
+    {
+      return false;
+    }
+  generation = it->second.generation;
+  return true;
+}
+
+double
+BleSpectrumChannel::GetInterferenceRange (Ptr<const SpectrumValue> txPsd,
+                                          Ptr<MobilityModel> txMobility)
+{
+  if (!m_spatialIndex || txMobility == 0)
+    {
+      return -1;
+    }
+  if (m_maxRange > 0)
+    {
+      return m_maxRange;
+    }
+  double txPower = Integral (*txPsd);
+  if (m_propagationLoss == 0 || txPower <= 0)
+    {
+      return -1;
+    }
+  double txPowerDbm = 10 * std::log10 (txPower) + 30;
+  double height = txMobility->GetPosition ().z;
+  std::pair<int32_t, int32_t> key (static_cast<int32_t> (std::floor (txPowerDbm * 10 + 0.5)),
+                                   static_cast<int32_t> (std::floor (height * 10 + 0.5)));
+  std::map<std::pair<int32_t, int32_t>, double>::const_iterator it = m_ranges.find (key);
+  if (it != m_ranges.end ())
+    {
+      return it->second;
+    }
+
+  // Find the distance at which the loss model brings the signal below the
+  // sensitivity floor: double until it is out of range, then bisect.
+  Ptr<ConstantPositionMobilityModel> a = CreateObject<ConstantPositionMobilityModel> ();
+  Ptr<ConstantPositionMobilityModel> b = CreateObject<ConstantPositionMobilityModel> ();
+  a->SetPosition (Vector (0, 0, height));
+  double low = 0;
+  double high = 1;
+  double range = -1;
+  while (high < 1e7)
+    {
+      b->SetPosition (Vector (high, 0, height));
+      if (m_propagationLoss->CalcRxPower (txPowerDbm, a, b) < m_rxSensitivity)
+        {
+          break;
+        }
+      low = high;
+      high *= 2;
+    }
+  if (high < 1e7)
+    {
+      for (int i = 0; i < 30; i++)
+        {
+          double middle = (low + high) / 2;
+          b->SetPosition (Vector (middle, 0, height));
+          if (m_propagationLoss->CalcRxPower (txPowerDbm, a, b) < m_rxSensitivity)
+            {
+              high = middle;
+            }
+          else
+            {
+              low = middle;
+            }
+        }
+      range = high;
+    }
+  NS_LOG_DEBUG ("interference range of " << txPowerDbm << " dBm at height "
+                << height << ": " << range << " m");
+  m_ranges[key] = range;
+  if (range < 0 || m_largestRange < 0)
+    {
+      m_largestRange = -1;
+    }
+  else
+    {
+      m_largestRange = std::max (m_largestRange, range);
+    }
+  return range;
+}
+
+void
+BleSpectrumChannel::StartTx (Ptr<SpectrumSignalParameters> txParams)
+{
+  NS_LOG_FUNCTION (this << txParams);
+  NS_ASSERT_MSG (txParams->psd, "NULL txPsd");
+  NS_ASSERT_MSG (txParams->txPhy, "NULL txPhy");
+
+  Ptr<MobilityModel> txMobility = txParams->txPhy->GetMobility ();
+  double range = GetInterferenceRange (txParams->psd, txMobility);
+  int64_t txGeneration = -1;
+  uint32_t generation;
+  if (m_pathLossCacheEnabled && GetStaticGeneration (txParams->txPhy, generation))
+    {
+      txGeneration = generation;
+    }
+
+  // A BLE transmission only reaches the listeners on its own channel index
+  // and on the configured number of neighbours; anything else is heard by
+  // everyone.
+  uint32_t first = 0;
+  uint32_t last = NB_BANDS - 1;
+  Ptr<BleSpectrumSignalParameters> bleParams = DynamicCast<BleSpectrumSignalParameters> (txParams);
+  if (bleParams != 0 && bleParams->GetChannel () < NB_BANDS)
+    {
+      uint32_t channel = bleParams->GetChannel ();
+      first = channel > m_adjacentChannels ? channel - m_adjacentChannels : 0;
+      last = std::min<uint32_t> (channel + m_adjacentChannels, NB_BANDS - 1);
+    }
+
+  m_batching = m_batchedDelivery && bleParams != 0;
+  for (uint32_t b = first; b <= last; b++)
+    {
+      DeliverToBucket (m_buckets[b], txParams, txMobility, txGeneration, range);
+    }
+  DeliverToBucket (m_buckets[NB_BANDS], txParams, txMobility, txGeneration, range);
+
+  if (m_batching)
+    {
+      for (std::map<Time, Ptr<RxBatch> >::const_iterator it = m_batches.begin ();
+           it != m_batches.end (); ++it)
+        {
+          Simulator::Schedule (it->first, &BleSpectrumChannel::StartRxBatch, this, it->second);
+          Simulator::Schedule (it->first + txParams->duration,
+                               &BleSpectrumChannel::EndRxBatch, this, it->second);
+          m_rxEvents += 2;
+        }
+      m_batches.clear ();
+      m_batching = false;
+    }
+}
+
+void
+BleSpectrumChannel::DeliverToBucket (const RxBucket &bucket, Ptr<SpectrumSignalParameters> txParams,
+                                     Ptr<MobilityModel> txMobility, int64_t txGeneration,
+                                     double range)
+{
+  if (range < 0)
+    {
+      for (std::map<Cell, RxList>::const_iterator cell = bucket.cells.begin ();
+           cell != bucket.cells.end (); ++cell)
+        {
+          for (RxList::const_iterator it = cell->second.begin (); it != cell->second.end (); ++it)
+            {
+              Deliver (txParams, txMobility, txGeneration, *it);
+            }
+        }
+      for (RxList::const_iterator it = bucket.others.begin (); it != bucket.others.end (); ++it)
+        {
+          Deliver (txParams, txMobility, txGeneration, *it);
+        }
+      return;
+    }
+
+  Vector txPosition = txMobility->GetPosition ();
+  Cell low = GetCell (Vector (txPosition.x - range, txPosition.y - range, 0));
+  Cell high = GetCell (Vector (txPosition.x + range, txPosition.y + range, 0));
+  double nCells = (double (high.first) - low.first + 1) * (double (high.second) - low.second + 1);
+  if (nCells < bucket.cells.size ())
+    {
+      for (int32_t x = low.first; x <= high.first; x++)
+        {
+          for (int32_t y = low.second; y <= high.second; y++)
+            {
+              std::map<Cell, RxList>::const_iterator cell = bucket.cells.find (Cell (x, y));
+              if (cell == bucket.cells.end ())
+                {
+                  continue;
+                }
+              for (RxList::const_iterator it = cell->second.begin (); it != cell->second.end (); ++it)
+                {
+                  Deliver (txParams, txMobility, txGeneration, *it);
+                }
+            }
+        }
+    }
+  else
+    {
+      // The range covers more cells than are occupied.
+      for (std::map<Cell, RxList>::const_iterator cell = bucket.cells.begin ();
+           cell != bucket.cells.end (); ++cell)
+        {
+          if (cell->first.first < low.first || cell->first.first > high.first
+              || cell->first.second < low.second || cell->first.second > high.second)
+            {
+              continue;
+            }
+          for (RxList::const_iterator it = cell->second.begin (); it != cell->second.end (); ++it)
+            {
+              Deliver (txParams, txMobility, txGeneration, *it);
+            }
+        }
+    }
+  for (RxList::const_iterator it = bucket.others.begin (); it != bucket.others.end (); ++it)
+    {
+      Ptr<MobilityModel> rxMobility = (*it)->GetMobility ();
+      if (rxMobility == 0 || rxMobility->GetDistanceFrom (txMobility) <= range)
+        {
+          Deliver (txParams, txMobility, txGeneration, *it);
+        }
+    }
+}
+
+void
+BleSpectrumChannel::Deliver (Ptr<SpectrumSignalParameters> txParams, Ptr<MobilityModel> txMobility,
+                             int64_t txGeneration, Ptr<SpectrumPhy> receiver)
+{
+  if (receiver == txParams->txPhy)
+    {
+      return;
+    }
+  Ptr<NetDevice> rxNetDevice = receiver->GetDevice ();
+  Ptr<NetDevice> txNetDevice = txParams->txPhy->GetDevice ();
+  if (rxNetDevice && txNetDevice
+      && rxNetDevice->GetNode ()->GetId () == txNetDevice->GetNode ()->GetId ())
+    {
+      NS_LOG_DEBUG ("Skipping the pathloss calculation among different antennas of the same node");
+      return;
+    }
+
+  Ptr<SpectrumSignalParameters> rxParams;
+  Time delay = MicroSeconds (0);
+  Ptr<MobilityModel> receiverMobility = receiver->GetMobility ();
+
+  if (txMobility && receiverMobility)
+    {
+      double pathLossDb;
+      uint32_t rxGeneration;
+      if (txGeneration >= 0 && GetStaticGeneration (receiver, rxGeneration))
+        {
+          PathLossEntry &entry = m_pathLossCache[std::make_pair (txParams->txPhy, receiver)];
+          if (entry.txGeneration == txGeneration && entry.rxGeneration == rxGeneration)
+            {
+              m_pathLossCacheHits++;
+            }
+          else
+            {
+              m_pathLossCacheMisses++;
+              CalcPathLoss (txParams, txMobility, receiver, receiverMobility,
+                            entry.pathLossDb, entry.delay);
+              entry.txGeneration = txGeneration;
+              entry.rxGeneration = rxGeneration;
+            }
+          pathLossDb = entry.pathLossDb;
+          delay = entry.delay;
+        }
+      else
+        {
+          CalcPathLoss (txParams, txMobility, receiver, receiverMobility, pathLossDb, delay);
+        }
+
+      if (pathLossDb > m_maxLossDb)
+        {
+          // beyond range
+          return;
+        }
+      rxParams = CopyParams (txParams);
+      double pathGainLinear = std::pow (10.0, (-pathLossDb) / 10.0);
+      *(rxParams->psd) *= pathGainLinear;
+
+      if (m_spectrumPropagationLoss)
+        {
+          rxParams->psd = m_spectrumPropagationLoss->CalcRxPowerSpectralDensity (rxParams->psd, txMobility, receiverMobility);
+        }
+    }
+  else
+    {
+      rxParams = CopyParams (txParams);
+    }
+
+  if (m_batching)
+    {
+      if (m_batchResolution.IsStrictlyPositive ())
+        {
+          delay = m_batchResolution * ((delay.GetTimeStep () + m_batchResolution.GetTimeStep () / 2)
+                                       / m_batchResolution.GetTimeStep ());
+        }
+      Ptr<RxBatch> &batch = m_batches[delay];
+      if (batch == 0)
+        {
+          batch = Create<RxBatch> ();
+        }
+      StaticCast<BleSpectrumSignalParameters> (rxParams)->SetEndRxByChannel (true);
+      batch->params.push_back (rxParams);
+      batch->receivers.push_back (receiver);
+      return;
+    }
+
+  m_rxEvents++;
+  if (rxNetDevice)
+    {
+      // the receiver has a NetDevice, so we expect that it is attached to a Node
+      uint32_t dstNode = rxNetDevice->GetNode ()->GetId ();
+      Simulator::ScheduleWithContext (dstNode, delay, &BleSpectrumChannel::StartRx, this,
+                                      rxParams, receiver);
+    }
+  else
+    {
+      // the receiver is not attached to a NetDevice, so we cannot assume that it is attached to a node
+      Simulator::Schedule (delay, &BleSpectrumChannel::StartRx, this,
+                           rxParams, receiver);
+    }
+}
+
+Ptr<SpectrumSignalParameters>
+BleSpectrumChannel::CopyParams (Ptr<SpectrumSignalParameters> txParams)
+{
+  Ptr<BleSpectrumSignalParameters> bleParams = DynamicCast<BleSpectrumSignalParameters> (txParams);
+  if (!m_reuseParams || bleParams == 0)
+    {
+      return txParams->Copy ();
+    }
+  // Receivers release signals in about the order they got them, so the
+  // entries handed out longest ago are the ones most likely to be free.
+  // Only a few are tried, so a delivery never walks the whole pool.
+  uint32_t nTried = std::min<uint32_t> (m_rxParams.size (), MAX_REUSE_TRIES);
+  for (uint32_t i = 0; i < nTried; i++)
+    {
+      Ptr<BleSpectrumSignalParameters> rxParams = m_rxParams[m_rxParamsNext];
+      m_rxParamsNext = (m_rxParamsNext + 1) % m_rxParams.size ();
+      if (rxParams->GetReferenceCount () == 1)
+        {
+          rxParams->CopyFrom (*bleParams);
+          return rxParams;
+        }
+    }
+  // Every entry tried is still being received. The copy joins the pool
+  // while it is small; otherwise it takes the place of the entry the
+  // cursor is on, which its receiver releases on its own.
+  Ptr<BleSpectrumSignalParameters> rxParams = StaticCast<BleSpectrumSignalParameters> (bleParams->Copy ());
+  if (m_rxParams.size () < MAX_REUSED_PARAMS)
+    {
+      m_rxParams.push_back (rxParams);
+    }
+  else
+    {
+      m_rxParams[m_rxParamsNext] = rxParams;
+      m_rxParamsNext = (m_rxParamsNext + 1) % m_rxParams.size ();
+    }
+  return rxParams;
+}
+
+void
+BleSpectrumChannel::CalcPathLoss (Ptr<const SpectrumSignalParameters> txParams,
+                                  Ptr<MobilityModel> txMobility, Ptr<SpectrumPhy> receiver,
+                                  Ptr<MobilityModel> receiverMobility,
+                                  double &pathLossDb, Time &delay)
+{
+  pathLossDb = 0;
+  if (txParams->txAntenna != 0)
+    {
+      Angles txAngles (receiverMobility->GetPosition (), txMobility->GetPosition ());
+      pathLossDb -= txParams->txAntenna->GetGainDb (txAngles);
+    }
+  Ptr<AntennaModel> rxAntenna = receiver->GetRxAntenna ();
+  if (rxAntenna != 0)
+    {
+      Angles rxAngles (txMobility->GetPosition (), receiverMobility->GetPosition ());
+      pathLossDb -= rxAntenna->GetGainDb (rxAngles);
+    }
+  if (m_propagationLoss)
+    {
+      pathLossDb -= m_propagationLoss->CalcRxPower (0, txMobility, receiverMobility);
+    }
+  delay = MicroSeconds (0);
+  if (m_propagationDelay)
+    {
+      delay = m_propagationDelay->GetDelay (txMobility, receiverMobility);
+    }
+}
+
+void
+BleSpectrumChannel::StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver)
+{
+  NS_LOG_FUNCTION (this << params << receiver);
+  receiver->StartRx (params);
+}
+
+void
+BleSpectrumChannel::StartRxBatch (Ptr<RxBatch> batch)
+{
+  NS_LOG_FUNCTION (this << batch->receivers.size ());
+  for (uint32_t i = 0; i < batch->receivers.size (); i++)
+    {
+      batch->receivers[i]->StartRx (batch->params[i]);
+    }
+}
+
+void
+BleSpectrumChannel::EndRxBatch (Ptr<RxBatch> batch)
+{
+  NS_LOG_FUNCTION (this << batch->receivers.size ());
+  for (uint32_t i = 0; i < batch->receivers.size (); i++)
+    {
+      Ptr<BlePhy> phy = DynamicCast<BlePhy> (batch->receivers[i]);
+      if (phy != 0)
+        {
+          phy->EndSignal (StaticCast<BleSpectrumSignalParameters> (batch->params[i]));
+        }
+    }
+}
+
+std::size_t
+BleSpectrumChannel::GetNDevices (void) const
+{
+  return m_rxPositions.size ();
+}
+
+Ptr<NetDevice>
+BleSpectrumChannel::GetDevice (std::size_t i) const
+{
+  NS_ASSERT (i < m_rxPositions.size ());
+  std::map<Ptr<SpectrumPhy>, RxPosition>::const_iterator it = m_rxPositions.begin ();
+  std::advance (it, i);
+  return it->first->GetDevice ();
+}
+
+} // namespace ns3
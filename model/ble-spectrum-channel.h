@@ -0,0 +1,384 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#ifndef BLE_SPECTRUM_CHANNEL_H
+#define BLE_SPECTRUM_CHANNEL_H
+
+#include <ns3/spectrum-channel.h>
+#include <ns3/spectrum-signal-parameters.h>
+#include <ns3/mobility-model.h>
+#include <ns3/vector.h>
+#include <ns3/traced-value.h>
+#include <ns3/simple-ref-count.h>
+#include <ns3/callback.h>
+#include <map>
+#include <set>
+#include <vector>
+
+namespace ns3 {
+
+class BlePhy;
+struct BleSpectrumSignalParameters;
+
+/**
+ * \ingroup BLE
+ *
+ * A spectrum channel that knows about BLE channel indices.
+ *
+ * All BLE channel indices share one channel object and one set of
+ * propagation models. Receivers are kept in buckets according to the
+ * channel index their BlePhy is tuned to and move between buckets when
+ * the PHY hops. A BLE transmission is only delivered to the receivers in
+ * the bucket of its channel index (and optionally the neighbouring ones),
+ * so the cost of a transmission grows with the number of co-channel
+ * listeners rather than with the number of nodes. Receivers that are not
+ * a BlePhy hear every transmission.
+ *
+ * Within a bucket, receivers that stand still are sorted into a square
+ * grid by position. A transmission is only delivered to the grid cells
+ * within the interference range: the distance at which the propagation
+ * loss model brings the transmitted power below RxSensitivity, unless
+ * MaxInterferenceRange is set. Receivers that move, or have no mobility
+ * model, are kept outside the grid and checked by distance. The grid is
+ * updated whenever a mobility model reports a course change.
+ *
+ * The path loss and propagation delay between two receivers that stand
+ * still are computed once and reused until one of them changes course.
+ *
+ * With BatchedDelivery, a BLE transmission schedules one start and one
+ * end event per distinct propagation delay instead of a StartRx event per
+ * receiver and an EndRx event in every receiving BlePhy. Delays are
+ * rounded to BatchResolution first, so in a typical deployment a
+ * transmission costs two events. These events walk the receivers in the
+ * context of the transmitting node, as ns-3 cannot change the context of
+ * a running event; the link layer of each receiver schedules what
+ * follows a reception in the context of its own node.
+ *
+ * Link managers can mark the receivers of idle links, so a link can tell
+ * whether anyone else on the channel may still transmit data.
+ */
+class BleSpectrumChannel : public SpectrumChannel
+{
+public:
+  /**
+   * Get the type ID.
+   *
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  BleSpectrumChannel ();
+  virtual ~BleSpectrumChannel ();
+
+  // inherited from SpectrumChannel
+  virtual void StartTx (Ptr<SpectrumSignalParameters> params);
+  virtual void AddRx (Ptr<SpectrumPhy> phy);
+  virtual void RemoveRx (Ptr<SpectrumPhy> phy);
+
+  // inherited from Channel
+  virtual std::size_t GetNDevices (void) const;
+  virtual Ptr<NetDevice> GetDevice (std::size_t i) const;
+
+  /**
+   * Move a receiver to the bucket of the channel index it is tuned to.
+   * BlePhy calls this whenever its channel index changes.
+   *
+   * \param phy the receiver
+   */
+  void UpdateRx (Ptr<BlePhy> phy);
+
+  /**
+   * Mark a receiver as belonging to an idle link, whose connection events
+   * only carry empty PDUs. Marking a receiver busy again, adding a new
+   * one, or moving a busy one runs the callbacks given to NotifyWhenBusy
+   * for the receivers in its range.
+   *
+   * \param phy the receiver
+   * \param idle whether its link is idle
+   */
+  void SetRxIdle (Ptr<SpectrumPhy> phy, bool idle);
+
+  /**
+   * \return the number of receivers that are not marked idle
+   */
+  uint32_t GetNBusyRx (void) const;
+
+  /**
+   * Count the receivers that are not marked idle and that are close
+   * enough to a receiver for one to hear the other. With the
+   * SpatialIndex, only the grid cells within interference range are
+   * looked at, besides the receivers that move or have no position;
+   * otherwise this walks all receivers.
+   *
+   * \param phy the receiver
+   * \return the number of busy receivers in range of phy, phy excluded
+   */
+  uint32_t GetNBusyRx (Ptr<SpectrumPhy> phy);
+
+  /**
+   * Ask to be told, once, when a receiver in range of one of some
+   * receivers becomes busy.
+   *
+   * \param phys the receivers to watch
+   * \param callback the callback to run
+   */
+  void NotifyWhenBusy (const std::vector<Ptr<SpectrumPhy> > &phys, Callback<void> callback);
+
+protected:
+  virtual void DoDispose (void);
+
+private:
+  /// Grid cell coordinates
+  typedef std::pair<int32_t, int32_t> Cell;
+
+  /// Receivers that share a grid cell, or a bucket
+  typedef std::vector<Ptr<SpectrumPhy> > RxList;
+
+  /// Receivers tuned to the same channel index
+  struct RxBucket
+  {
+    std::map<Cell, RxList> cells; //!< receivers that stand still, by grid cell
+    RxList others;                //!< receivers that move or have no position
+  };
+
+  /// A mobility model whose course changes are followed
+  struct WatchedMobility
+  {
+    RxList phys;         //!< receivers using it
+    uint32_t generation; //!< number of course changes seen
+  };
+
+  /// Propagation from a transmitter to a receiver that both stand still
+  struct PathLossEntry
+  {
+    PathLossEntry () : txGeneration (-1), rxGeneration (-1), pathLossDb (0) {}
+    int64_t txGeneration; //!< generation of the transmitter's mobility model
+    int64_t rxGeneration; //!< generation of the receiver's mobility model
+    double pathLossDb;    //!< loss including antenna gains
+    Time delay;           //!< propagation delay
+  };
+
+  /// Signals of one transmission that reach their receivers after the same delay
+  struct RxBatch : public SimpleRefCount<RxBatch>
+  {
+    std::vector<Ptr<SpectrumSignalParameters> > params; //!< received signals
+    RxList receivers;                                  //!< their receivers
+  };
+
+  /// Location of a receiver in m_buckets
+  struct RxPosition
+  {
+    uint32_t bucket; //!< bucket the receiver is in
+    bool inGrid;     //!< whether the receiver is in a grid cell or in others
+    Cell cell;       //!< grid cell, if inGrid
+    uint32_t index;  //!< position in the receiver list
+  };
+
+  /**
+   * Deliver a signal to all receivers in a bucket that are within range.
+   *
+   * \param bucket the bucket
+   * \param txParams the transmitted signal
+   * \param txMobility the mobility model of the transmitter
+   * \param txGeneration generation of a transmitter that stands still, else -1
+   * \param range the interference range, negative to deliver to everyone
+   */
+  void DeliverToBucket (const RxBucket &bucket, Ptr<SpectrumSignalParameters> txParams,
+                        Ptr<MobilityModel> txMobility, int64_t txGeneration, double range);
+
+  /**
+   * Deliver a signal to a receiver after the propagation delay.
+   *
+   * \param txParams the transmitted signal
+   * \param txMobility the mobility model of the transmitter
+   * \param txGeneration generation of a transmitter that stands still, else -1
+   * \param receiver the receiver
+   */
+  void Deliver (Ptr<SpectrumSignalParameters> txParams, Ptr<MobilityModel> txMobility,
+                int64_t txGeneration, Ptr<SpectrumPhy> receiver);
+
+  /**
+   * Copy a transmitted signal for a receiver. With ReuseSignalParameters,
+   * BLE signals are copied into parameters of an earlier delivery that
+   * no receiver holds any more. Only the next few entries of the pool
+   * are tried, and the pool does not grow beyond a fixed size.
+   *
+   * \param txParams the transmitted signal
+   * \return the copy
+   */
+  Ptr<SpectrumSignalParameters> CopyParams (Ptr<SpectrumSignalParameters> txParams);
+
+  /**
+   * Compute the path loss, including antenna gains, and the delay from a
+   * transmitter to a receiver.
+   *
+   * \param txParams the transmitted signal
+   * \param txMobility the mobility model of the transmitter
+   * \param receiver the receiver
+   * \param receiverMobility the mobility model of the receiver
+   * \param pathLossDb set to the path loss
+   * \param delay set to the propagation delay
+   */
+  void CalcPathLoss (Ptr<const SpectrumSignalParameters> txParams,
+                     Ptr<MobilityModel> txMobility, Ptr<SpectrumPhy> receiver,
+                     Ptr<MobilityModel> receiverMobility,
+                     double &pathLossDb, Time &delay);
+
+  /**
+   * Hand a signal over to a receiver.
+   *
+   * \param params the received signal
+   * \param receiver the receiver
+   */
+  void StartRx (Ptr<SpectrumSignalParameters> params, Ptr<SpectrumPhy> receiver);
+
+  /**
+   * Hand a batch of signals over to their receivers.
+   *
+   * \param batch the signals
+   */
+  void StartRxBatch (Ptr<RxBatch> batch);
+
+  /**
+   * End a batch of signals at the receivers that are receiving them.
+   *
+   * \param batch the signals
+   */
+  void EndRxBatch (Ptr<RxBatch> batch);
+
+  /**
+   * \param phy a receiver
+   * \return the bucket the receiver belongs in
+   */
+  uint32_t GetBucket (Ptr<SpectrumPhy> phy) const;
+
+  /**
+   * \param position a position
+   * \return the grid cell that contains it
+   */
+  Cell GetCell (const Vector &position) const;
+
+  /**
+   * \param position where a receiver is
+   * \return the receiver list it is stored in
+   */
+  RxList &GetRxList (const RxPosition &position);
+
+  /**
+   * Store a receiver in the right bucket and grid cell.
+   *
+   * \param phy the receiver
+   */
+  void Insert (Ptr<SpectrumPhy> phy);
+
+  /**
+   * Take a receiver out of its bucket and grid cell.
+   *
+   * \param phy the receiver
+   * \return false if the receiver was not stored
+   */
+  bool Erase (Ptr<SpectrumPhy> phy);
+
+  /**
+   * Run and forget the callbacks given to NotifyWhenBusy that watch a
+   * receiver in range of a busy one.
+   *
+   * \param busy the receiver that became busy
+   */
+  void RunBusyCallbacks (Ptr<SpectrumPhy> busy);
+
+  /**
+   * \param a a receiver
+   * \param b another receiver
+   * \return whether a transmission of either could reach the other
+   */
+  bool InRange (Ptr<SpectrumPhy> a, Ptr<SpectrumPhy> b);
+
+  /**
+   * \param list some receivers
+   * \param phy a receiver
+   * \return the receivers of list that are not marked idle and are in
+   *         range of phy, phy excluded
+   */
+  uint32_t CountBusyInRange (const RxList &list, Ptr<SpectrumPhy> phy);
+
+  /**
+   * Re-sort the receivers using a mobility model after a course change.
+   *
+   * \param mobility the mobility model that changed course
+   */
+  void CourseChanged (Ptr<const MobilityModel> mobility);
+
+  /**
+   * Get the generation of the mobility model of a receiver that stands
+   * still.
+   *
+   * \param phy the receiver
+   * \param generation set to the generation
+   * \return false if the receiver may move or is not followed
+   */
+  bool GetStaticGeneration (Ptr<SpectrumPhy> phy, uint32_t &generation) const;
+
+  /**
+   * Get the distance beyond which a transmission is not delivered.
+   *
+   * \param txPsd the power spectral density of the transmission
+   * \param txMobility the mobility model of the transmitter
+   * \return the interference range in meters, negative if unlimited
+   */
+  double GetInterferenceRange (Ptr<const SpectrumValue> txPsd,
+                               Ptr<MobilityModel> txMobility);
+
+  /// One bucket per BLE channel index, plus one for non-BLE receivers
+  std::vector<RxBucket> m_buckets;
+  std::map<Ptr<SpectrumPhy>, RxPosition> m_rxPositions; //!< where each receiver is
+  /// Mobility models whose course changes are followed
+  std::map<Ptr<const MobilityModel>, WatchedMobility> m_mobilities;
+  /// Path loss by (transmitter, receiver)
+  std::map<std::pair<Ptr<SpectrumPhy>, Ptr<SpectrumPhy> >, PathLossEntry> m_pathLossCache;
+  /// Interference range by TX power and antenna height, both in tenths
+  std::map<std::pair<int32_t, int32_t>, double> m_ranges;
+
+  uint32_t m_adjacentChannels; //!< neighbouring indices that also receive a transmission
+  bool m_spatialIndex;         //!< whether receivers out of range are skipped
+  double m_cellSize;           //!< size of a grid cell in meters
+  double m_rxSensitivity;      //!< weakest power still delivered, in dBm
+  double m_maxRange;           //!< fixed interference range in meters, 0 to derive it
+  double m_largestRange;       //!< largest derived range in meters, negative if one is unlimited
+  bool m_pathLossCacheEnabled; //!< whether path losses between static receivers are kept
+  TracedValue<uint64_t> m_pathLossCacheHits;   //!< deliveries that used the cache
+  TracedValue<uint64_t> m_pathLossCacheMisses; //!< path losses stored in the cache
+  bool m_batchedDelivery;      //!< whether BLE transmissions are delivered in batches
+  Time m_batchResolution;      //!< delays are rounded to this before grouping
+  bool m_batching;             //!< whether the current transmission is being batched
+  /// Batches of the current transmission by delay
+  std::map<Time, Ptr<RxBatch> > m_batches;
+  TracedValue<uint64_t> m_rxEvents; //!< events scheduled to deliver signals
+  bool m_reuseParams;          //!< whether copies for receivers come from m_rxParams
+  /// Copies handed to receivers, tried in turn for reuse; a bounded pool
+  std::vector<Ptr<BleSpectrumSignalParameters> > m_rxParams;
+  uint32_t m_rxParamsNext;     //!< entry of m_rxParams to try first
+  std::set<Ptr<SpectrumPhy> > m_idleRx; //!< receivers of idle links
+  /// Receivers watched for NotifyWhenBusy, and the callback to run
+  std::vector<std::pair<RxList, Callback<void> > > m_busyCallbacks;
+};
+
+} // namespace ns3
+
+#endif /* BLE_SPECTRUM_CHANNEL_H */
@@ -34,6 +34,10 @@ namespace ns3 {
 NS_LOG_COMPONENT_DEFINE ("BleSpectrumSignalParameters");
 
 BleSpectrumSignalParameters::BleSpectrumSignalParameters (void)
+  : m_endRxByChannel (false),
+    m_rxPower (0),
+    m_phyMode (0),
+    m_snr (0)
 {
   NS_LOG_FUNCTION (this);
 }
@@ -43,8 +47,42 @@ BleSpectrumSignalParameters::BleSpectrumSignalParameters (
   : SpectrumSignalParameters (p)
 {
   NS_LOG_FUNCTION (this << &p);
-  packet = p.packet->Copy ();
+  packet = p.packet;
   m_channel = p.m_channel;
+  m_endRxByChannel = p.m_endRxByChannel;
+  m_rxPower = p.m_rxPower;
+  m_phyMode = p.m_phyMode;
+  m_snr = p.m_snr;
+  m_header = p.m_header;
+}
+
+void
+BleSpectrumSignalParameters::CopyFrom (const BleSpectrumSignalParameters& p)
+{
+  NS_LOG_FUNCTION (this << &p);
+  // A receiver may keep the psd after it let go of the parameters
+  if (psd != 0 && p.psd != 0 && psd->GetReferenceCount () == 1
+      && psd->GetSpectrumModel () == p.psd->GetSpectrumModel ())
+    {
+      *psd = *p.psd;
+    }
+  else
+    {
+      psd = p.psd == 0 ? 0 : p.psd->Copy ();
+    }
+  duration = p.duration;
+  txPhy = p.txPhy;
+  txAntenna = p.txAntenna;
+  packet = p.packet;
+  m_channel = p.m_channel;
+  m_ber = 0;
+  m_event = EventId ();
+  m_rxStart = Time ();
+  m_endRxByChannel = p.m_endRxByChannel;
+  m_rxPower = p.m_rxPower;
+  m_phyMode = p.m_phyMode;
+  m_snr = p.m_snr;
+  m_header = p.m_header;
 }
 
 BleSpectrumSignalParameters::~BleSpectrumSignalParameters (void)
@@ -101,4 +139,77 @@ BleSpectrumSignalParameters::GetEvent (void)
 {
   return m_event;
 }
+
+void
+BleSpectrumSignalParameters::SetRxStart (Time rxStart)
+{
+  m_rxStart = rxStart;
+}
+
+Time
+BleSpectrumSignalParameters::GetRxStart (void)
+{
+  return m_rxStart;
+}
+
+void
+BleSpectrumSignalParameters::SetEndRxByChannel (bool endRxByChannel)
+{
+  m_endRxByChannel = endRxByChannel;
+}
+
+bool
+BleSpectrumSignalParameters::GetEndRxByChannel (void)
+{
+  return m_endRxByChannel;
+}
+
+void
+BleSpectrumSignalParameters::SetRxPower (double rxPower)
+{
+  m_rxPower = rxPower;
+}
+
+double
+BleSpectrumSignalParameters::GetRxPower (void)
+{
+  return m_rxPower;
+}
+
+void
+BleSpectrumSignalParameters::SetPhyMode (uint8_t phyMode)
+{
+  m_phyMode = phyMode;
+}
+
+uint8_t
+BleSpectrumSignalParameters::GetPhyMode (void)
+{
+  return m_phyMode;
+}
+
+void
+BleSpectrumSignalParameters::SetSnr (double snr)
+{
+  m_snr = snr;
+}
+
+double
+BleSpectrumSignalParameters::GetSnr (void)
+{
+  return m_snr;
+}
+
+void
+BleSpectrumSignalParameters::SetHeader (const BleMacHeader &header)
+{
+  m_header = header;
+}
+
+const BleMacHeader &
+BleSpectrumSignalParameters::GetHeader (void) const
+{
+  return m_header;
+}
+
 } // namespace ns3
@@ -29,6 +29,8 @@
 #include <ns3/spectrum-signal-parameters.h>
 #include <ns3/packet.h>
 #include <ns3/event-id.h>
+#include <ns3/nstime.h>
+#include "ble-mac-header.h"
 namespace ns3 {
 
 
@@ -52,9 +54,17 @@ struct BleSpectrumSignalParameters : public SpectrumSignalParameters
    */
   BleSpectrumSignalParameters (const BleSpectrumSignalParameters& p);
   /**
-   * The packet burst being transmitted with this signal
+   * Make these parameters a copy of p, as the copy constructor does,
+   * reusing the storage of the psd when nothing else holds it and it
+   * has the same spectrum model
    */
-  Ptr<Packet> packet;
+  void CopyFrom (const BleSpectrumSignalParameters& p);
+  /**
+   * The packet being transmitted with this signal. It is shared, not
+   * copied, between the transmitter and all receivers, so it must not be
+   * modified; copy it first.
+   */
+  Ptr<const Packet> packet;
   uint8_t m_channel;
   void SetChannel (uint8_t channel);
   uint8_t GetChannel (void);
@@ -64,6 +74,47 @@ struct BleSpectrumSignalParameters : public SpectrumSignalParameters
   EventId m_event;
   EventId GetEvent (void);
   void SetEvent (EventId event);  
+  /**
+   * Time at which the receiving PHY started receiving this signal
+   */
+  Time m_rxStart;
+  void SetRxStart (Time rxStart);
+  Time GetRxStart (void);
+  /**
+   * Whether the channel ends the reception of this signal through
+   * BlePhy::EndSignal, so the receiving PHY does not schedule its own
+   * EndRx event
+   */
+  bool m_endRxByChannel;
+  void SetEndRxByChannel (bool endRxByChannel);
+  bool GetEndRxByChannel (void);
+  /**
+   * Total received power of this signal, computed once when it arrives
+   */
+  double m_rxPower;
+  void SetRxPower (double rxPower);
+  double GetRxPower (void);
+  /**
+   * PHY mode the signal was sent with, a BlePhy::PhyMode. Only a
+   * receiver in the same mode can demodulate it.
+   */
+  uint8_t m_phyMode;
+  void SetPhyMode (uint8_t phyMode);
+  uint8_t GetPhyMode (void);
+  /**
+   * Lowest SNR, as a power ratio, seen while receiving this signal
+   */
+  double m_snr;
+  void SetSnr (double snr);
+  double GetSnr (void);
+  /**
+   * Link layer header of the PDU. It travels with the signal so that the
+   * receiver does not deserialize it from the packet; the header bytes of
+   * the packet may hold stale NESN, SN and MD bits.
+   */
+  BleMacHeader m_header;
+  void SetHeader (const BleMacHeader &header);
+  const BleMacHeader &GetHeader (void) const;
 
 };
 
@@ -25,8 +25,17 @@
 #include <ns3/nstime.h>
 
 #define BLE_CONST_TIME_UNIT Time::Unit::US
-#define QUEUE_SIZE_PACKETS "100p" // Max number of packets in the queue
 #define T_IFS 150 // microseconds
 #define PRECISION 100 // In NanoSeconds
 
+// Fields of an LL PDU on air, in octets
+#define BLE_PREAMBLE_SIZE 1
+#define BLE_ACCESS_ADDRESS_SIZE 4
+#define BLE_LL_HEADER_SIZE 2
+#define BLE_MIC_SIZE 4
+#define BLE_CRC_SIZE 3
+// LL payload length limits (Data Length Extension)
+#define BLE_MIN_DATA_OCTETS 27
+#define BLE_MAX_DATA_OCTETS 251
+
 #endif // BLE_CONSTANTS_H
@@ -0,0 +1,154 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <ns3/test.h>
+#include <ns3/simulator.h>
+#include <ns3/config.h>
+#include <ns3/boolean.h>
+#include <ns3/node-container.h>
+#include <ns3/net-device-container.h>
+#include <ns3/mobility-helper.h>
+#include <ns3/random-variable-stream.h>
+#include <ns3/ble-helper.h>
+#include <ns3/ble-net-device.h>
+#include <ns3/ble-bb-manager.h>
+#include <ns3/ble-link-manager.h>
+#include <ns3/constants.h>
+
+using namespace ns3;
+
+/**
+ * \ingroup BLE
+ *
+ * A central with PlanAnchors gets links of 30, 60, 50 and 125 ms, all
+ * asked for at the same offset. The planner rounds the intervals down to
+ * 30, 60, 30 and 120 ms and places the anchors so that no transmit
+ * window, plus T_IFS, overlaps another: with traffic on every link the
+ * central never skips a window, and its duty cycle is the sum of
+ * (window + T_IFS) / interval over the links.
+ */
+class BleBBManagerPlanAnchorsTestCase : public TestCase
+{
+public:
+  BleBBManagerPlanAnchorsTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Count a skipped transmit window.
+   *
+   * \param count where to count
+   * \param device the device that skipped it
+   */
+  static void WindowSkipped (uint32_t *count, Ptr<const BleNetDevice> device);
+};
+
+BleBBManagerPlanAnchorsTestCase::BleBBManagerPlanAnchorsTestCase ()
+  : TestCase ("Planned anchors of a central do not overlap")
+{
+}
+
+void
+BleBBManagerPlanAnchorsTestCase::WindowSkipped (uint32_t *count, Ptr<const BleNetDevice> device)
+{
+  (*count)++;
+}
+
+void
+BleBBManagerPlanAnchorsTestCase::DoRun (void)
+{
+  Config::SetDefault ("ns3::BleBBManager::PlanAnchors", BooleanValue (true));
+
+  NodeContainer nodes;
+  nodes.Create (5);
+  MobilityHelper mobility;
+  Ptr<ListPositionAllocator> positions = CreateObject<ListPositionAllocator> ();
+  for (uint32_t i = 0; i < nodes.GetN (); i++)
+    {
+      positions->Add (Vector (i, 0, 1));
+    }
+  mobility.SetPositionAllocator (positions);
+  mobility.SetMobilityModel ("ns3::ConstantPositionMobilityModel");
+  mobility.Install (nodes);
+
+  BleHelper helper;
+  NetDeviceContainer devices = helper.Install (nodes);
+  Ptr<BleNetDevice> central = DynamicCast<BleNetDevice> (devices.Get (0));
+  // In units of 1.25 ms
+  const uint32_t intervals[] = { 24, 48, 40, 100 };
+  Ptr<UniformRandomVariable> start = CreateObject<UniformRandomVariable> ();
+  start->SetAttribute ("Max", DoubleValue (0.01));
+  for (uint32_t i = 1; i < nodes.GetN (); i++)
+    {
+      Ptr<BleNetDevice> peripheral = DynamicCast<BleNetDevice> (devices.Get (i));
+      central->GetBBManager ()->CreateLinkScheduled (peripheral->GetBBManager (),
+                                                     BleLinkManager::MASTER_ROLE, true,
+                                                     0, intervals[i - 1]);
+      helper.GenerateTraffic (start, nodes.Get (i), 20, 0.1, 1.9, 0.01, nodes.Get (0));
+    }
+
+  uint32_t skipped = 0;
+  for (uint32_t i = 0; i < devices.GetN (); i++)
+    {
+      devices.Get (i)->TraceConnectWithoutContext ("TXWindowSkipped",
+          MakeBoundCallback (&BleBBManagerPlanAnchorsTestCase::WindowSkipped, &skipped));
+    }
+
+  double window = (MilliSeconds (5) + MicroSeconds (T_IFS)).GetSeconds ();
+  double expected = window / 0.030 + window / 0.060 + window / 0.030 + window / 0.120;
+  NS_TEST_ASSERT_MSG_EQ_TOL (central->GetBBManager ()->GetDutyCycle (), expected, 1e-9,
+                             "duty cycle is not the sum over the planned links");
+  double sum = 0;
+  std::list<Ptr<BleLinkManager> > linkManagers = central->GetBBManager ()->GetLinkManagers ();
+  for (std::list<Ptr<BleLinkManager> >::iterator it = linkManagers.begin ();
+       it != linkManagers.end (); ++it)
+    {
+      sum += ((*it)->GetTransmitWindowSize () + MicroSeconds (T_IFS)).GetSeconds ()
+        / (*it)->GetConnInterval ().GetSeconds ();
+    }
+  NS_TEST_ASSERT_MSG_EQ_TOL (central->GetBBManager ()->GetDutyCycle (), sum, 1e-9,
+                             "duty cycle does not match the links");
+
+  Simulator::Stop (Seconds (2));
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (skipped, 0, "transmit windows were skipped");
+
+  Simulator::Destroy ();
+  Config::Reset ();
+}
+
+/**
+ * \ingroup BLE
+ *
+ * Tests of the BLE baseband manager.
+ */
+class BleBBManagerTestSuite : public TestSuite
+{
+public:
+  BleBBManagerTestSuite ();
+};
+
+BleBBManagerTestSuite::BleBBManagerTestSuite ()
+  : TestSuite ("ble-bb-manager", UNIT)
+{
+  AddTestCase (new BleBBManagerPlanAnchorsTestCase, TestCase::QUICK);
+}
+
+static BleBBManagerTestSuite g_bleBBManagerTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,164 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <ns3/test.h>
+#include <ns3/ble-bit-error-sampler.h>
+
+#include <cmath>
+
+using namespace ns3;
+
+/**
+ * \ingroup BLE
+ *
+ * The samplers return no errors without bits or without a BER, and only
+ * errors with a BER of one.
+ */
+class BleBitErrorSamplerLimitsTestCase : public TestCase
+{
+public:
+  BleBitErrorSamplerLimitsTestCase ();
+
+private:
+  virtual void DoRun (void);
+  void Check (Ptr<BleBitErrorSampler> sampler);
+};
+
+BleBitErrorSamplerLimitsTestCase::BleBitErrorSamplerLimitsTestCase ()
+  : TestCase ("Bit error samplers at the limits of the BER")
+{
+}
+
+void
+BleBitErrorSamplerLimitsTestCase::Check (Ptr<BleBitErrorSampler> sampler)
+{
+  NS_TEST_ASSERT_MSG_EQ (sampler->GetBitErrors (0, 0.3), 0, "errors without bits");
+  NS_TEST_ASSERT_MSG_EQ (sampler->GetBitErrors (1000, 0), 0, "errors with a zero BER");
+  NS_TEST_ASSERT_MSG_EQ (sampler->GetBitErrors (1000, 1), 1000, "correct bits with a BER of one");
+}
+
+void
+BleBitErrorSamplerLimitsTestCase::DoRun (void)
+{
+  Check (CreateObject<BlePerBitErrorSampler> ());
+  Check (CreateObject<BleBinomialBitErrorSampler> ());
+}
+
+/**
+ * \ingroup BLE
+ *
+ * The mean and variance of the number of bit errors drawn by a sampler
+ * are those of Binomial(bits, ber). Each of the cases falls in another
+ * branch of BleBinomialBitErrorSampler: Poisson inversion, binomial
+ * inversion, normal approximation, and a mirrored BER above one half.
+ */
+class BleBitErrorSamplerMomentsTestCase : public TestCase
+{
+public:
+  /**
+   * \param sampler the sampler to test
+   * \param name name of the sampler
+   * \param bits bits per draw
+   * \param ber bit error rate
+   */
+  BleBitErrorSamplerMomentsTestCase (Ptr<BleBitErrorSampler> sampler, std::string name,
+                                     uint32_t bits, double ber);
+
+private:
+  virtual void DoRun (void);
+
+  Ptr<BleBitErrorSampler> m_sampler;
+  uint32_t m_bits;
+  double m_ber;
+};
+
+BleBitErrorSamplerMomentsTestCase::BleBitErrorSamplerMomentsTestCase (Ptr<BleBitErrorSampler> sampler,
+                                                                      std::string name,
+                                                                      uint32_t bits, double ber)
+  : TestCase (name + " matches Binomial moments"),
+    m_sampler (sampler),
+    m_bits (bits),
+    m_ber (ber)
+{
+}
+
+void
+BleBitErrorSamplerMomentsTestCase::DoRun (void)
+{
+  m_sampler->AssignStreams (1);
+  const uint32_t draws = 20000;
+  double sum = 0;
+  double sumSquares = 0;
+  for (uint32_t i = 0; i < draws; i++)
+    {
+      double k = m_sampler->GetBitErrors (m_bits, m_ber);
+      NS_TEST_ASSERT_MSG_LT_OR_EQ (k, m_bits, "more errors than bits");
+      sum += k;
+      sumSquares += k * k;
+    }
+  double mean = sum / draws;
+  double variance = sumSquares / draws - mean * mean;
+  double expectedMean = m_bits * m_ber;
+  double expectedVariance = m_bits * m_ber * (1 - m_ber);
+
+  // Five standard errors of the sample mean, and 10% of the variance
+  // (its standard error is below 2% for these cases).
+  NS_TEST_ASSERT_MSG_EQ_TOL (mean, expectedMean, 5 * std::sqrt (expectedVariance / draws),
+                             "mean of " << m_bits << " bits at BER " << m_ber);
+  NS_TEST_ASSERT_MSG_EQ_TOL (variance, expectedVariance, 0.1 * expectedVariance,
+                             "variance of " << m_bits << " bits at BER " << m_ber);
+}
+
+/**
+ * \ingroup BLE
+ *
+ * Tests of the bit error samplers.
+ */
+class BleBitErrorSamplerTestSuite : public TestSuite
+{
+public:
+  BleBitErrorSamplerTestSuite ();
+};
+
+BleBitErrorSamplerTestSuite::BleBitErrorSamplerTestSuite ()
+  : TestSuite ("ble-bit-error-sampler", UNIT)
+{
+  AddTestCase (new BleBitErrorSamplerLimitsTestCase, TestCase::QUICK);
+  AddTestCase (new BleBitErrorSamplerMomentsTestCase (CreateObject<BlePerBitErrorSampler> (),
+                                                      "Per-bit sampler", 200, 0.05),
+               TestCase::QUICK);
+  // Poisson inversion
+  AddTestCase (new BleBitErrorSamplerMomentsTestCase (CreateObject<BleBinomialBitErrorSampler> (),
+                                                      "Binomial sampler, tiny BER", 2000, 2e-4),
+               TestCase::QUICK);
+  // Binomial inversion
+  AddTestCase (new BleBitErrorSamplerMomentsTestCase (CreateObject<BleBinomialBitErrorSampler> (),
+                                                      "Binomial sampler, small mean", 200, 0.05),
+               TestCase::QUICK);
+  // Normal approximation
+  AddTestCase (new BleBitErrorSamplerMomentsTestCase (CreateObject<BleBinomialBitErrorSampler> (),
+                                                      "Binomial sampler, large mean", 2000, 0.1),
+               TestCase::QUICK);
+  // Mirrored
+  AddTestCase (new BleBitErrorSamplerMomentsTestCase (CreateObject<BleBinomialBitErrorSampler> (),
+                                                      "Binomial sampler, BER above one half", 200, 0.9),
+               TestCase::QUICK);
+}
+
+static BleBitErrorSamplerTestSuite g_bleBitErrorSamplerTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,235 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <ns3/test.h>
+#include <ns3/simulator.h>
+#include <ns3/boolean.h>
+#include <ns3/ble-conn-event-scheduler.h>
+
+using namespace ns3;
+
+/**
+ * \ingroup BLE
+ *
+ * Timers run at their expiry, in the order they were scheduled, and not
+ * after they were cancelled, also when they lie beyond the first level
+ * of the wheel.
+ */
+class BleConnEventSchedulerOrderTestCase : public TestCase
+{
+public:
+  BleConnEventSchedulerOrderTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Record a timer.
+   *
+   * \param test the test case
+   * \param id the number of the timer
+   * \param expiry when it should run
+   */
+  static void Expire (BleConnEventSchedulerOrderTestCase *test, uint32_t id, Time expiry);
+
+  std::vector<uint32_t> m_fired; //!< timers in the order they ran
+};
+
+BleConnEventSchedulerOrderTestCase::BleConnEventSchedulerOrderTestCase ()
+  : TestCase ("Timers run in order at their expiry")
+{
+}
+
+void
+BleConnEventSchedulerOrderTestCase::Expire (BleConnEventSchedulerOrderTestCase *test,
+                                            uint32_t id, Time expiry)
+{
+  NS_TEST_EXPECT_MSG_EQ (Simulator::Now (), expiry, "timer " << id << " ran at the wrong time");
+  test->m_fired.push_back (id);
+}
+
+void
+BleConnEventSchedulerOrderTestCase::DoRun (void)
+{
+  Ptr<BleConnEventScheduler> wheel = CreateObject<BleConnEventScheduler> ();
+  // Two timers in the same tick, one later in that tick, one beyond the
+  // first level, one beyond the second, and one cancelled.
+  Time delays[] = { MicroSeconds (2600), MicroSeconds (2600), MicroSeconds (3000),
+                    Seconds (1), Seconds (30), MilliSeconds (5) };
+  std::vector<BleConnEventScheduler::TimerId> ids;
+  for (uint32_t i = 0; i < 6; i++)
+    {
+      ids.push_back (wheel->Schedule (delays[i],
+                                      MakeBoundCallback (&BleConnEventSchedulerOrderTestCase::Expire,
+                                                         this, i, delays[i])));
+    }
+  wheel->Cancel (ids[5]);
+  NS_TEST_ASSERT_MSG_EQ (wheel->IsPending (ids[5]), false, "cancelled timer still pending");
+  NS_TEST_ASSERT_MSG_EQ (wheel->GetNPending (), 5, "wrong number of pending timers");
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_fired.size (), 5, "wrong number of timers ran");
+  for (uint32_t i = 0; i < m_fired.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_fired[i], i, "timers ran out of order");
+    }
+  NS_TEST_ASSERT_MSG_EQ (wheel->GetNPending (), 0, "timers left after the run");
+  wheel->Dispose ();
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup BLE
+ *
+ * Callbacks that schedule timers while the wheel fires re-arm it once.
+ * With KeepNodeContext every callback runs in the context it was
+ * scheduled for; without it, the timers due together share one event.
+ */
+class BleConnEventSchedulerContextTestCase : public TestCase
+{
+public:
+  /**
+   * Constructor.
+   *
+   * \param keepNodeContext the KeepNodeContext of the wheel
+   */
+  BleConnEventSchedulerContextTestCase (bool keepNodeContext);
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Record the context of a timer and schedule the next one of its chain.
+   *
+   * \param test the test case
+   * \param context the context it was scheduled for
+   * \param remaining timers left in the chain
+   */
+  static void Expire (BleConnEventSchedulerContextTestCase *test, uint32_t context,
+                      uint32_t remaining);
+
+  /**
+   * Count the simulator events of the wheel.
+   *
+   * \param oldValue previous count
+   * \param newValue current count
+   */
+  void SimulatorEvents (uint64_t oldValue, uint64_t newValue);
+
+  Ptr<BleConnEventScheduler> m_wheel;
+  bool m_keepNodeContext;      //!< the KeepNodeContext of the wheel
+  uint32_t m_nFired;           //!< timers that ran
+  uint32_t m_nWrongContext;    //!< timers that ran in another context
+  uint64_t m_simulatorEvents;  //!< simulator events of the wheel
+};
+
+BleConnEventSchedulerContextTestCase::BleConnEventSchedulerContextTestCase (bool keepNodeContext)
+  : TestCase (keepNodeContext ? "Timers run once per firing in their own context"
+              : "Timers due together run from one event"),
+    m_keepNodeContext (keepNodeContext),
+    m_nFired (0),
+    m_nWrongContext (0),
+    m_simulatorEvents (0)
+{
+}
+
+void
+BleConnEventSchedulerContextTestCase::Expire (BleConnEventSchedulerContextTestCase *test,
+                                              uint32_t context, uint32_t remaining)
+{
+  test->m_nFired++;
+  if (Simulator::GetContext () != context)
+    {
+      test->m_nWrongContext++;
+    }
+  if (remaining > 0)
+    {
+      test->m_wheel->ScheduleWithContext (context, MilliSeconds (10),
+          MakeBoundCallback (&BleConnEventSchedulerContextTestCase::Expire,
+                             test, context, remaining - 1));
+    }
+}
+
+void
+BleConnEventSchedulerContextTestCase::SimulatorEvents (uint64_t oldValue, uint64_t newValue)
+{
+  m_simulatorEvents = newValue;
+}
+
+void
+BleConnEventSchedulerContextTestCase::DoRun (void)
+{
+  m_wheel = CreateObject<BleConnEventScheduler> ();
+  m_wheel->SetAttribute ("KeepNodeContext", BooleanValue (m_keepNodeContext));
+  m_wheel->TraceConnectWithoutContext ("SimulatorEvents",
+      MakeCallback (&BleConnEventSchedulerContextTestCase::SimulatorEvents, this));
+
+  // Ten chains of three timers, five in each of two contexts, that all
+  // expire together.
+  for (uint32_t i = 0; i < 10; i++)
+    {
+      uint32_t context = i % 2 == 0 ? 3 : 7;
+      m_wheel->ScheduleWithContext (context, MilliSeconds (10),
+          MakeBoundCallback (&BleConnEventSchedulerContextTestCase::Expire, this, context, 2u));
+    }
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_nFired, 30, "wrong number of timers ran");
+  if (m_keepNodeContext)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_nWrongContext, 0, "timers ran in another context");
+      // One wheel event per expiry. The first runs in the main context
+      // and needs an event for each of the two contexts; the wheel is
+      // then re-armed from context 3, so the later expiries only need
+      // one for context 7. The timers scheduled by the callbacks add no
+      // events.
+      NS_TEST_ASSERT_MSG_EQ (m_simulatorEvents, 3 + 2 + 1 + 1,
+                             "the wheel was re-armed more than once");
+    }
+  else
+    {
+      // One wheel event per expiry, that runs all ten timers.
+      NS_TEST_ASSERT_MSG_EQ (m_simulatorEvents, 3, "the timers did not share one event");
+    }
+
+  m_wheel->Dispose ();
+  m_wheel = 0;
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup BLE
+ *
+ * Tests of the connection event timer wheel.
+ */
+class BleConnEventSchedulerTestSuite : public TestSuite
+{
+public:
+  BleConnEventSchedulerTestSuite ();
+};
+
+BleConnEventSchedulerTestSuite::BleConnEventSchedulerTestSuite ()
+  : TestSuite ("ble-conn-event-scheduler", UNIT)
+{
+  AddTestCase (new BleConnEventSchedulerOrderTestCase, TestCase::QUICK);
+  AddTestCase (new BleConnEventSchedulerContextTestCase (false), TestCase::QUICK);
+  AddTestCase (new BleConnEventSchedulerContextTestCase (true), TestCase::QUICK);
+}
+
+static BleConnEventSchedulerTestSuite g_bleConnEventSchedulerTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,182 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <ns3/test.h>
+#include <ns3/double.h>
+#include <ns3/boolean.h>
+#include <ns3/ble-error-model.h>
+
+#include <cmath>
+
+using namespace ns3;
+
+/**
+ * \ingroup BLE
+ *
+ * The BER and PER looked up in the table stay within the configured
+ * relative error of the closed-form expression, everywhere in the table
+ * and not only at the midpoints BuildTable checks.
+ */
+class BleErrorModelTableTestCase : public TestCase
+{
+public:
+  /**
+   * \param minSnrDb lower end of the table
+   * \param maxSnrDb upper end of the table
+   * \param pointsPerDb initial table resolution
+   * \param maxRelativeError accuracy bound
+   */
+  BleErrorModelTableTestCase (double minSnrDb, double maxSnrDb,
+                              double pointsPerDb, double maxRelativeError);
+
+private:
+  virtual void DoRun (void);
+
+  double m_minSnrDb;
+  double m_maxSnrDb;
+  double m_pointsPerDb;
+  double m_maxRelativeError;
+};
+
+BleErrorModelTableTestCase::BleErrorModelTableTestCase (double minSnrDb, double maxSnrDb,
+                                                        double pointsPerDb, double maxRelativeError)
+  : TestCase ("BER table against the closed form, max relative error "
+              + std::to_string (maxRelativeError)),
+    m_minSnrDb (minSnrDb),
+    m_maxSnrDb (maxSnrDb),
+    m_pointsPerDb (pointsPerDb),
+    m_maxRelativeError (maxRelativeError)
+{
+}
+
+void
+BleErrorModelTableTestCase::DoRun (void)
+{
+  Ptr<BleErrorModel> model = CreateObject<BleErrorModel> ();
+  model->SetAttribute ("TableMinSnr", DoubleValue (m_minSnrDb));
+  model->SetAttribute ("TableMaxSnr", DoubleValue (m_maxSnrDb));
+  model->SetAttribute ("TablePointsPerDb", DoubleValue (m_pointsPerDb));
+  model->SetAttribute ("TableMaxRelativeError", DoubleValue (m_maxRelativeError));
+
+  // A step that is no multiple of the table resolution, so the points
+  // fall everywhere between samples.
+  for (double snrDb = m_minSnrDb; snrDb < m_maxSnrDb; snrDb += 0.0137)
+    {
+      double snr = std::pow (10.0, snrDb / 10);
+      long double exact = BleErrorModel::GetExactBER (snr);
+      if (exact <= 0)
+        {
+          continue;
+        }
+      double ber = model->GetBER (snr);
+      NS_TEST_ASSERT_MSG_EQ_TOL (ber / exact, 1.0, m_maxRelativeError,
+                                 "BER at " << snrDb << " dB");
+
+      uint32_t length = 37;
+      double exactPer = -std::expm1 (8.0 * length * log1pl (-exact));
+      // The relative error of the PER is at most that of the BER
+      NS_TEST_ASSERT_MSG_EQ_TOL (model->GetPER (snr, length) / exactPer, 1.0,
+                                 m_maxRelativeError, "PER at " << snrDb << " dB");
+    }
+}
+
+/**
+ * \ingroup BLE
+ *
+ * Limits of the BER and PER, and table configuration changes after the
+ * table was first used.
+ */
+class BleErrorModelLimitsTestCase : public TestCase
+{
+public:
+  BleErrorModelLimitsTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BleErrorModelLimitsTestCase::BleErrorModelLimitsTestCase ()
+  : TestCase ("BER and PER limits and table reconfiguration")
+{
+}
+
+void
+BleErrorModelLimitsTestCase::DoRun (void)
+{
+  Ptr<BleErrorModel> model = CreateObject<BleErrorModel> ();
+  NS_TEST_ASSERT_MSG_EQ (model->GetPER (0, 27), 1, "a PDU at zero SNR is lost");
+  NS_TEST_ASSERT_MSG_EQ (model->GetPER (-1, 27), 1, "a PDU at negative SNR is lost");
+  NS_TEST_ASSERT_MSG_EQ (model->GetBER (0), 0.5, "every bit is a guess at zero SNR");
+  NS_TEST_ASSERT_MSG_EQ (model->GetBER (-1), 0.5, "every bit is a guess at negative SNR");
+  NS_TEST_ASSERT_MSG_EQ (BleErrorModel::GetExactBER (0), 0.5, "closed form at zero SNR");
+  NS_TEST_ASSERT_MSG_EQ (model->GetPER (10, 0), 0, "an empty PDU has no bit errors");
+  NS_TEST_ASSERT_MSG_EQ (model->GetPER (std::pow (10.0, 3.0), 27), 0,
+                         "a PDU above the table is error free");
+
+  // Below the table the closed form is used
+  double low = std::pow (10.0, -1.5);
+  NS_TEST_ASSERT_MSG_EQ_TOL (model->GetBER (low), BleErrorModel::GetExactBER (low), 1e-12,
+                             "BER below the table");
+
+  // 15 dB is in the default table; after moving the top of the table
+  // below it, it must be reported as error free.
+  double snr = std::pow (10.0, 1.5);
+  NS_TEST_ASSERT_MSG_GT (model->GetBER (snr), 0, "BER at 15 dB in the table");
+  model->SetAttribute ("TableMaxSnr", DoubleValue (10.0));
+  NS_TEST_ASSERT_MSG_EQ (model->GetBER (snr), 0, "BER at 15 dB above the new table");
+
+  // Tightening the bound must give a finer table
+  model->SetAttribute ("TableMaxSnr", DoubleValue (20.0));
+  model->SetAttribute ("TablePointsPerDb", DoubleValue (1.0));
+  model->SetAttribute ("TableMaxRelativeError", DoubleValue (0.2));
+  double snrDb = 8.3;
+  snr = std::pow (10.0, snrDb / 10);
+  double coarse = std::fabs (model->GetBER (snr) / BleErrorModel::GetExactBER (snr) - 1);
+  model->SetAttribute ("TableMaxRelativeError", DoubleValue (1e-4));
+  double fine = std::fabs (model->GetBER (snr) / BleErrorModel::GetExactBER (snr) - 1);
+  NS_TEST_ASSERT_MSG_LT_OR_EQ (fine, 1e-4, "error after tightening the bound");
+  NS_TEST_ASSERT_MSG_GT (coarse, fine, "the table was not rebuilt");
+
+  // Without the table the closed form is returned as is
+  model->SetAttribute ("UseLookupTable", BooleanValue (false));
+  NS_TEST_ASSERT_MSG_EQ (model->GetBER (snr), BleErrorModel::GetExactBER (snr),
+                         "BER without the table");
+}
+
+/**
+ * \ingroup BLE
+ *
+ * Tests of the BLE error model.
+ */
+class BleErrorModelTestSuite : public TestSuite
+{
+public:
+  BleErrorModelTestSuite ();
+};
+
+BleErrorModelTestSuite::BleErrorModelTestSuite ()
+  : TestSuite ("ble-error-model", UNIT)
+{
+  AddTestCase (new BleErrorModelLimitsTestCase, TestCase::QUICK);
+  AddTestCase (new BleErrorModelTableTestCase (-10, 20, 20, 0.01), TestCase::QUICK);
+  AddTestCase (new BleErrorModelTableTestCase (-10, 20, 1, 1e-3), TestCase::QUICK);
+  AddTestCase (new BleErrorModelTableTestCase (0, 15, 5, 0.05), TestCase::QUICK);
+}
+
+static BleErrorModelTestSuite g_bleErrorModelTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,169 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <ns3/test.h>
+#include <ns3/simulator.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/ble-phy.h>
+#include <ns3/ble-interference-helper.h>
+
+using namespace ns3;
+
+/**
+ * \ingroup BLE
+ *
+ * Three overlapping signals in the band of channel index 5:
+ *
+ *   A, power 1: 0 us to 100 us
+ *   B, power 2: 20 us to 70 us
+ *   C, power 4: 40 us to 140 us
+ *
+ * The interference each of them saw is cut into chunks at every start
+ * and end of another signal, and is the same after the change points
+ * before a reception still in progress are forgotten.
+ */
+class BleInterferenceHelperOverlapTestCase : public TestCase
+{
+public:
+  BleInterferenceHelperOverlapTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Check the chunks of a signal.
+   *
+   * \param signal the power of the signal
+   * \param start when it started, in us
+   * \param end when it ended, in us
+   * \param durations expected chunk durations, in us
+   * \param interferences expected interference of the chunks
+   * \param sinrs expected SINR of the chunks, with a noise power of 1
+   * \param n number of chunks expected
+   */
+  void CheckChunks (double signal, uint32_t start, uint32_t end, const uint32_t *durations,
+                    const double *interferences, const double *sinrs, uint32_t n);
+
+  /**
+   * Add a signal that starts now.
+   *
+   * \param power its power in the band of channel index 5
+   * \param duration its duration, in us
+   */
+  void AddSignal (double power, uint32_t duration);
+
+  Ptr<BleInterferenceHelper> m_helper;
+};
+
+BleInterferenceHelperOverlapTestCase::BleInterferenceHelperOverlapTestCase ()
+  : TestCase ("Interference chunks of overlapping signals")
+{
+}
+
+void
+BleInterferenceHelperOverlapTestCase::AddSignal (double power, uint32_t duration)
+{
+  Ptr<SpectrumValue> psd = Create<SpectrumValue> (BlePhy::GetBleSpectrumModel ());
+  (*psd)[5 + 3] = power;
+  m_helper->AddSignal (psd, MicroSeconds (duration));
+}
+
+void
+BleInterferenceHelperOverlapTestCase::CheckChunks (double signal, uint32_t start, uint32_t end,
+                                                   const uint32_t *durations,
+                                                   const double *interferences,
+                                                   const double *sinrs, uint32_t n)
+{
+  std::vector<BleInterferenceHelper::Chunk> chunks;
+  m_helper->GetChunks (5 + 3, signal, MicroSeconds (start), MicroSeconds (end), chunks);
+  NS_TEST_ASSERT_MSG_EQ (chunks.size (), n, "wrong number of chunks");
+  for (uint32_t i = 0; i < n; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (chunks[i].duration, MicroSeconds (durations[i]),
+                             "wrong boundary of chunk " << i);
+      NS_TEST_ASSERT_MSG_EQ_TOL (chunks[i].interference, interferences[i], 1e-12,
+                                 "wrong interference in chunk " << i);
+      NS_TEST_ASSERT_MSG_EQ_TOL (signal / (chunks[i].interference + 1), sinrs[i], 1e-12,
+                                 "wrong SINR in chunk " << i);
+    }
+}
+
+void
+BleInterferenceHelperOverlapTestCase::DoRun (void)
+{
+  m_helper = CreateObject<BleInterferenceHelper> ();
+  Simulator::Schedule (MicroSeconds (0), &BleInterferenceHelperOverlapTestCase::AddSignal,
+                       this, 1.0, 100);
+  Simulator::Schedule (MicroSeconds (20), &BleInterferenceHelperOverlapTestCase::AddSignal,
+                       this, 2.0, 50);
+  Simulator::Schedule (MicroSeconds (40), &BleInterferenceHelperOverlapTestCase::AddSignal,
+                       this, 4.0, 100);
+  Simulator::Run ();
+
+  const uint32_t aDurations[] = { 20, 20, 30, 30 };
+  const double aInterferences[] = { 0, 2, 6, 4 };
+  const double aSinrs[] = { 1, 1.0 / 3, 1.0 / 7, 1.0 / 5 };
+  CheckChunks (1, 0, 100, aDurations, aInterferences, aSinrs, 4);
+
+  const uint32_t bDurations[] = { 20, 30 };
+  const double bInterferences[] = { 1, 5 };
+  const double bSinrs[] = { 1, 1.0 / 3 };
+  CheckChunks (2, 20, 70, bDurations, bInterferences, bSinrs, 2);
+
+  const uint32_t cDurations[] = { 30, 30, 40 };
+  const double cInterferences[] = { 3, 1, 0 };
+  const double cSinrs[] = { 1, 2, 4 };
+  CheckChunks (4, 40, 140, cDurations, cInterferences, cSinrs, 3);
+
+  // A and B ended; C, still in progress, needs the changes from 40 us on.
+  m_helper->EraseBefore (MicroSeconds (40));
+  CheckChunks (4, 40, 140, cDurations, cInterferences, cSinrs, 3);
+
+  // Everything ended; a later signal sees no interference.
+  m_helper->EraseBefore (MicroSeconds (140));
+  Simulator::Schedule (MicroSeconds (160), &BleInterferenceHelperOverlapTestCase::AddSignal,
+                       this, 8.0, 10);
+  Simulator::Run ();
+  const uint32_t dDurations[] = { 10 };
+  const double dInterferences[] = { 0 };
+  const double dSinrs[] = { 8 };
+  CheckChunks (8, 200, 210, dDurations, dInterferences, dSinrs, 1);
+
+  m_helper = 0;
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup BLE
+ *
+ * Tests of the BLE interference helper.
+ */
+class BleInterferenceHelperTestSuite : public TestSuite
+{
+public:
+  BleInterferenceHelperTestSuite ();
+};
+
+BleInterferenceHelperTestSuite::BleInterferenceHelperTestSuite ()
+  : TestSuite ("ble-interference-helper", UNIT)
+{
+  AddTestCase (new BleInterferenceHelperOverlapTestCase, TestCase::QUICK);
+}
+
+static BleInterferenceHelperTestSuite g_bleInterferenceHelperTestSuite; //!< Static variable for test initialization
@@ -0,0 +1,102 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <ns3/test.h>
+#include <ns3/simulator.h>
+#include <ns3/ble-link-manager.h>
+
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * \ingroup BLE
+ *
+ * CSA#2 gives the channels of the sample data of the Bluetooth Core
+ * specification (Vol 6, Part C, Section 3), for access address
+ * 0x8E89BED6, channel identifier 0x305F: with all 37 data channels in
+ * use, and with a map of 9 channels, which also goes through the
+ * remapping table.
+ */
+class BleLinkManagerCsa2TestCase : public TestCase
+{
+public:
+  BleLinkManagerCsa2TestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BleLinkManagerCsa2TestCase::BleLinkManagerCsa2TestCase ()
+  : TestCase ("CSA#2 follows the sample data of the specification")
+{
+}
+
+void
+BleLinkManagerCsa2TestCase::DoRun (void)
+{
+  Ptr<BleLinkManager> lm = CreateObject<BleLinkManager> ();
+  lm->SetAccessAddress (0x8E89BED6);
+
+  std::vector<uint8_t> all;
+  for (uint8_t i = 0; i < 37; i++)
+    {
+      all.push_back (i);
+    }
+  lm->SetUsedChannels (all);
+  const uint8_t allChannels[] = { 25, 20, 6, 21 };
+  for (uint16_t counter = 0; counter < 4; counter++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (uint32_t (lm->SelectChannelCsa2 (counter)),
+                             uint32_t (allChannels[counter]),
+                             "wrong channel with 37 channels at event " << counter);
+    }
+
+  const uint8_t map[] = { 9, 10, 21, 22, 23, 33, 34, 35, 36 };
+  lm->SetUsedChannels (std::vector<uint8_t> (map, map + 9));
+  const uint8_t mapChannels[] = { 23, 9, 34 };
+  for (uint16_t counter = 6; counter < 9; counter++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (uint32_t (lm->SelectChannelCsa2 (counter)),
+                             uint32_t (mapChannels[counter - 6]),
+                             "wrong channel with 9 channels at event " << counter);
+    }
+
+  lm->Dispose ();
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup BLE
+ *
+ * Tests of the BLE link manager.
+ */
+class BleLinkManagerTestSuite : public TestSuite
+{
+public:
+  BleLinkManagerTestSuite ();
+};
+
+BleLinkManagerTestSuite::BleLinkManagerTestSuite ()
+  : TestSuite ("ble-link-manager", UNIT)
+{
+  AddTestCase (new BleLinkManagerCsa2TestCase, TestCase::QUICK);
+}
+
+static BleLinkManagerTestSuite g_bleLinkManagerTestSuite; //!< Static variable for test initialization
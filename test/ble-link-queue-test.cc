@@ -0,0 +1,267 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <ns3/test.h>
+#include <ns3/simulator.h>
+#include <ns3/packet.h>
+#include <ns3/ble-link-queue.h>
+
+#include <vector>
+
+using namespace ns3;
+
+/**
+ * \ingroup BLE
+ *
+ * The buffer starts empty and grows as packets come in. When it grows
+ * while its packets wrap around its end, they are moved to the front of
+ * the new buffer and still leave in the order they came in.
+ */
+class BleLinkQueueGrowTestCase : public TestCase
+{
+public:
+  BleLinkQueueGrowTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BleLinkQueueGrowTestCase::BleLinkQueueGrowTestCase ()
+  : TestCase ("The queue keeps its order when it grows wrapped around")
+{
+}
+
+void
+BleLinkQueueGrowTestCase::DoRun (void)
+{
+  Ptr<BleLinkQueue> queue = CreateObject<BleLinkQueue> ();
+  NS_TEST_ASSERT_MSG_EQ (queue->GetCapacity (), 0, "an unused queue holds storage");
+
+  // Packets are told apart by their size.
+  for (uint32_t i = 1; i <= 4; i++)
+    {
+      queue->Enqueue (Create<Packet> (i));
+    }
+  NS_TEST_ASSERT_MSG_EQ (queue->GetCapacity (), 4, "wrong first capacity");
+  queue->Dequeue ();
+  queue->Dequeue ();
+  // 5 and 6 wrap around to the start of the buffer; 7 makes it grow.
+  for (uint32_t i = 5; i <= 7; i++)
+    {
+      queue->Enqueue (Create<Packet> (i));
+    }
+  NS_TEST_ASSERT_MSG_EQ (queue->GetCapacity (), 8, "the buffer did not double");
+  NS_TEST_ASSERT_MSG_EQ (queue->GetNPackets (), 5, "wrong number of packets");
+  NS_TEST_ASSERT_MSG_EQ (queue->GetNBytes (), 3 + 4 + 5 + 6 + 7, "wrong number of bytes");
+  for (uint32_t i = 3; i <= 7; i++)
+    {
+      Ptr<Packet> packet = queue->Dequeue ();
+      NS_TEST_ASSERT_MSG_EQ (packet->GetSize (), i, "packets out of order");
+    }
+  NS_TEST_ASSERT_MSG_EQ (queue->IsEmpty (), true, "packets left");
+  NS_TEST_ASSERT_MSG_EQ (queue->Dequeue () == 0, true, "a packet from an empty queue");
+  queue->Dispose ();
+
+  // The buffer never grows beyond MaxPackets.
+  queue = CreateObject<BleLinkQueue> ();
+  queue->SetMaxPackets (6);
+  for (uint32_t i = 0; i < 10; i++)
+    {
+      queue->Enqueue (Create<Packet> (1));
+    }
+  NS_TEST_ASSERT_MSG_EQ (queue->GetNPackets (), 6, "MaxPackets exceeded");
+  NS_TEST_ASSERT_MSG_EQ (queue->GetCapacity (), 6, "the buffer grew past MaxPackets");
+
+  queue->Dispose ();
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup BLE
+ *
+ * Packets that would take the queue over MaxPackets or MaxBytes are
+ * dropped, and so are all packets in it when it is flushed; each drop
+ * fires the Drop trace once.
+ */
+class BleLinkQueueDropTestCase : public TestCase
+{
+public:
+  BleLinkQueueDropTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Record a dropped packet.
+   *
+   * \param packet the packet
+   */
+  void Dropped (Ptr<const Packet> packet);
+
+  std::vector<uint32_t> m_dropped; //!< sizes of the dropped packets
+};
+
+BleLinkQueueDropTestCase::BleLinkQueueDropTestCase ()
+  : TestCase ("Packets over the limits and flushed packets are dropped")
+{
+}
+
+void
+BleLinkQueueDropTestCase::Dropped (Ptr<const Packet> packet)
+{
+  m_dropped.push_back (packet->GetSize ());
+}
+
+void
+BleLinkQueueDropTestCase::DoRun (void)
+{
+  Ptr<BleLinkQueue> queue = CreateObject<BleLinkQueue> ();
+  queue->TraceConnectWithoutContext ("Drop", MakeCallback (&BleLinkQueueDropTestCase::Dropped, this));
+  queue->SetMaxBytes (100);
+
+  NS_TEST_ASSERT_MSG_EQ (queue->Enqueue (Create<Packet> (60)), true, "60 bytes dropped");
+  NS_TEST_ASSERT_MSG_EQ (queue->Enqueue (Create<Packet> (50)), false, "MaxBytes exceeded");
+  NS_TEST_ASSERT_MSG_EQ (queue->Enqueue (Create<Packet> (40)), true, "40 bytes dropped");
+  NS_TEST_ASSERT_MSG_EQ (queue->Enqueue (Create<Packet> (1)), false, "MaxBytes exceeded");
+  NS_TEST_ASSERT_MSG_EQ (queue->GetNBytes (), 100, "wrong number of bytes");
+  NS_TEST_ASSERT_MSG_EQ (m_dropped.size (), 2, "wrong number of drops");
+
+  queue->SetMaxBytes (0);
+  queue->SetMaxPackets (3);
+  NS_TEST_ASSERT_MSG_EQ (queue->Enqueue (Create<Packet> (30)), true, "30 bytes dropped");
+  NS_TEST_ASSERT_MSG_EQ (queue->Enqueue (Create<Packet> (2)), false, "MaxPackets exceeded");
+  NS_TEST_ASSERT_MSG_EQ (m_dropped.size (), 3, "wrong number of drops");
+
+  queue->Flush ();
+  NS_TEST_ASSERT_MSG_EQ (queue->IsEmpty (), true, "packets left after a flush");
+  NS_TEST_ASSERT_MSG_EQ (queue->GetNBytes (), 0, "bytes left after a flush");
+  const uint32_t dropped[] = { 50, 1, 2, 60, 40, 30 };
+  NS_TEST_ASSERT_MSG_EQ (m_dropped.size (), 6, "not every flushed packet was traced");
+  for (uint32_t i = 0; i < m_dropped.size () && i < 6; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_dropped[i], dropped[i], "wrong drop " << i);
+    }
+
+  NS_TEST_ASSERT_MSG_EQ (queue->Enqueue (Create<Packet> (5)), true, "dropped after a flush");
+  NS_TEST_ASSERT_MSG_EQ (queue->Dequeue ()->GetSize (), 5, "wrong packet after a flush");
+
+  queue->Dispose ();
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup BLE
+ *
+ * A dequeued packet reports the time since it was enqueued.
+ */
+class BleLinkQueueSojournTestCase : public TestCase
+{
+public:
+  BleLinkQueueSojournTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Record a sojourn time.
+   *
+   * \param sojourn the time
+   */
+  void Sojourn (Time sojourn);
+
+  /**
+   * Add a packet to the queue.
+   *
+   * \param queue the queue
+   */
+  static void Enqueue (Ptr<BleLinkQueue> queue);
+
+  /**
+   * Take a packet from the queue.
+   *
+   * \param queue the queue
+   */
+  static void Dequeue (Ptr<BleLinkQueue> queue);
+
+  std::vector<Time> m_sojourns; //!< the sojourn times seen
+};
+
+BleLinkQueueSojournTestCase::BleLinkQueueSojournTestCase ()
+  : TestCase ("Dequeued packets report their time in the queue")
+{
+}
+
+void
+BleLinkQueueSojournTestCase::Sojourn (Time sojourn)
+{
+  m_sojourns.push_back (sojourn);
+}
+
+void
+BleLinkQueueSojournTestCase::Enqueue (Ptr<BleLinkQueue> queue)
+{
+  queue->Enqueue (Create<Packet> (10));
+}
+
+void
+BleLinkQueueSojournTestCase::Dequeue (Ptr<BleLinkQueue> queue)
+{
+  queue->Dequeue ();
+}
+
+void
+BleLinkQueueSojournTestCase::DoRun (void)
+{
+  Ptr<BleLinkQueue> queue = CreateObject<BleLinkQueue> ();
+  queue->TraceConnectWithoutContext ("SojournTime",
+                                     MakeCallback (&BleLinkQueueSojournTestCase::Sojourn, this));
+  Simulator::Schedule (MilliSeconds (0), &BleLinkQueueSojournTestCase::Enqueue, queue);
+  Simulator::Schedule (MilliSeconds (1), &BleLinkQueueSojournTestCase::Enqueue, queue);
+  Simulator::Schedule (MilliSeconds (5), &BleLinkQueueSojournTestCase::Dequeue, queue);
+  Simulator::Schedule (MilliSeconds (7), &BleLinkQueueSojournTestCase::Dequeue, queue);
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_sojourns.size (), 2, "wrong number of sojourn times");
+  NS_TEST_ASSERT_MSG_EQ (m_sojourns[0], MilliSeconds (5), "wrong sojourn of the first packet");
+  NS_TEST_ASSERT_MSG_EQ (m_sojourns[1], MilliSeconds (6), "wrong sojourn of the second packet");
+
+  queue->Dispose ();
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup BLE
+ *
+ * Tests of the BLE link queue.
+ */
+class BleLinkQueueTestSuite : public TestSuite
+{
+public:
+  BleLinkQueueTestSuite ();
+};
+
+BleLinkQueueTestSuite::BleLinkQueueTestSuite ()
+  : TestSuite ("ble-link-queue", UNIT)
+{
+  AddTestCase (new BleLinkQueueGrowTestCase, TestCase::QUICK);
+  AddTestCase (new BleLinkQueueDropTestCase, TestCase::QUICK);
+  AddTestCase (new BleLinkQueueSojournTestCase, TestCase::QUICK);
+}
+
+static BleLinkQueueTestSuite g_bleLinkQueueTestSuite; //!< Static variable for test initialization
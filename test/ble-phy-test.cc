@@ -0,0 +1,161 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <ns3/test.h>
+#include <ns3/simulator.h>
+#include <ns3/boolean.h>
+#include <ns3/packet.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/ble-phy.h>
+#include <ns3/ble-spectrum-channel.h>
+#include <ns3/ble-spectrum-signal-parameters.h>
+
+using namespace ns3;
+
+/**
+ * \ingroup BLE
+ *
+ * Two co-channel signals reach a receiver: a weak one, and one 20 dB
+ * stronger that starts after the receiver synchronised to the first.
+ * With LateCapture the receiver takes the stronger one; without it, it
+ * stays with the first one, which the second one jams.
+ */
+class BlePhyLateCaptureTestCase : public TestCase
+{
+public:
+  /**
+   * \param lateCapture the LateCapture attribute of the receiver
+   */
+  BlePhyLateCaptureTestCase (bool lateCapture);
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Hand a signal to the channel.
+   *
+   * \param tx the transmitter
+   * \param size packet size in octets
+   * \param psd power spectral density in the centre band
+   */
+  void Send (Ptr<BlePhy> tx, uint32_t size, double psd);
+
+  /**
+   * Record the end of a reception.
+   *
+   * \param packet the packet
+   * \param error whether it was received in error
+   */
+  void Received (Ptr<const Packet> packet, bool error);
+
+  bool m_lateCapture;
+  Ptr<BleSpectrumChannel> m_channel;
+  uint32_t m_nReceived;       //!< receptions that ended
+  uint32_t m_nOk;             //!< receptions without errors
+  uint32_t m_okSize;          //!< size of the last packet received without errors
+};
+
+BlePhyLateCaptureTestCase::BlePhyLateCaptureTestCase (bool lateCapture)
+  : TestCase (std::string ("Late arrival of a stronger signal, LateCapture ")
+              + (lateCapture ? "on" : "off")),
+    m_lateCapture (lateCapture),
+    m_nReceived (0),
+    m_nOk (0),
+    m_okSize (0)
+{
+}
+
+void
+BlePhyLateCaptureTestCase::Send (Ptr<BlePhy> tx, uint32_t size, double psd)
+{
+  Ptr<BleSpectrumSignalParameters> params = Create<BleSpectrumSignalParameters> ();
+  params->duration = MicroSeconds (300);
+  params->packet = Create<Packet> (size);
+  params->txPhy = tx;
+  params->psd = Create<SpectrumValue> (BlePhy::GetBleSpectrumModel ());
+  (*params->psd)[tx->GetChannelIndex () + 3] = psd;
+  params->SetChannel (tx->GetChannelIndex ());
+  m_channel->StartTx (params);
+}
+
+void
+BlePhyLateCaptureTestCase::Received (Ptr<const Packet> packet, bool error)
+{
+  m_nReceived++;
+  if (!error)
+    {
+      m_nOk++;
+      m_okSize = packet->GetSize ();
+    }
+}
+
+void
+BlePhyLateCaptureTestCase::DoRun (void)
+{
+  m_channel = CreateObject<BleSpectrumChannel> ();
+  Ptr<BlePhy> rx = CreateObject<BlePhy> ();
+  rx->SetAttribute ("LateCapture", BooleanValue (m_lateCapture));
+  rx->SetChannel (m_channel);
+  rx->SetReceptionEndCallback (MakeCallback (&BlePhyLateCaptureTestCase::Received, this));
+  Ptr<BlePhy> first = CreateObject<BlePhy> ();
+  Ptr<BlePhy> second = CreateObject<BlePhy> ();
+
+  // The receiver is up after RX_PREP_TIME and synchronised to the first
+  // signal 40 us after it started.
+  rx->PrepareRX ();
+  Simulator::Schedule (MicroSeconds (60), &BlePhyLateCaptureTestCase::Send, this,
+                       first, 10, 1e-15);
+  Simulator::Schedule (MicroSeconds (160), &BlePhyLateCaptureTestCase::Send, this,
+                       second, 20, 1e-13);
+  Simulator::Run ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_nReceived, 2, "both signals should end at the receiver");
+  if (m_lateCapture)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_nOk, 1, "the stronger signal should capture the receiver");
+      NS_TEST_ASSERT_MSG_EQ (m_okSize, 20, "the stronger signal should be received");
+    }
+  else
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_nOk, 0, "the receiver should stay with the jammed signal");
+    }
+
+  m_channel = 0;
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup BLE
+ *
+ * Tests of the BLE PHY.
+ */
+class BlePhyTestSuite : public TestSuite
+{
+public:
+  BlePhyTestSuite ();
+};
+
+BlePhyTestSuite::BlePhyTestSuite ()
+  : TestSuite ("ble-phy", UNIT)
+{
+  AddTestCase (new BlePhyLateCaptureTestCase (true), TestCase::QUICK);
+  AddTestCase (new BlePhyLateCaptureTestCase (false), TestCase::QUICK);
+}
+
+static BlePhyTestSuite g_blePhyTestSuite; //!< Static variable for test initialization
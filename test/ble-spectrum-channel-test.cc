@@ -0,0 +1,415 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ *
+ */
+
+#include <ns3/test.h>
+#include <ns3/simulator.h>
+#include <ns3/packet.h>
+#include <ns3/spectrum-value.h>
+#include <ns3/double.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/ble-phy.h>
+#include <ns3/ble-spectrum-channel.h>
+#include <ns3/ble-spectrum-signal-parameters.h>
+
+using namespace ns3;
+
+/**
+ * \ingroup BLE
+ *
+ * A BlePhy that only counts the signals the channel hands to it.
+ */
+class BleCountingPhy : public BlePhy
+{
+public:
+  BleCountingPhy ()
+    : m_nStartRx (0)
+  {
+  }
+
+  virtual void StartRx (Ptr<SpectrumSignalParameters> params)
+  {
+    m_nStartRx++;
+  }
+
+  uint32_t m_nStartRx; //!< signals received
+};
+
+/**
+ * \ingroup BLE
+ *
+ * A BlePhy that remembers the last signal the channel handed to it, and
+ * holds on to it or receives it if asked to.
+ */
+class BleRecordingPhy : public BlePhy
+{
+public:
+  BleRecordingPhy ()
+    : m_hold (false),
+      m_receive (false),
+      m_last (0),
+      m_psd (0)
+  {
+  }
+
+  virtual void StartRx (Ptr<SpectrumSignalParameters> params)
+  {
+    m_last = PeekPointer (params);
+    m_psd = (*params->psd)[GetChannelIndex () + 3];
+    if (m_hold)
+      {
+        m_held.push_back (params);
+      }
+    if (m_receive)
+      {
+        BlePhy::StartRx (params);
+      }
+  }
+
+  bool m_hold;                                        //!< whether to keep the signals
+  bool m_receive;                                     //!< whether to receive the signals
+  std::vector<Ptr<SpectrumSignalParameters> > m_held; //!< signals kept
+  const SpectrumSignalParameters *m_last;             //!< last signal received
+  double m_psd;                                       //!< its psd in the band of the index
+};
+
+/**
+ * \ingroup BLE
+ *
+ * Hand a BLE signal on a channel index to a channel.
+ *
+ * \param channel the channel
+ * \param txPhy the transmitter
+ * \param channelIndex the channel index of the signal
+ * \param power the power spectral density in the band of the index
+ */
+static void
+SendSignal (Ptr<BleSpectrumChannel> channel, Ptr<BlePhy> txPhy, uint8_t channelIndex,
+            double power)
+{
+  Ptr<BleSpectrumSignalParameters> params = Create<BleSpectrumSignalParameters> ();
+  params->duration = MicroSeconds (80);
+  params->packet = Create<Packet> (10);
+  params->txPhy = txPhy;
+  params->psd = Create<SpectrumValue> (BlePhy::GetBleSpectrumModel ());
+  (*params->psd)[channelIndex + 3] = power;
+  params->SetChannel (channelIndex);
+  channel->StartTx (params);
+}
+
+/**
+ * \ingroup BLE
+ *
+ * A transmission only reaches the receivers tuned to its channel index,
+ * and a receiver that hops is moved to the bucket of its new index.
+ */
+class BleSpectrumChannelBucketTestCase : public TestCase
+{
+public:
+  BleSpectrumChannelBucketTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BleSpectrumChannelBucketTestCase::BleSpectrumChannelBucketTestCase ()
+  : TestCase ("Delivery to co-channel receivers only")
+{
+}
+
+void
+BleSpectrumChannelBucketTestCase::DoRun (void)
+{
+  Ptr<BleSpectrumChannel> channel = CreateObject<BleSpectrumChannel> ();
+  Ptr<BlePhy> tx = CreateObject<BlePhy> ();
+  std::vector<Ptr<BleCountingPhy> > phys;
+  for (uint32_t i = 0; i < 10; i++)
+    {
+      Ptr<BleCountingPhy> phy = CreateObject<BleCountingPhy> ();
+      // Three receivers on index 5, the others on 30
+      phy->SetChannelIndex (i < 3 ? 5 : 30);
+      phy->SetChannel (channel);
+      phys.push_back (phy);
+    }
+  // One receiver hops from 5 to 7 after it was added
+  phys[2]->SetChannelIndex (7);
+
+  Simulator::Schedule (Seconds (1), &SendSignal, channel, tx, 5, 1e-3);
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (phys[0]->m_nStartRx, 1, "co-channel receiver missed the signal");
+  NS_TEST_ASSERT_MSG_EQ (phys[1]->m_nStartRx, 1, "co-channel receiver missed the signal");
+  NS_TEST_ASSERT_MSG_EQ (phys[2]->m_nStartRx, 0, "receiver that hopped away got the signal");
+  for (uint32_t i = 3; i < phys.size (); i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (phys[i]->m_nStartRx, 0, "receiver on another index got the signal");
+    }
+
+  Simulator::Schedule (Seconds (1), &SendSignal, channel, tx, 7, 1e-3);
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (phys[2]->m_nStartRx, 1, "receiver that hopped missed the signal");
+  NS_TEST_ASSERT_MSG_EQ (phys[0]->m_nStartRx, 1, "receiver on another index got the signal");
+
+  // A receiver that moves to another channel object leaves this one
+  Ptr<BleSpectrumChannel> other = CreateObject<BleSpectrumChannel> ();
+  phys[0]->SetChannel (other);
+  NS_TEST_ASSERT_MSG_EQ (channel->GetNDevices (), 9, "receiver still on the old channel");
+  Simulator::Schedule (Seconds (1), &SendSignal, channel, tx, 5, 1e-3);
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (phys[0]->m_nStartRx, 1, "receiver got a signal of its old channel");
+  NS_TEST_ASSERT_MSG_EQ (phys[1]->m_nStartRx, 2, "co-channel receiver missed the signal");
+
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup BLE
+ *
+ * Only busy receivers in interference range count against a receiver,
+ * and only they wake up the callbacks watching it.
+ */
+class BleSpectrumChannelBusyRangeTestCase : public TestCase
+{
+public:
+  BleSpectrumChannelBusyRangeTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Add a receiver at a position.
+   *
+   * \param x position along the x axis, in meters
+   * \return the receiver
+   */
+  Ptr<BlePhy> AddPhy (double x);
+
+  /// Count a wake-up
+  void Woken (void);
+
+  Ptr<BleSpectrumChannel> m_channel;
+  uint32_t m_nWoken; //!< callbacks run
+};
+
+BleSpectrumChannelBusyRangeTestCase::BleSpectrumChannelBusyRangeTestCase ()
+  : TestCase ("Busy receivers out of range are ignored"),
+    m_nWoken (0)
+{
+}
+
+Ptr<BlePhy>
+BleSpectrumChannelBusyRangeTestCase::AddPhy (double x)
+{
+  Ptr<ConstantPositionMobilityModel> mobility = CreateObject<ConstantPositionMobilityModel> ();
+  mobility->SetPosition (Vector (x, 0, 1));
+  Ptr<BlePhy> phy = CreateObject<BlePhy> ();
+  phy->SetMobility (mobility);
+  phy->SetChannel (m_channel);
+  return phy;
+}
+
+void
+BleSpectrumChannelBusyRangeTestCase::Woken (void)
+{
+  m_nWoken++;
+}
+
+void
+BleSpectrumChannelBusyRangeTestCase::DoRun (void)
+{
+  m_channel = CreateObject<BleSpectrumChannel> ();
+  m_channel->SetAttribute ("MaxInterferenceRange", DoubleValue (10.0));
+  Ptr<BlePhy> a = AddPhy (0);
+  Ptr<BlePhy> b = AddPhy (5);
+  Ptr<BlePhy> far = AddPhy (100);
+  m_channel->SetRxIdle (a, true);
+  m_channel->SetRxIdle (b, true);
+
+  NS_TEST_ASSERT_MSG_EQ (m_channel->GetNBusyRx (), 1, "one receiver is busy");
+  NS_TEST_ASSERT_MSG_EQ (m_channel->GetNBusyRx (a), 0, "the busy receiver is out of range");
+
+  std::vector<Ptr<SpectrumPhy> > watched;
+  watched.push_back (a);
+  watched.push_back (b);
+  m_channel->NotifyWhenBusy (watched,
+                             MakeCallback (&BleSpectrumChannelBusyRangeTestCase::Woken, this));
+  m_channel->SetRxIdle (far, true);
+  m_channel->SetRxIdle (far, false);
+  NS_TEST_ASSERT_MSG_EQ (m_nWoken, 0, "woken by a receiver out of range");
+
+  Ptr<BlePhy> near = AddPhy (12);
+  NS_TEST_ASSERT_MSG_EQ (m_nWoken, 1, "not woken by a new receiver in range of b");
+  NS_TEST_ASSERT_MSG_EQ (m_channel->GetNBusyRx (b), 1, "the new receiver is in range of b");
+
+  m_channel->NotifyWhenBusy (watched,
+                             MakeCallback (&BleSpectrumChannelBusyRangeTestCase::Woken, this));
+  m_channel->SetRxIdle (b, false);
+  NS_TEST_ASSERT_MSG_EQ (m_nWoken, 2, "not woken by a watched receiver that became busy");
+
+  // In the next grid cell, but in range of a.
+  Ptr<BlePhy> west = AddPhy (-4);
+  NS_TEST_ASSERT_MSG_EQ (m_channel->GetNBusyRx (a), 2, "b and the receiver west of a are in range");
+
+  m_channel = 0;
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup BLE
+ *
+ * The copy of a signal handed to a receiver is reused for a later
+ * delivery once no receiver holds it, with the psd of the new signal.
+ */
+class BleSpectrumChannelReuseTestCase : public TestCase
+{
+public:
+  BleSpectrumChannelReuseTestCase ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BleSpectrumChannelReuseTestCase::BleSpectrumChannelReuseTestCase ()
+  : TestCase ("Signal parameters are reused once released")
+{
+}
+
+void
+BleSpectrumChannelReuseTestCase::DoRun (void)
+{
+  Ptr<BleSpectrumChannel> channel = CreateObject<BleSpectrumChannel> ();
+  Ptr<BlePhy> tx = CreateObject<BlePhy> ();
+  Ptr<BleRecordingPhy> rx = CreateObject<BleRecordingPhy> ();
+  rx->SetChannelIndex (5);
+  rx->SetChannel (channel);
+
+  Simulator::Schedule (Seconds (1), &SendSignal, channel, tx, 5, 1e-3);
+  Simulator::Run ();
+  const SpectrumSignalParameters *first = rx->m_last;
+  NS_TEST_ASSERT_MSG_EQ_TOL (rx->m_psd, 1e-3, 1e-9, "wrong psd received");
+
+  Simulator::Schedule (Seconds (1), &SendSignal, channel, tx, 5, 2e-3);
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (rx->m_last, first, "released parameters not reused");
+  NS_TEST_ASSERT_MSG_EQ_TOL (rx->m_psd, 2e-3, 1e-9, "reused parameters kept the old psd");
+
+  // Parameters a receiver still holds are left alone
+  rx->m_hold = true;
+  Simulator::Schedule (Seconds (1), &SendSignal, channel, tx, 5, 1e-3);
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_EQ (rx->m_last, first, "released parameters not reused");
+  Simulator::Schedule (Seconds (1), &SendSignal, channel, tx, 5, 3e-3);
+  Simulator::Run ();
+  NS_TEST_ASSERT_MSG_NE (rx->m_last, first, "held parameters reused");
+  NS_TEST_ASSERT_MSG_EQ_TOL (rx->m_psd, 3e-3, 1e-9, "wrong psd received");
+  NS_TEST_ASSERT_MSG_EQ_TOL ((*rx->m_held[0]->psd)[8], 1e-3, 1e-9,
+                             "held parameters overwritten");
+
+  rx->m_held.clear ();
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup BLE
+ *
+ * A BlePhy that receives a signal keeps its parameters until its EndRx
+ * event, and lets go of them afterwards, so back-to-back receptions keep
+ * using the same copy.
+ */
+class BleSpectrumChannelReceiveReuseTestCase : public TestCase
+{
+public:
+  BleSpectrumChannelReceiveReuseTestCase ();
+
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Record the end of a reception.
+   *
+   * \param packet the packet
+   * \param error whether it was received in error
+   */
+  void Received (Ptr<const Packet> packet, bool error);
+
+  uint32_t m_nReceived; //!< receptions that ended
+};
+
+BleSpectrumChannelReceiveReuseTestCase::BleSpectrumChannelReceiveReuseTestCase ()
+  : TestCase ("Signal parameters are reused after a reception"),
+    m_nReceived (0)
+{
+}
+
+void
+BleSpectrumChannelReceiveReuseTestCase::Received (Ptr<const Packet> packet, bool error)
+{
+  m_nReceived++;
+}
+
+void
+BleSpectrumChannelReceiveReuseTestCase::DoRun (void)
+{
+  Ptr<BleSpectrumChannel> channel = CreateObject<BleSpectrumChannel> ();
+  Ptr<BlePhy> tx = CreateObject<BlePhy> ();
+  Ptr<BleRecordingPhy> rx = CreateObject<BleRecordingPhy> ();
+  rx->m_receive = true;
+  rx->SetChannelIndex (5);
+  rx->SetChannel (channel);
+  rx->SetReceptionEndCallback (MakeCallback (&BleSpectrumChannelReceiveReuseTestCase::Received,
+                                             this));
+
+  // The receiver is up after RX_PREP_TIME and back to IDLE after each
+  // signal, so it is started again before the next one.
+  const SpectrumSignalParameters *first = 0;
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      Simulator::Schedule (MicroSeconds (1000), &BlePhy::PrepareRX, rx);
+      Simulator::Schedule (MicroSeconds (1100), &SendSignal, channel, tx, 5, 1e-3);
+      Simulator::Run ();
+      NS_TEST_ASSERT_MSG_EQ (m_nReceived, i + 1, "the signal was not received");
+      if (i == 0)
+        {
+          first = rx->m_last;
+        }
+      NS_TEST_ASSERT_MSG_EQ (rx->m_last, first, "received parameters not reused");
+    }
+
+  Simulator::Destroy ();
+}
+
+/**
+ * \ingroup BLE
+ *
+ * Tests of the BLE spectrum channel.
+ */
+class BleSpectrumChannelTestSuite : public TestSuite
+{
+public:
+  BleSpectrumChannelTestSuite ();
+};
+
+BleSpectrumChannelTestSuite::BleSpectrumChannelTestSuite ()
+  : TestSuite ("ble-spectrum-channel", UNIT)
+{
+  AddTestCase (new BleSpectrumChannelBucketTestCase, TestCase::QUICK);
+  AddTestCase (new BleSpectrumChannelBusyRangeTestCase, TestCase::QUICK);
+  AddTestCase (new BleSpectrumChannelReuseTestCase, TestCase::QUICK);
+  AddTestCase (new BleSpectrumChannelReceiveReuseTestCase, TestCase::QUICK);
+}
+
+static BleSpectrumChannelTestSuite g_bleSpectrumChannelTestSuite; //!< Static variable for test initialization